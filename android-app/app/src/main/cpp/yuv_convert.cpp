@@ -0,0 +1,174 @@
+#include "yuv_convert.h"
+
+#include <atomic>
+#include <cstddef>
+#include <initializer_list>
+
+#include "yuv_kernels.h"
+
+namespace yuv {
+
+namespace {
+
+using detail::Kernels;
+
+int noRow(const uint32_t *, int, uint8_t *) { return 0; }
+int noUvRow(const uint32_t *, int, uint8_t *, uint8_t *) { return 0; }
+int noHalveRow(const uint32_t *, const uint32_t *, int, uint32_t *) { return 0; }
+
+const Kernels kScalarKernels = {noRow, noRow, noUvRow, noHalveRow};
+
+std::atomic<const Kernels *> gKernels{nullptr};
+
+#ifdef YUV_HAVE_X86
+bool cpuHasAvx2() { return __builtin_cpu_supports("avx2"); }
+#endif
+
+const Kernels *kernelsFor(Isa isa) {
+  switch (isa) {
+    case Isa::kScalar:
+      return &kScalarKernels;
+#ifdef YUV_HAVE_X86
+    case Isa::kSse2:
+      return &detail::kSse2Kernels;
+    case Isa::kAvx2:
+      return cpuHasAvx2() ? &detail::kAvx2Kernels : nullptr;
+#endif
+#ifdef YUV_HAVE_NEON
+    case Isa::kNeon:
+      return &detail::kNeonKernels;
+#endif
+    default:
+      return nullptr;
+  }
+}
+
+const Kernels &kernels() {
+  const Kernels *k = gKernels.load(std::memory_order_acquire);
+  if (!k) {
+    k = kernelsFor(bestIsa());
+    gKernels.store(k, std::memory_order_release);
+  }
+  return *k;
+}
+
+// Scalar tails, from pixel `from` on.
+void yTail(const uint32_t *src, int from, int width, uint8_t *y) {
+  for (int x = from; x < width; ++x) y[x] = detail::lumaOf(src[x]);
+}
+
+void vuTail(const uint32_t *src, int from, int width, uint8_t *vu) {
+  for (int x = from; x < width; x += 2) {
+    vu[x] = detail::chromaVOf(src[x]);
+    vu[x + 1] = detail::chromaUOf(src[x]);
+  }
+}
+
+void uvTail(const uint32_t *src, int from, int width, uint8_t *u, uint8_t *v) {
+  for (int x = from; x < width; x += 2) {
+    u[x / 2] = detail::chromaUOf(src[x]);
+    v[x / 2] = detail::chromaVOf(src[x]);
+  }
+}
+
+void halveTail(const uint32_t *row0, const uint32_t *row1, int from, int dstWidth, uint32_t *dst) {
+  for (int x = from; x < dstWidth; ++x) {
+    const uint32_t a = row0[2 * x], b = row0[2 * x + 1], c = row1[2 * x], d = row1[2 * x + 1];
+    uint32_t out = 0;
+    for (int shift = 0; shift < 32; shift += 8) {
+      const uint32_t sum = ((a >> shift) & 0xff) + ((b >> shift) & 0xff) + ((c >> shift) & 0xff) + ((d >> shift) & 0xff);
+      out |= ((sum + 2) >> 2) << shift;
+    }
+    dst[x] = out;
+  }
+}
+
+bool validFrame(const uint32_t *argb, int width, int height, int stride, const void *dst) {
+  return argb && dst && width > 0 && height > 0 && (width % 2) == 0 && (height % 2) == 0 && stride >= width;
+}
+
+}  // namespace
+
+const char *isaName(Isa isa) {
+  switch (isa) {
+    case Isa::kScalar: return "scalar";
+    case Isa::kSse2: return "sse2";
+    case Isa::kAvx2: return "avx2";
+    case Isa::kNeon: return "neon";
+  }
+  return "?";
+}
+
+bool isaSupported(Isa isa) { return kernelsFor(isa) != nullptr; }
+
+Isa bestIsa() {
+  for (Isa isa : {Isa::kAvx2, Isa::kNeon, Isa::kSse2}) {
+    if (isaSupported(isa)) return isa;
+  }
+  return Isa::kScalar;
+}
+
+Isa activeIsa() {
+  const Kernels *k = &kernels();
+  for (Isa isa : {Isa::kScalar, Isa::kSse2, Isa::kAvx2, Isa::kNeon}) {
+    if (kernelsFor(isa) == k) return isa;
+  }
+  return Isa::kScalar;
+}
+
+bool useIsa(Isa isa) {
+  const Kernels *k = kernelsFor(isa);
+  if (!k) return false;
+  gKernels.store(k, std::memory_order_release);
+  return true;
+}
+
+bool argbToNv21(const uint32_t *argb, int width, int height, int stride, uint8_t *dst) {
+  if (!validFrame(argb, width, height, stride, dst)) return false;
+  const Kernels &k = kernels();
+  uint8_t *vu = dst + static_cast<size_t>(width) * height;
+  for (int row = 0; row < height; ++row) {
+    const uint32_t *src = argb + static_cast<size_t>(row) * stride;
+    uint8_t *y = dst + static_cast<size_t>(row) * width;
+    yTail(src, k.yRow(src, width, y), width, y);
+    if (row % 2 == 0) {
+      uint8_t *out = vu + static_cast<size_t>(row / 2) * width;
+      vuTail(src, k.vuRow(src, width, out), width, out);
+    }
+  }
+  return true;
+}
+
+bool argbToI420(const uint32_t *argb, int width, int height, int stride, uint8_t *dst) {
+  if (!validFrame(argb, width, height, stride, dst)) return false;
+  const Kernels &k = kernels();
+  const size_t lumaBytes = static_cast<size_t>(width) * height;
+  uint8_t *uPlane = dst + lumaBytes;
+  uint8_t *vPlane = uPlane + lumaBytes / 4;
+  for (int row = 0; row < height; ++row) {
+    const uint32_t *src = argb + static_cast<size_t>(row) * stride;
+    uint8_t *y = dst + static_cast<size_t>(row) * width;
+    yTail(src, k.yRow(src, width, y), width, y);
+    if (row % 2 == 0) {
+      uint8_t *u = uPlane + static_cast<size_t>(row / 2) * (width / 2);
+      uint8_t *v = vPlane + static_cast<size_t>(row / 2) * (width / 2);
+      uvTail(src, k.uvRow(src, width, u, v), width, u, v);
+    }
+  }
+  return true;
+}
+
+bool halveArgb(const uint32_t *argb, int width, int height, int stride, uint32_t *dst) {
+  if (!argb || !dst || width < 2 || height < 2 || stride < width) return false;
+  const Kernels &k = kernels();
+  const int dstWidth = width / 2;
+  for (int row = 0; row < height / 2; ++row) {
+    const uint32_t *row0 = argb + static_cast<size_t>(2 * row) * stride;
+    const uint32_t *row1 = row0 + stride;
+    uint32_t *out = dst + static_cast<size_t>(row) * dstWidth;
+    halveTail(row0, row1, k.halveRow(row0, row1, dstWidth, out), dstWidth, out);
+  }
+  return true;
+}
+
+}  // namespace yuv
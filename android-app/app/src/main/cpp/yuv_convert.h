@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+
+// ARGB -> YUV 4:2:0 conversion and 2x downscaling for the timelapse
+// exporter. Input is what Bitmap.getPixels() returns: one 0xAARRGGBB int per
+// pixel, rows `stride` pixels apart. The math is the BT.601 studio-swing
+// integer formula the Kotlin exporter used, chroma taken from the top-left
+// pixel of each 2x2 block, and every kernel produces the same bytes as the
+// scalar one (tools/yuv_bench.cpp checks this).
+namespace yuv {
+
+enum class Isa { kScalar, kSse2, kAvx2, kNeon };
+
+const char *isaName(Isa isa);
+// Compiled in and supported by this CPU.
+bool isaSupported(Isa isa);
+Isa bestIsa();
+
+// Kernels used by the conversions below; bestIsa() until changed. Meant for
+// benchmarks: not safe while another thread converts.
+Isa activeIsa();
+bool useIsa(Isa isa);
+
+// Y plane, then interleaved V/U at quarter resolution (NV21). width and
+// height must be even; dst holds width * height * 3 / 2 bytes.
+bool argbToNv21(const uint32_t *argb, int width, int height, int stride, uint8_t *dst);
+// Y, U and V planes (I420), same sizes as above.
+bool argbToI420(const uint32_t *argb, int width, int height, int stride, uint8_t *dst);
+
+// Averages each 2x2 block (all four channels, rounded) into one pixel. dst is
+// width / 2 by height / 2, packed; an odd last column or row is dropped.
+bool halveArgb(const uint32_t *argb, int width, int height, int stride, uint32_t *dst);
+
+}  // namespace yuv
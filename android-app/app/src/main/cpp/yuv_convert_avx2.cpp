@@ -0,0 +1,111 @@
+#include "yuv_kernels.h"
+
+#ifdef YUV_HAVE_X86
+
+#include <immintrin.h>
+
+// Built without -mavx2 so the library still loads on older CPUs; only these
+// functions use AVX2, and yuv_convert.cpp picks them after checking CPUID.
+#define YUV_AVX2 __attribute__((target("avx2")))
+
+namespace yuv {
+namespace detail {
+
+namespace {
+
+struct Rgb16 {
+  __m256i r, g, b;
+};
+
+// 256-bit packs work per 128-bit half, so the 16 lanes come out as pixels
+// 0-3, 8-11, 4-7, 12-15. The math is per lane; kOrder fixes the order once
+// at the end.
+YUV_AVX2 inline Rgb16 split(__m256i p0, __m256i p1) {
+  const __m256i mask = _mm256_set1_epi32(0xff);
+  Rgb16 c;
+  c.r = _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 16), mask),
+                           _mm256_and_si256(_mm256_srli_epi32(p1, 16), mask));
+  c.g = _mm256_packs_epi32(_mm256_and_si256(_mm256_srli_epi32(p0, 8), mask),
+                           _mm256_and_si256(_mm256_srli_epi32(p1, 8), mask));
+  c.b = _mm256_packs_epi32(_mm256_and_si256(p0, mask), _mm256_and_si256(p1, mask));
+  return c;
+}
+
+YUV_AVX2 inline __m256i order() { return _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7); }
+
+YUV_AVX2 inline __m256i luma(const Rgb16 &c) {
+  __m256i s = _mm256_mullo_epi16(c.r, _mm256_set1_epi16(66));
+  s = _mm256_add_epi16(s, _mm256_mullo_epi16(c.g, _mm256_set1_epi16(129)));
+  s = _mm256_add_epi16(s, _mm256_mullo_epi16(c.b, _mm256_set1_epi16(25)));
+  s = _mm256_add_epi16(s, _mm256_set1_epi16(128));
+  return _mm256_add_epi16(_mm256_srli_epi16(s, 8), _mm256_set1_epi16(16));
+}
+
+YUV_AVX2 inline __m256i chroma(const Rgb16 &c, short kr, short kg, short kb) {
+  __m256i s = _mm256_mullo_epi16(c.r, _mm256_set1_epi16(kr));
+  s = _mm256_add_epi16(s, _mm256_mullo_epi16(c.g, _mm256_set1_epi16(kg)));
+  s = _mm256_add_epi16(s, _mm256_mullo_epi16(c.b, _mm256_set1_epi16(kb)));
+  s = _mm256_add_epi16(s, _mm256_set1_epi16(128));
+  return _mm256_add_epi16(_mm256_srai_epi16(s, 8), _mm256_set1_epi16(128));
+}
+
+// Even pixels of p0:p1 as 0, 2, 8, 10 | 4, 6, 12, 14; split() then yields
+// 2-pixel groups in the same 0, 4, 1, 5, ... order as whole pixels.
+YUV_AVX2 inline __m256i evenPixels(__m256i p0, __m256i p1) {
+  return _mm256_castps_si256(
+      _mm256_shuffle_ps(_mm256_castsi256_ps(p0), _mm256_castsi256_ps(p1), _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+YUV_AVX2 inline __m256i load(const uint32_t *p) {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+}
+
+YUV_AVX2 inline Rgb16 evenChannels(const uint32_t *src) {
+  return split(evenPixels(load(src), load(src + 8)), evenPixels(load(src + 16), load(src + 24)));
+}
+
+YUV_AVX2 int yRow(const uint32_t *src, int width, uint8_t *y) {
+  int x = 0;
+  for (; x + 32 <= width; x += 32) {
+    const __m256i lo = luma(split(load(src + x), load(src + x + 8)));
+    const __m256i hi = luma(split(load(src + x + 16), load(src + x + 24)));
+    const __m256i packed = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(lo, hi), order());
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(y + x), packed);
+  }
+  return x;
+}
+
+YUV_AVX2 int vuRow(const uint32_t *src, int width, uint8_t *vu) {
+  int x = 0;
+  for (; x + 32 <= width; x += 32) {
+    const Rgb16 c = evenChannels(src + x);
+    const __m256i pairs = _mm256_or_si256(chroma(c, 112, -94, -18), _mm256_slli_epi16(chroma(c, -38, -74, 112), 8));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(vu + x), _mm256_permutevar8x32_epi32(pairs, order()));
+  }
+  return x;
+}
+
+YUV_AVX2 int uvRow(const uint32_t *src, int width, uint8_t *u, uint8_t *v) {
+  int x = 0;
+  for (; x + 32 <= width; x += 32) {
+    const Rgb16 c = evenChannels(src + x);
+    const __m256i uw = _mm256_permutevar8x32_epi32(chroma(c, -38, -74, 112), order());
+    const __m256i vw = _mm256_permutevar8x32_epi32(chroma(c, 112, -94, -18), order());
+    // u0-7 v0-7 | u8-15 v8-15 -> u0-15 | v0-15
+    const __m256i uv = _mm256_permute4x64_epi64(_mm256_packus_epi16(uw, vw), _MM_SHUFFLE(3, 1, 2, 0));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(u + x / 2), _mm256_castsi256_si128(uv));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(v + x / 2), _mm256_extracti128_si256(uv, 1));
+  }
+  return x;
+}
+
+}  // namespace
+
+// Downscaling reads two rows per output row and is memory bound already, so
+// it keeps the SSE2 kernel.
+const Kernels kAvx2Kernels = {yRow, vuRow, uvRow, halveRowSse2};
+
+}  // namespace detail
+}  // namespace yuv
+
+#endif  // YUV_HAVE_X86
@@ -0,0 +1,97 @@
+#include "yuv_kernels.h"
+
+#ifdef YUV_HAVE_NEON
+
+#include <arm_neon.h>
+
+namespace yuv {
+namespace detail {
+
+namespace {
+
+// 0xAARRGGBB ints are B, G, R, A in memory, so vld4q_u8 splits 16 pixels
+// into channel planes: val[0] = B, val[1] = G, val[2] = R.
+inline uint8x16x4_t load16(const uint32_t *src) { return vld4q_u8(reinterpret_cast<const uint8_t *>(src)); }
+
+inline uint8x8_t luma(uint8x8_t r, uint8x8_t g, uint8x8_t b) {
+  uint16x8_t s = vmull_u8(r, vdup_n_u8(66));
+  s = vmlal_u8(s, g, vdup_n_u8(129));
+  s = vmlal_u8(s, b, vdup_n_u8(25));
+  // (s + 128) >> 8, narrowed.
+  return vadd_u8(vrshrn_n_u16(s, 8), vdup_n_u8(16));
+}
+
+inline uint8x8_t chroma(int16x8_t r, int16x8_t g, int16x8_t b, int16_t kr, int16_t kg, int16_t kb) {
+  int16x8_t s = vmulq_n_s16(r, kr);
+  s = vmlaq_n_s16(s, g, kg);
+  s = vmlaq_n_s16(s, b, kb);
+  s = vshrq_n_s16(vaddq_s16(s, vdupq_n_s16(128)), 8);
+  return vmovn_u16(vreinterpretq_u16_s16(vaddq_s16(s, vdupq_n_s16(128))));
+}
+
+// Even bytes of a channel plane (the low byte of each 16-bit pair), widened.
+inline int16x8_t evenWide(uint8x16_t plane) {
+  return vreinterpretq_s16_u16(vmovl_u8(vmovn_u16(vreinterpretq_u16_u8(plane))));
+}
+
+int yRow(const uint32_t *src, int width, uint8_t *y) {
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    const uint8x16x4_t px = load16(src + x);
+    const uint8x8_t lo = luma(vget_low_u8(px.val[2]), vget_low_u8(px.val[1]), vget_low_u8(px.val[0]));
+    const uint8x8_t hi = luma(vget_high_u8(px.val[2]), vget_high_u8(px.val[1]), vget_high_u8(px.val[0]));
+    vst1q_u8(y + x, vcombine_u8(lo, hi));
+  }
+  return x;
+}
+
+int vuRow(const uint32_t *src, int width, uint8_t *vu) {
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    const uint8x16x4_t px = load16(src + x);
+    const int16x8_t r = evenWide(px.val[2]), g = evenWide(px.val[1]), b = evenWide(px.val[0]);
+    uint8x8x2_t pairs;
+    pairs.val[0] = chroma(r, g, b, 112, -94, -18);
+    pairs.val[1] = chroma(r, g, b, -38, -74, 112);
+    vst2_u8(vu + x, pairs);
+  }
+  return x;
+}
+
+int uvRow(const uint32_t *src, int width, uint8_t *u, uint8_t *v) {
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    const uint8x16x4_t px = load16(src + x);
+    const int16x8_t r = evenWide(px.val[2]), g = evenWide(px.val[1]), b = evenWide(px.val[0]);
+    vst1_u8(u + x / 2, chroma(r, g, b, -38, -74, 112));
+    vst1_u8(v + x / 2, chroma(r, g, b, 112, -94, -18));
+  }
+  return x;
+}
+
+int halveRow(const uint32_t *row0, const uint32_t *row1, int dstWidth, uint32_t *dst) {
+  int x = 0;
+  for (; x + 4 <= dstWidth; x += 4) {
+    // val[0] holds source pixels 0, 2, 4, 6 and val[1] pixels 1, 3, 5, 7, so
+    // adding them lane by lane sums horizontal neighbours.
+    const uint32x4x2_t top = vld2q_u32(row0 + 2 * x);
+    const uint32x4x2_t bottom = vld2q_u32(row1 + 2 * x);
+    const uint8x16_t t0 = vreinterpretq_u8_u32(top.val[0]), t1 = vreinterpretq_u8_u32(top.val[1]);
+    const uint8x16_t b0 = vreinterpretq_u8_u32(bottom.val[0]), b1 = vreinterpretq_u8_u32(bottom.val[1]);
+    const uint16x8_t lo = vaddq_u16(vaddl_u8(vget_low_u8(t0), vget_low_u8(t1)),
+                                    vaddl_u8(vget_low_u8(b0), vget_low_u8(b1)));
+    const uint16x8_t hi = vaddq_u16(vaddl_u8(vget_high_u8(t0), vget_high_u8(t1)),
+                                    vaddl_u8(vget_high_u8(b0), vget_high_u8(b1)));
+    vst1q_u32(dst + x, vreinterpretq_u32_u8(vcombine_u8(vrshrn_n_u16(lo, 2), vrshrn_n_u16(hi, 2))));
+  }
+  return x;
+}
+
+}  // namespace
+
+const Kernels kNeonKernels = {yRow, vuRow, uvRow, halveRow};
+
+}  // namespace detail
+}  // namespace yuv
+
+#endif  // YUV_HAVE_NEON
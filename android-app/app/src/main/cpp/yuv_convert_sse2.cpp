@@ -0,0 +1,111 @@
+#include "yuv_kernels.h"
+
+#ifdef YUV_HAVE_X86
+
+#include <emmintrin.h>
+
+namespace yuv {
+namespace detail {
+
+namespace {
+
+// Channels of eight pixels as 16-bit lanes.
+struct Rgb16 {
+  __m128i r, g, b;
+};
+
+inline Rgb16 split(__m128i p0, __m128i p1) {
+  const __m128i mask = _mm_set1_epi32(0xff);
+  Rgb16 c;
+  c.r = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), mask), _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+  c.g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask), _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+  c.b = _mm_packs_epi32(_mm_and_si128(p0, mask), _mm_and_si128(p1, mask));
+  return c;
+}
+
+// The weighted sum peaks at 56228, so it is kept unsigned and shifted
+// logically.
+inline __m128i luma(const Rgb16 &c) {
+  __m128i s = _mm_mullo_epi16(c.r, _mm_set1_epi16(66));
+  s = _mm_add_epi16(s, _mm_mullo_epi16(c.g, _mm_set1_epi16(129)));
+  s = _mm_add_epi16(s, _mm_mullo_epi16(c.b, _mm_set1_epi16(25)));
+  s = _mm_add_epi16(s, _mm_set1_epi16(128));
+  return _mm_add_epi16(_mm_srli_epi16(s, 8), _mm_set1_epi16(16));
+}
+
+// Chroma sums stay within +-28688, so signed 16-bit math is exact.
+inline __m128i chroma(const Rgb16 &c, short kr, short kg, short kb) {
+  __m128i s = _mm_mullo_epi16(c.r, _mm_set1_epi16(kr));
+  s = _mm_add_epi16(s, _mm_mullo_epi16(c.g, _mm_set1_epi16(kg)));
+  s = _mm_add_epi16(s, _mm_mullo_epi16(c.b, _mm_set1_epi16(kb)));
+  s = _mm_add_epi16(s, _mm_set1_epi16(128));
+  return _mm_add_epi16(_mm_srai_epi16(s, 8), _mm_set1_epi16(128));
+}
+
+// Pixels 0, 2, 4, 6 of p0:p1.
+inline __m128i evenPixels(__m128i p0, __m128i p1) {
+  return _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(p0), _mm_castsi128_ps(p1), _MM_SHUFFLE(2, 0, 2, 0)));
+}
+
+inline __m128i load(const uint32_t *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+
+int yRow(const uint32_t *src, int width, uint8_t *y) {
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    const __m128i lo = luma(split(load(src + x), load(src + x + 4)));
+    const __m128i hi = luma(split(load(src + x + 8), load(src + x + 12)));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(y + x), _mm_packus_epi16(lo, hi));
+  }
+  return x;
+}
+
+int vuRow(const uint32_t *src, int width, uint8_t *vu) {
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    const Rgb16 c = split(evenPixels(load(src + x), load(src + x + 4)), evenPixels(load(src + x + 8), load(src + x + 12)));
+    const __m128i u = chroma(c, -38, -74, 112);
+    const __m128i v = chroma(c, 112, -94, -18);
+    // Little-endian V | U << 8 is the V, U byte pair.
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(vu + x), _mm_or_si128(v, _mm_slli_epi16(u, 8)));
+  }
+  return x;
+}
+
+int uvRow(const uint32_t *src, int width, uint8_t *u, uint8_t *v) {
+  int x = 0;
+  for (; x + 16 <= width; x += 16) {
+    const Rgb16 c = split(evenPixels(load(src + x), load(src + x + 4)), evenPixels(load(src + x + 8), load(src + x + 12)));
+    const __m128i uv = _mm_packus_epi16(chroma(c, -38, -74, 112), chroma(c, 112, -94, -18));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(u + x / 2), uv);
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(v + x / 2), _mm_unpackhi_epi64(uv, uv));
+  }
+  return x;
+}
+
+// Two output pixels from four source pixels of each row.
+inline __m128i halve4(__m128i top, __m128i bottom) {
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i sum01 = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+  const __m128i sum23 = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+  const __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(sum01, sum23), _mm_unpackhi_epi64(sum01, sum23));
+  return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+}
+
+}  // namespace
+
+int halveRowSse2(const uint32_t *row0, const uint32_t *row1, int dstWidth, uint32_t *dst) {
+  int x = 0;
+  for (; x + 4 <= dstWidth; x += 4) {
+    const __m128i lo = halve4(load(row0 + 2 * x), load(row1 + 2 * x));
+    const __m128i hi = halve4(load(row0 + 2 * x + 4), load(row1 + 2 * x + 4));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm_packus_epi16(lo, hi));
+  }
+  return x;
+}
+
+const Kernels kSse2Kernels = {yRow, vuRow, uvRow, halveRowSse2};
+
+}  // namespace detail
+}  // namespace yuv
+
+#endif  // YUV_HAVE_X86
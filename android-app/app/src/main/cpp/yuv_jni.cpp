@@ -0,0 +1,60 @@
+// JNI entry points for com.example.esp32dht11.YuvConverter.
+#include <jni.h>
+
+#include <cstdint>
+
+#include "yuv_convert.h"
+
+namespace {
+
+bool pixelsCover(JNIEnv *env, jintArray argb, jint width, jint height, jint stride) {
+  if (width <= 0 || height <= 0 || stride < width) return false;
+  return env->GetArrayLength(argb) >= static_cast<jlong>(stride) * (height - 1) + width;
+}
+
+// Converts straight into a direct buffer (a MediaCodec input buffer), so no
+// Java byte[] is allocated or copied per frame.
+template <class Convert>
+jboolean toDirectBuffer(JNIEnv *env, jintArray argb, jint width, jint height, jint stride, jobject dst,
+                        Convert convert) {
+  if (!pixelsCover(env, argb, width, height, stride)) return JNI_FALSE;
+  auto *out = static_cast<uint8_t *>(env->GetDirectBufferAddress(dst));
+  if (!out || env->GetDirectBufferCapacity(dst) < static_cast<jlong>(width) * height * 3 / 2) return JNI_FALSE;
+  void *pixels = env->GetPrimitiveArrayCritical(argb, nullptr);
+  if (!pixels) return JNI_FALSE;
+  const bool ok = convert(static_cast<const uint32_t *>(pixels), width, height, stride, out);
+  env->ReleasePrimitiveArrayCritical(argb, pixels, JNI_ABORT);
+  return ok ? JNI_TRUE : JNI_FALSE;
+}
+
+}  // namespace
+
+extern "C" JNIEXPORT jboolean JNICALL Java_com_example_esp32dht11_YuvConverter_argbToNv21(
+    JNIEnv *env, jobject, jintArray argb, jint width, jint height, jint stride, jobject dst) {
+  return toDirectBuffer(env, argb, width, height, stride, dst, yuv::argbToNv21);
+}
+
+extern "C" JNIEXPORT jboolean JNICALL Java_com_example_esp32dht11_YuvConverter_argbToI420(
+    JNIEnv *env, jobject, jintArray argb, jint width, jint height, jint stride, jobject dst) {
+  return toDirectBuffer(env, argb, width, height, stride, dst, yuv::argbToI420);
+}
+
+extern "C" JNIEXPORT jboolean JNICALL Java_com_example_esp32dht11_YuvConverter_halveArgb(
+    JNIEnv *env, jobject, jintArray argb, jint width, jint height, jintArray dst) {
+  if (!pixelsCover(env, argb, width, height, width)) return JNI_FALSE;
+  if (env->GetArrayLength(dst) < static_cast<jlong>(width / 2) * (height / 2)) return JNI_FALSE;
+  void *in = env->GetPrimitiveArrayCritical(argb, nullptr);
+  if (!in) return JNI_FALSE;
+  void *out = env->GetPrimitiveArrayCritical(dst, nullptr);
+  bool ok = false;
+  if (out) {
+    ok = yuv::halveArgb(static_cast<const uint32_t *>(in), width, height, width, static_cast<uint32_t *>(out));
+    env->ReleasePrimitiveArrayCritical(dst, out, 0);
+  }
+  env->ReleasePrimitiveArrayCritical(argb, in, JNI_ABORT);
+  return ok ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C" JNIEXPORT jstring JNICALL Java_com_example_esp32dht11_YuvConverter_isaName(JNIEnv *env, jobject) {
+  return env->NewStringUTF(yuv::isaName(yuv::activeIsa()));
+}
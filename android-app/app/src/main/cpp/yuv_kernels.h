@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+
+// Row kernels behind yuv_convert.cpp. Each converts a prefix of the row in
+// whole SIMD blocks and returns how many pixels it covered; the scalar code
+// finishes the rest, so widths need not be a multiple of any block size.
+
+#if defined(__x86_64__) || defined(__i386__)
+#define YUV_HAVE_X86 1
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define YUV_HAVE_NEON 1
+#endif
+
+namespace yuv {
+namespace detail {
+
+struct Kernels {
+  int (*yRow)(const uint32_t *src, int width, uint8_t *y);
+  // Chroma of the even pixels; vu[x] / u[x / 2] belong to source pixel x.
+  int (*vuRow)(const uint32_t *src, int width, uint8_t *vu);
+  int (*uvRow)(const uint32_t *src, int width, uint8_t *u, uint8_t *v);
+  // Returns destination pixels written.
+  int (*halveRow)(const uint32_t *row0, const uint32_t *row1, int dstWidth, uint32_t *dst);
+};
+
+inline uint8_t lumaOf(uint32_t p) {
+  const int r = (p >> 16) & 0xff, g = (p >> 8) & 0xff, b = p & 0xff;
+  return static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+// >> of a negative int is arithmetic on every compiler we target, matching
+// Kotlin's shr. Results stay within 16..240, so nothing needs clamping.
+inline uint8_t chromaUOf(uint32_t p) {
+  const int r = (p >> 16) & 0xff, g = (p >> 8) & 0xff, b = p & 0xff;
+  return static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+
+inline uint8_t chromaVOf(uint32_t p) {
+  const int r = (p >> 16) & 0xff, g = (p >> 8) & 0xff, b = p & 0xff;
+  return static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+#ifdef YUV_HAVE_X86
+extern const Kernels kSse2Kernels;
+extern const Kernels kAvx2Kernels;
+int halveRowSse2(const uint32_t *row0, const uint32_t *row1, int dstWidth, uint32_t *dst);
+#endif
+#ifdef YUV_HAVE_NEON
+extern const Kernels kNeonKernels;
+#endif
+
+}  // namespace detail
+}  // namespace yuv
@@ -202,8 +202,48 @@ class HttpViewModel : ViewModel() {
         // Download first frame to determine size.
         val firstBytes = downloadImageBytes(frames.first())
         val firstBitmap = BitmapFactory.decodeByteArray(firstBytes, 0, firstBytes.size)
-        val width = firstBitmap.width
-        val height = firstBitmap.height
+        val srcWidth = firstBitmap.width
+        val srcHeight = firstBitmap.height
+        firstBitmap.recycle()
+
+        val codec = MediaCodec.createEncoderByType("video/avc")
+        // Halve 5MP frames until the encoder takes the size; most AVC
+        // encoders stop at 1080p or 4K.
+        val caps = codec.codecInfo.getCapabilitiesForType("video/avc").videoCapabilities
+        var halvings = 0
+        var width = srcWidth and 1.inv()
+        var height = srcHeight and 1.inv()
+        while (!caps.isSizeSupported(width, height) && width > 2 && height > 2) {
+            halvings++
+            width = (srcWidth shr halvings) and 1.inv()
+            height = (srcHeight shr halvings) and 1.inv()
+        }
+        val frameBytes = width * height * 3 / 2
+
+        // Buffers are reused for every frame: 5MP of ARGB is 20MB.
+        val pixels = IntArray(srcWidth * srcHeight)
+        val halves = List(halvings) { IntArray((srcWidth shr (it + 1)) * (srcHeight shr (it + 1))) }
+
+        fun frameToNv21(bitmap: Bitmap, dst: ByteBuffer): Boolean {
+            val src = if (bitmap.width != srcWidth || bitmap.height != srcHeight) {
+                Bitmap.createScaledBitmap(bitmap, srcWidth, srcHeight, true)
+            } else {
+                bitmap
+            }
+            src.getPixels(pixels, 0, srcWidth, 0, 0, srcWidth, srcHeight)
+            if (src != bitmap) src.recycle()
+            var argb = pixels
+            var w = srcWidth
+            var h = srcHeight
+            for (half in halves) {
+                if (!YuvConverter.halveArgb(argb, w, h, half)) return false
+                argb = half
+                w /= 2
+                h /= 2
+            }
+            // An odd width is cropped by one column; the stride keeps rows aligned.
+            return YuvConverter.argbToNv21(argb, width, height, w, dst)
+        }
 
         val format = MediaFormat.createVideoFormat("video/avc", width, height).apply {
             setInteger(MediaFormat.KEY_COLOR_FORMAT, MediaCodecInfo.CodecCapabilities.COLOR_FormatYUV420Flexible)
@@ -212,7 +252,6 @@ class HttpViewModel : ViewModel() {
             setInteger(MediaFormat.KEY_I_FRAME_INTERVAL, 1)
         }
 
-        val codec = MediaCodec.createEncoderByType("video/avc")
         codec.configure(format, null, null, MediaCodec.CONFIGURE_FLAG_ENCODE)
         codec.start()
 
@@ -254,21 +293,21 @@ class HttpViewModel : ViewModel() {
         for (frame in frames) {
             val bytes = downloadImageBytes(frame)
             val bmp = BitmapFactory.decodeByteArray(bytes, 0, bytes.size)
-            val nv21 = bitmapToNV21(bmp, width, height)
             val inputIndex = codec.dequeueInputBuffer(10_000)
             if (inputIndex >= 0) {
                 val inputBuffer: ByteBuffer = codec.getInputBuffer(inputIndex)!!
                 inputBuffer.clear()
-                inputBuffer.put(nv21)
+                if (!frameToNv21(bmp, inputBuffer)) throw IllegalStateException("YUV conversion failed")
                 codec.queueInputBuffer(
                     inputIndex,
                     0,
-                    nv21.size,
+                    frameBytes,
                     framePtsUs,
                     0
                 )
                 framePtsUs += frameDurationUs
             }
+            bmp.recycle()
             drainCodec(false)
         }
         drainCodec(true)
@@ -278,38 +317,6 @@ class HttpViewModel : ViewModel() {
         muxer.release()
     }
 
-    private fun bitmapToNV21(bitmap: Bitmap, width: Int, height: Int): ByteArray {
-        val scaled = if (bitmap.width != width || bitmap.height != height) {
-            Bitmap.createScaledBitmap(bitmap, width, height, true)
-        } else {
-            bitmap
-        }
-        val argb = IntArray(width * height)
-        scaled.getPixels(argb, 0, width, 0, 0, width, height)
-        val yuv = ByteArray(width * height * 3 / 2)
-        var yIndex = 0
-        var uvIndex = width * height
-
-        for (j in 0 until height) {
-            for (i in 0 until width) {
-                val rgb = argb[j * width + i]
-                val r = (rgb shr 16) and 0xFF
-                val g = (rgb shr 8) and 0xFF
-                val b = rgb and 0xFF
-                val y = ((66 * r + 129 * g + 25 * b + 128) shr 8) + 16
-                val u = ((-38 * r - 74 * g + 112 * b + 128) shr 8) + 128
-                val v = ((112 * r - 94 * g - 18 * b + 128) shr 8) + 128
-                yuv[yIndex++] = y.coerceIn(0, 255).toByte()
-                if (j % 2 == 0 && i % 2 == 0) {
-                    yuv[uvIndex++] = v.coerceIn(0, 255).toByte()
-                    yuv[uvIndex++] = u.coerceIn(0, 255).toByte()
-                }
-            }
-        }
-        if (scaled != bitmap) scaled.recycle()
-        return yuv
-    }
-
     private fun downloadImageBytes(frame: FrameItem): ByteArray {
         val url = apiUrl("/frames/file?run=${frame.run}&file=${frame.file}")
         val req = Request.Builder()
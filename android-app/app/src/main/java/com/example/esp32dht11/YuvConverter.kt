@@ -0,0 +1,25 @@
+package com.example.esp32dht11
+
+import java.nio.ByteBuffer
+
+/**
+ * Native ARGB -> YUV 4:2:0 conversion (libyuvconvert, src/main/cpp) using
+ * NEON, AVX2 or SSE2 kernels where available. Pixels are Bitmap.getPixels()
+ * ints; width and height must be even. Destination buffers must be direct
+ * (MediaCodec input buffers are) and hold width * height * 3 / 2 bytes.
+ */
+object YuvConverter {
+    init {
+        System.loadLibrary("yuvconvert")
+    }
+
+    external fun argbToNv21(argb: IntArray, width: Int, height: Int, stride: Int, dst: ByteBuffer): Boolean
+
+    external fun argbToI420(argb: IntArray, width: Int, height: Int, stride: Int, dst: ByteBuffer): Boolean
+
+    /** Box-filters [argb] (width x height, packed) into [dst] at half size. */
+    external fun halveArgb(argb: IntArray, width: Int, height: Int, dst: IntArray): Boolean
+
+    /** Kernel set in use: "neon", "avx2", "sse2" or "scalar". */
+    external fun isaName(): String
+}
@@ -0,0 +1,1190 @@
+#include "app.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "arena.h"
+#include "event_hub.h"
+#include "frame_store.h"
+#include "gzip_stream.h"
+#include "hal/hal.h"
+#include "hal/io_sched.h"
+#include "hal/logger.h"
+#include "mem_monitor.h"
+#include "rollup.h"
+#include "sampling_policy.h"
+#include "scheduler.h"
+#include "sd_utils.h"
+
+// ----------------- Configuration constants -----------------
+static const uint32_t kDefaultCycleIntervalMs = 30000;  // capture cadence default
+static const uint64_t kDefaultMinimumFreeSpace = 2ULL * 1024ULL * 1024ULL;  // keep 2MB free
+static const uint32_t kMinCycleMs = 5000;     // 5s lower bound
+static const uint32_t kMaxCycleMs = 600000;   // 10min upper bound
+static const uint32_t kMinFreeMb = 1;         // 1MB lower bound
+static const uint32_t kMaxFreeMb = 512;       // 512MB upper bound
+static const char *kDefaultApSsid = "ESP32CAM-SETUP";
+static const char *kDefaultApPass = "esp32setup";
+// gzip for text responses, with GzipStream's default options.
+static const size_t kGzipMinBytes = 512;        // smaller bodies are sent raw
+static const uint32_t kSidecarJobMs = 500;      // pre-compression slice cadence
+static const size_t kSidecarSliceBytes = 32 * 1024;
+static const uint32_t kEventKeepAliveMs = 15000;  // SSE ping for idle subscribers
+static const uint32_t kMemorySampleMs = 60000;    // heap telemetry cadence
+
+// ----------------- State -----------------
+static AppConfig gConfig;
+
+static std::string sessionDir = "/data";
+static std::string gLastFramePath;
+static uint32_t gFrameIndex = 0;
+static uint64_t gFirstFrameMs = 0;  // clock time of the first saved frame (boot on the board)
+static uint32_t gReadingIndex = 0;
+static uint32_t gRunIndex = 0;
+static bool gSdReadBenchDone = false;
+
+static Rollups gRollups;
+static Scheduler gScheduler;
+static int gCaptureJob = -1;
+static int gSensorJob = -1;
+static EventHub gEvents;
+static FrameStore gFrames;
+static MemoryMonitor gMemory;
+static EnergyModel gEnergy;
+static SampleSmoother gSmoother;
+static SamplingPolicy gSampling(kMinCycleMs, kMaxCycleMs);
+
+// Pre-compression of closed runs' readings.csv into <run>/gz/readings.csv.gz,
+// done a slice at a time so the loop never stalls on a large file.
+struct SidecarJob {
+  std::vector<std::string> pendingRuns;
+  std::unique_ptr<hal::File> src;
+  std::unique_ptr<hal::File> dst;
+  std::unique_ptr<GzipStream> gz;
+  std::string run;
+} gSidecar;
+
+AppConfig &appConfig() { return gConfig; }
+
+static WifiLink gWifi;
+WifiLink &wifiLink() { return gWifi; }
+
+// ----------------- Energy accounting -----------------
+static void setActive(EnergyModel::Subsystem s, bool on) { gEnergy.set(s, on, hal::clock().nowUs()); }
+
+// Marks a subsystem active for the enclosing block.
+class ActiveScope {
+ public:
+  explicit ActiveScope(EnergyModel::Subsystem s) : s_(s) { setActive(s_, true); }
+  ~ActiveScope() { setActive(s_, false); }
+  ActiveScope(const ActiveScope &) = delete;
+  ActiveScope &operator=(const ActiveScope &) = delete;
+
+ private:
+  EnergyModel::Subsystem s_;
+};
+
+// ----------------- Utilities -----------------
+static bool ensureCameraReady() {
+  hal::Camera &cam = hal::camera();
+  if (cam.ready()) return true;
+  LOG_INFO("Bringing camera up");
+  if (!gEnergy.active(EnergyModel::kCamera)) setActive(EnergyModel::kCamera, true);
+  if (cam.begin()) {
+    LOG_INFO("Camera ready");
+    return true;
+  }
+  setActive(EnergyModel::kCamera, false);
+  LOG_ERROR("Camera init failed");
+  return false;
+}
+
+static void appendJsonEscaped(ArenaString &out, const char *in) {
+  for (; *in; ++in) {
+    switch (*in) {
+      case '\"': out += "\\\""; break;
+      case '\\': out += "\\\\"; break;
+      case '\n': out += "\\n"; break;
+      default: out += *in; break;
+    }
+  }
+}
+
+static void appendUnsigned(ArenaString &out, unsigned long v) {
+  char buf[24];
+  snprintf(buf, sizeof(buf), "%lu", v);
+  out += buf;
+}
+
+// Appends ,"name":v
+static void appendField(ArenaString &out, const char *name, unsigned long v) {
+  out += ",\"";
+  out += name;
+  out += "\":";
+  appendUnsigned(out, v);
+}
+
+static bool appendReading(int tempC, int hum) {
+  char path[64];
+  snprintf(path, sizeof(path), "%s/readings.csv", sessionDir.c_str());
+  uint64_t nowMs = hal::clock().nowMs();
+  {
+    ActiveScope sd(EnergyModel::kSd);
+    std::unique_ptr<hal::File> file = hal::storage().open(path, hal::OpenMode::kAppend);
+    if (!file) {
+      LOG_ERROR("Failed to open %s for append", path);
+      return false;
+    }
+    char line[64];
+    int n = snprintf(line, sizeof(line), "%lu,%lu,%llu,%d,%d\n",
+                     static_cast<unsigned long>(gRunIndex),
+                     static_cast<unsigned long>(gReadingIndex),
+                     static_cast<unsigned long long>(nowMs),
+                     tempC,
+                     hum);
+    file->write(reinterpret_cast<const uint8_t *>(line), static_cast<size_t>(n));
+    file->close();
+  }
+
+  char json[96];
+  snprintf(json, sizeof(json), "{\"index\":%lu,\"ms\":%llu,\"t\":%d,\"h\":%d}",
+           static_cast<unsigned long>(gReadingIndex), static_cast<unsigned long long>(nowMs), tempC, hum);
+  gEvents.publish("reading", json, nowMs);
+  return true;
+}
+
+static void powerDownCamera() {
+  hal::camera().powerDown();
+  if (gEnergy.active(EnergyModel::kCamera)) setActive(EnergyModel::kCamera, false);
+  LOG_INFO("Camera powered down");
+}
+
+// Opens a frame by its card path. Frames kept in segments have no file of
+// their own; they are looked up in the segment index instead.
+static std::unique_ptr<hal::File> openFrameFile(const char *path) {
+  std::unique_ptr<hal::File> f = hal::storage().open(path, hal::OpenMode::kRead);
+  if (f) return f;
+  const char *slash = strrchr(path, '/');
+  uint32_t index = 0;
+  if (!slash || !FrameStore::parseFrameName(slash + 1, index)) return nullptr;
+  return gFrames.openFrame(std::string(path, slash), index);
+}
+
+static void benchmarkSdRead(const char *path) {
+  if (gSdReadBenchDone) return;
+  ActiveScope sd(EnergyModel::kSd);
+  std::unique_ptr<hal::File> f = openFrameFile(path);
+  if (!f) {
+    LOG_ERROR("SD bench: failed to open %s", path);
+    return;
+  }
+  constexpr size_t kBufSize = 4096;
+  uint8_t buf[kBufSize];
+  size_t total = 0;
+  uint64_t startUs = hal::clock().nowUs();
+  while (true) {
+    size_t read = f->read(buf, kBufSize);
+    if (read == 0) break;
+    total += read;
+  }
+  uint64_t elapsedUs = hal::clock().nowUs() - startUs;
+  f->close();
+  double elapsedMs = elapsedUs / 1000.0;
+  double kbPerSec = (elapsedUs > 0) ? (total * 1000.0 / elapsedMs / 1024.0) : 0.0;
+  double mbPerSec = kbPerSec / 1024.0;
+  LOG_INFO("SD bench: read %u bytes from %s in %.2f ms (%.2f KB/s, %.2f MB/s)",
+           static_cast<unsigned>(total), path, elapsedMs, kbPerSec, mbPerSec);
+  gSdReadBenchDone = true;
+}
+
+// Grabs one frame and writes it to the session directory if space allows.
+static bool captureAndSave(const char *noSpaceMsg) {
+  hal::Camera &cam = hal::camera();
+  hal::Frame frame;
+  if (!cam.capture(frame)) {
+    LOG_ERROR("Camera capture failed");
+    return false;
+  }
+  bool saved = false;
+  uint64_t freeBytes = sdFreeBytes();
+  if (freeBytes >= frame.len + gConfig.minimumFreeSpace) {
+    std::string savedPath;
+    setActive(EnergyModel::kSd, true);
+    const bool written = gConfig.segmentStore
+                             ? gFrames.append(gFrameIndex++, frame.data, frame.len,
+                                              freeBytes - gConfig.minimumFreeSpace, savedPath)
+                             : saveJpegFrame(sessionDir.c_str(), gFrameIndex++, frame.data, frame.len, savedPath);
+    setActive(EnergyModel::kSd, false);
+    if (written) {
+      if (gLastFramePath.empty()) {
+        gFirstFrameMs = hal::clock().nowMs();
+        LOG_INFO("First frame %lums after boot", static_cast<unsigned long>(gFirstFrameMs));
+      }
+      gLastFramePath = savedPath;
+      LOG_INFO("Saved %s (%u bytes)", savedPath.c_str(), static_cast<unsigned>(frame.len));
+      // Same run/file pair /frames/file takes.
+      ArenaString json;
+      json.reserve(96);
+      json += "{\"run\":\"";
+      appendJsonEscaped(json, sessionDir.c_str() + sessionDir.rfind('/') + 1);
+      json += "\",\"file\":\"";
+      appendJsonEscaped(json, savedPath.c_str() + savedPath.rfind('/') + 1);
+      json += "\",\"size\":";
+      appendUnsigned(json, static_cast<unsigned long>(frame.len));
+      json += "}";
+      gEvents.publish("frame", json.c_str(), hal::clock().nowMs());
+      saved = true;
+    } else {
+      LOG_ERROR("Failed to write frame");
+    }
+  } else {
+    LOG_INFO("%s", noSpaceMsg);
+  }
+  cam.release(frame);
+  return saved;
+}
+
+// ----------------- HTTP -----------------
+
+static bool requireAuth() {
+  // Auth disabled: allow all requests.
+  return true;
+}
+
+static bool clientAcceptsGzip(hal::HttpContext &req) {
+  return GzipStream::accepts(req.header("Accept-Encoding").c_str());
+}
+
+// Sends a text body, deflated on the fly when the client accepts gzip.
+static void sendText(hal::HttpContext &req, int code, const char *contentType, const ArenaString &body) {
+  if (body.size() < kGzipMinBytes || !clientAcceptsGzip(req)) {
+    req.send(code, contentType, body.data(), body.size());
+    return;
+  }
+  req.sendHeader("Content-Encoding", "gzip");
+  req.sendHeader("Vary", "Accept-Encoding");
+  req.beginStream(code, contentType);
+  GzipStream gz(GzipStream::Options(), [&req](const uint8_t *data, size_t len) { req.streamWrite(data, len); });
+  gz.write(body.data(), body.size());
+  gz.finish();
+  req.endStream();
+}
+
+// Streams the rest of f through the gzip encoder, 1KB of input per pull as
+// the client drains the connection.
+static void sendFileGzip(hal::HttpContext &req, std::unique_ptr<hal::File> f, const char *contentType) {
+  struct State {
+    std::unique_ptr<hal::File> file;
+    std::unique_ptr<GzipStream> gz;
+    std::string *out = nullptr;
+  };
+  std::shared_ptr<State> state(new State);
+  state->file = std::move(f);
+  State *s = state.get();
+  state->gz.reset(new GzipStream(GzipStream::Options(), [s](const uint8_t *data, size_t len) {
+    s->out->append(reinterpret_cast<const char *>(data), len);
+  }));
+  req.sendHeader("Content-Encoding", "gzip");
+  req.sendHeader("Vary", "Accept-Encoding");
+  req.sendStream(200, contentType, [state](std::string &out) {
+    state->out = &out;
+    uint8_t buf[1024];
+    const size_t n = state->file->read(buf, sizeof(buf));
+    if (n > 0) {
+      state->gz->write(buf, n);
+      return true;
+    }
+    state->gz->finish();
+    state->file->close();
+    return false;
+  });
+}
+
+static bool endsWith(const ArenaString &s, const char *suffix) {
+  const size_t n = strlen(suffix);
+  return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+static const char *contentTypeFor(const ArenaString &name) {
+  if (endsWith(name, ".csv")) return "text/csv";
+  return "image/jpeg";
+}
+
+// Honours an open-ended "Range: bytes=N-" so interrupted downloads resume
+// where they stopped (tools/mirror.cpp). Other range forms get the whole
+// file, which HTTP allows.
+static void sendFileRange(hal::HttpContext &req, std::unique_ptr<hal::File> f, const char *contentType) {
+  req.sendHeader("Accept-Ranges", "bytes");
+  const std::string &range = req.header("Range");
+  unsigned long long start = 0;
+  char dash = 0;
+  int consumed = 0;
+  if (sscanf(range.c_str(), "bytes=%llu%c%n", &start, &dash, &consumed) == 2 && dash == '-' &&
+      range[consumed] == '\0') {
+    const unsigned long long size = f->size();
+    char value[64];
+    if (start >= size) {
+      snprintf(value, sizeof(value), "bytes */%llu", size);
+      req.sendHeader("Content-Range", value);
+      req.send(416, "application/json", "{\"error\":\"range not satisfiable\"}");
+      return;
+    }
+    if (f->seek(start)) {
+      snprintf(value, sizeof(value), "bytes %llu-%llu/%llu", start, size - 1, size);
+      req.sendHeader("Content-Range", value);
+      req.sendFile(206, std::move(f), contentType);
+      return;
+    }
+    f->seek(0);
+  }
+  req.sendFile(std::move(f), contentType);
+}
+
+static void handleListFrames(hal::HttpContext &req) {
+  if (!requireAuth()) return;
+  const int page = req.hasArg("page") ? atoi(req.arg("page").c_str()) : 1;
+  const int pageSize = req.hasArg("page_size") ? atoi(req.arg("page_size").c_str()) : 50;
+  [[maybe_unused]] const uint64_t t0 = hal::clock().nowMs();
+  const int startIndex = (page - 1) * pageSize;
+  int sent = 0;
+  int skipped = 0;
+
+  ArenaString payload;
+  payload.reserve(64 + static_cast<size_t>(pageSize > 0 ? pageSize : 0) * 64);
+  payload += "{\"items\":[";
+  bool first = true;
+  bool ok = hal::storage().listDir("/data", [&](const hal::DirEntry &runDir) {
+    if (runDir.isDir) {
+      const std::string runPath = "/data/" + runDir.name;
+      gFrames.listFrames(runPath, [&](const hal::DirEntry &f) {
+        if (!f.isDir) {
+          if (skipped < startIndex) {
+            ++skipped;
+          } else if (sent < pageSize) {
+            if (!first) payload += ",";
+            payload += "{\"run\":\"";
+            appendJsonEscaped(payload, runDir.name.c_str());
+            payload += "\",\"file\":\"";
+            appendJsonEscaped(payload, f.name.c_str());
+            payload += "\",\"size\":";
+            appendUnsigned(payload, static_cast<unsigned long>(f.size));
+            payload += "}";
+            first = false;
+            ++sent;
+          }
+        }
+        return sent < pageSize;
+      });
+    }
+    return sent < pageSize;
+  });
+  if (!ok) {
+    req.send(500, "application/json", "{\"error\":\"no /data\"}");
+    return;
+  }
+
+  payload += "],\"has_more\":";
+  payload += ((sent == pageSize) ? "true" : "false");
+  payload += "}";
+  sendText(req, 200, "application/json", payload);
+  LOG_DEBUG("HTTP /frames page=%d size=%d -> items=%d (took %lums)",
+            page, pageSize, sent, static_cast<unsigned long>(hal::clock().nowMs() - t0));
+}
+
+static void handleLatest(hal::HttpContext &req) {
+  if (!requireAuth()) return;
+  [[maybe_unused]] const uint64_t t0 = hal::clock().nowMs();
+  if (gLastFramePath.empty()) {
+    req.send(404, "application/json", "{\"error\":\"no frames yet\"}");
+    LOG_DEBUG("HTTP /frames/latest -> 404 (no frame) in %lums",
+              static_cast<unsigned long>(hal::clock().nowMs() - t0));
+    return;
+  }
+  std::unique_ptr<hal::File> f = openFrameFile(gLastFramePath.c_str());
+  if (!f) {
+    req.send(404, "application/json", "{\"error\":\"missing file\"}");
+    LOG_DEBUG("HTTP /frames/latest -> 404 (missing file) in %lums",
+              static_cast<unsigned long>(hal::clock().nowMs() - t0));
+    return;
+  }
+  LOG_DEBUG("HTTP /frames/latest streaming %s (%u bytes)",
+            gLastFramePath.c_str(), static_cast<unsigned>(f->size()));
+  req.sendFile(std::move(f), "image/jpeg");
+  LOG_DEBUG("HTTP /frames/latest queued in %lums",
+            static_cast<unsigned long>(hal::clock().nowMs() - t0));
+}
+
+static void handleFetchFrame(hal::HttpContext &req) {
+  if (!requireAuth()) return;
+  [[maybe_unused]] const uint64_t t0 = hal::clock().nowMs();
+  if (!req.hasArg("run") || !req.hasArg("file")) {
+    req.send(400, "application/json", "{\"error\":\"missing run or file\"}");
+    LOG_DEBUG("HTTP /frames/file -> 400 (missing args) in %lums",
+              static_cast<unsigned long>(hal::clock().nowMs() - t0));
+    return;
+  }
+  ArenaString path;
+  path.reserve(64);
+  path += "/data/";
+  path += req.arg("run").c_str();
+  path += "/";
+  path += req.arg("file").c_str();
+  const char *contentType = contentTypeFor(path);
+  const bool gzipText = endsWith(path, ".csv") && clientAcceptsGzip(req);
+  if (gzipText) {
+    // Closed runs have a pre-compressed sidecar; serve it as is.
+    ArenaString sidecar;
+    sidecar.reserve(80);
+    sidecar += "/data/";
+    sidecar += req.arg("run").c_str();
+    sidecar += "/gz/";
+    sidecar += req.arg("file").c_str();
+    sidecar += ".gz";
+    std::unique_ptr<hal::File> gzFile = hal::storage().open(sidecar.c_str(), hal::OpenMode::kRead);
+    if (gzFile) {
+      req.sendHeader("Content-Encoding", "gzip");
+      req.sendHeader("Vary", "Accept-Encoding");
+      req.sendFile(std::move(gzFile), contentType);
+      LOG_DEBUG("HTTP /frames/file %s (sidecar) queued in %lums", path.c_str(),
+                static_cast<unsigned long>(hal::clock().nowMs() - t0));
+      return;
+    }
+  }
+  std::unique_ptr<hal::File> f = openFrameFile(path.c_str());
+  if (!f) {
+    req.send(404, "application/json", "{\"error\":\"not found\"}");
+    LOG_DEBUG("HTTP /frames/file %s -> 404 in %lums", path.c_str(),
+              static_cast<unsigned long>(hal::clock().nowMs() - t0));
+    return;
+  }
+  LOG_DEBUG("HTTP /frames/file %s (%u bytes)",
+            path.c_str(), static_cast<unsigned>(f->size()));
+  if (gzipText) {
+    sendFileGzip(req, std::move(f), contentType);
+  } else {
+    sendFileRange(req, std::move(f), contentType);
+  }
+  LOG_DEBUG("HTTP /frames/file queued in %lums",
+            static_cast<unsigned long>(hal::clock().nowMs() - t0));
+}
+
+static bool checkConfigAuth() {
+  // Auth disabled: allow config page without Basic auth.
+  return true;
+}
+
+static void handleConfigForm(hal::HttpContext &req) {
+  if (!checkConfigAuth()) return;
+  auto selected = [](bool on) { return on ? " selected" : ""; };
+  ArenaString html;
+  html.reserve(2048);
+  html += "<html><body><h3>ESP32-S3-CAM-DHT Setup</h3>"
+          "<form method='POST' action='/config'>"
+          "Mode: <select name='mode'>"
+          "<option value='sta'";
+  html += selected(!gConfig.apMode);
+  html += ">STA</option><option value='ap'";
+  html += selected(gConfig.apMode);
+  html += ">AP</option></select><br/>"
+          "STA SSID: <input name='ssid' value='";
+  html += gConfig.staSsid.c_str();
+  html += "'/><br/>STA Password: <input type='password' name='pass' value='";
+  html += gConfig.staPass.c_str();
+  html += "'/><br/>AP SSID: <input name='ap_ssid' value='";
+  html += gConfig.apSsid.c_str();
+  html += "'/><br/>AP Password: <input type='password' name='ap_pass' value='";
+  html += gConfig.apPass.c_str();
+  html += "'/><br/>Cycle (ms): <input name='cycle_ms' value='";
+  appendUnsigned(html, gConfig.cycleIntervalMs);
+  html += "'/><br/>Min free (MB): <input name='min_free_mb' value='";
+  appendUnsigned(html, static_cast<unsigned long>(gConfig.minimumFreeSpace / (1024 * 1024)));
+  html += "'/><br/>Frame storage: <select name='store'><option value='files'";
+  html += selected(!gConfig.segmentStore);
+  html += ">One file per frame</option><option value='segments'";
+  html += selected(gConfig.segmentStore);
+  html += ">Segment files</option></select><br/>"
+          "Log to card (/logs): <select name='sdlog'><option value='off'";
+  html += selected(!gConfig.logToCard);
+  html += ">Off</option><option value='on'";
+  html += selected(gConfig.logToCard);
+  html += ">On</option></select><br/>"
+          "Currents (mA): <input name='currents' size='80' value='";
+  html += gConfig.currents.format().c_str();
+  html += "'/><br/>"
+          "Adaptive cycle: <select name='adaptive'><option value='off'";
+  html += selected(!gConfig.adaptive);
+  html += ">Off</option><option value='on'";
+  html += selected(gConfig.adaptive);
+  html += ">On</option></select> limits: <input name='adapt_limits' size='80' value='";
+  html += gConfig.adaptiveLimits.format().c_str();
+  html += "'/><br/>"
+          "Token: <input type='password' name='token' value='";
+  html += gConfig.token.c_str();
+  html += "'/><br/><input type='submit' value='Save'/></form></body></html>";
+  req.send(200, "text/html", html.data(), html.size());
+}
+
+static uint32_t sanitizeCycleMs(uint32_t v) {
+  if (v < kMinCycleMs || v > kMaxCycleMs) return kDefaultCycleIntervalMs;
+  return v;
+}
+
+// Moves capture and reading to a new cadence, the reading one tick behind the
+// capture as at start.
+static void setCycle(uint32_t cycleMs, uint64_t nowMs) {
+  gScheduler.setPeriod(gCaptureJob, cycleMs, nowMs);
+  gScheduler.setPeriod(gSensorJob, cycleMs, nowMs + Scheduler::kTickMs);
+}
+
+// The adaptive policy starts from the configured cycle; off, it stays there.
+static void resetSampling() {
+  gSampling.reset(gConfig.cycleIntervalMs, gConfig.adaptiveLimits);
+}
+
+static uint64_t sanitizeMinFreeBytes(uint32_t mb) {
+  if (mb < kMinFreeMb || mb > kMaxFreeMb) return kDefaultMinimumFreeSpace;
+  return static_cast<uint64_t>(mb) * 1024ULL * 1024ULL;
+}
+
+static void handleConfigPost(hal::HttpContext &req) {
+  if (!checkConfigAuth()) return;
+  gConfig.apMode = (req.arg("mode") == "ap");
+  gConfig.staSsid = req.arg("ssid");
+  gConfig.staPass = req.arg("pass");
+  gConfig.apSsid = req.arg("ap_ssid");
+  gConfig.apPass = req.arg("ap_pass");
+  gConfig.token = req.arg("token");
+  gConfig.segmentStore = (req.arg("store") == "segments");
+  gConfig.logToCard = (req.arg("sdlog") == "on");
+  if (!gConfig.currents.parse(req.arg("currents").c_str())) LOG_WARN("Ignoring malformed current profile");
+  gConfig.adaptive = (req.arg("adaptive") == "on");
+  if (!gConfig.adaptiveLimits.parse(req.arg("adapt_limits").c_str())) LOG_WARN("Ignoring malformed adaptive limits");
+
+  uint32_t newCycle = sanitizeCycleMs(strtoul(req.arg("cycle_ms").c_str(), nullptr, 10));
+  uint64_t newMinFree = sanitizeMinFreeBytes(strtoul(req.arg("min_free_mb").c_str(), nullptr, 10));
+  gConfig.cycleIntervalMs = newCycle;
+  gConfig.minimumFreeSpace = newMinFree;
+  setCycle(newCycle, hal::clock().nowMs());
+  resetSampling();
+
+  hal::Settings &prefs = hal::settings();
+  prefs.putString("mode", gConfig.apMode ? "ap" : "sta");
+  prefs.putString("ssid", gConfig.staSsid);
+  prefs.putString("pass", gConfig.staPass);
+  prefs.putString("ap_ssid", gConfig.apSsid);
+  prefs.putString("ap_pass", gConfig.apPass);
+  prefs.putString("token", gConfig.token);
+  prefs.putString("store", gConfig.segmentStore ? "segments" : "files");
+  prefs.putString("sdlog", gConfig.logToCard ? "on" : "off");
+  prefs.putString("currents", gConfig.currents.format());
+  prefs.putString("adaptive", gConfig.adaptive ? "on" : "off");
+  prefs.putString("adapt_limits", gConfig.adaptiveLimits.format());
+  prefs.putULong("cycle_ms", gConfig.cycleIntervalMs);
+  prefs.putULong("min_free_mb", static_cast<uint32_t>(gConfig.minimumFreeSpace / (1024 * 1024)));
+
+  req.send(200, "text/plain", "Saved. Reboot device.");
+}
+
+// GET /events: Server-Sent Events stream with "frame" and "reading" events,
+// so clients need not poll /frames. See EventHub for the queueing rules.
+static void handleEvents(hal::HttpContext &req) {
+  if (!requireAuth()) return;
+  if (gEvents.full()) {
+    req.send(503, "application/json", "{\"error\":\"too many subscribers\"}");
+    return;
+  }
+  std::unique_ptr<hal::EventChannel> channel = req.openEventStream();
+  if (channel) gEvents.subscribe(std::move(channel), hal::clock().nowMs());
+}
+
+static void handleSchedulerStats(hal::HttpContext &req) {
+  ArenaString payload;
+  payload.reserve(1024);
+  payload += "{\"jobs\":[";
+  for (size_t i = 0; i < gScheduler.jobCount(); ++i) {
+    const Scheduler::JobStats &s = gScheduler.stats(static_cast<int>(i));
+    if (i > 0) payload += ",";
+    payload += "{\"name\":\"";
+    appendJsonEscaped(payload, s.name);
+    payload += "\"";
+    appendField(payload, "period_ms", s.periodMs);
+    appendField(payload, "runs", s.runs);
+    appendField(payload, "missed", s.missed);
+    appendField(payload, "last_jitter_ms", s.lastJitterMs);
+    appendField(payload, "max_jitter_ms", s.maxJitterMs);
+    appendField(payload, "last_duration_ms", s.lastDurationMs);
+    payload += "}";
+  }
+  const EventHub::Stats &ev = gEvents.stats();
+  payload += "],\"events\":{\"clients\":";
+  appendUnsigned(payload, static_cast<unsigned long>(gEvents.clientCount()));
+  appendField(payload, "published", ev.published);
+  appendField(payload, "overflows", ev.overflows);
+  appendField(payload, "dropped", ev.dropped);
+  const hal::LogStats log = hal::logStats();
+  payload += "},\"log\":{\"written\":";
+  appendUnsigned(payload, log.written);
+  appendField(payload, "dropped", log.dropped);
+  appendField(payload, "high_water", log.highWater);
+  appendField(payload, "file_bytes", log.fileBytes);
+  payload += "}}";
+  req.send(200, "application/json", payload.data(), payload.size());
+}
+
+static void appendHeapRegion(ArenaString &out, const char *name, const MemoryMonitor::Region &r) {
+  out += ",\"";
+  out += name;
+  out += "\":{\"present\":";
+  out += r.now.present ? "true" : "false";
+  appendField(out, "total", r.now.totalBytes);
+  appendField(out, "free", r.now.freeBytes);
+  appendField(out, "largest_free_block", r.now.largestFreeBlock);
+  appendField(out, "min_free", r.now.minFreeBytes);
+  appendField(out, "min_largest_free_block", r.minLargestFreeBlock);
+  appendField(out, "fragmentation_pct", r.fragmentationPct);
+  appendField(out, "max_fragmentation_pct", r.maxFragmentationPct);
+  out += "}";
+}
+
+// GET /stats/memory: heap regions now and at their worst, the scratch arena,
+// and a day of half-hourly [sec, internal free, internal largest, psram free,
+// psram largest] points.
+static void handleMemoryStats(hal::HttpContext &req) {
+  gMemory.sample(hal::clock().nowMs());
+  const Arena::Stats arena = scratchArena().stats();
+  ArenaString payload;
+  payload.reserve(512 + MemoryMonitor::kHistory * 56);
+  payload += "{\"uptime_s\":";
+  appendUnsigned(payload, static_cast<unsigned long>(hal::clock().nowMs() / 1000ULL));
+  appendHeapRegion(payload, "internal", gMemory.internal());
+  appendHeapRegion(payload, "psram", gMemory.psram());
+  payload += ",\"arena\":{\"capacity\":";
+  appendUnsigned(payload, static_cast<unsigned long>(arena.capacity));
+  appendField(payload, "high_water", static_cast<unsigned long>(arena.highWater));
+  appendField(payload, "overflows", arena.overflows);
+  payload += "},\"history\":[";
+  for (size_t i = 0; i < gMemory.historySize(); ++i) {
+    const MemoryMonitor::Point &p = gMemory.history(i);
+    char buf[80];
+    snprintf(buf, sizeof(buf), "%s[%lu,%lu,%lu,%lu,%lu]", i ? "," : "", static_cast<unsigned long>(p.sec),
+             static_cast<unsigned long>(p.internalFree), static_cast<unsigned long>(p.internalLargest),
+             static_cast<unsigned long>(p.psramFree), static_cast<unsigned long>(p.psramLargest));
+    payload += buf;
+  }
+  payload += "]}";
+  req.send(200, "application/json", payload.data(), payload.size());
+}
+
+static void appendEnergyTotals(ArenaString &out, const char *name, const EnergyModel::Totals &t) {
+  out += ",\"";
+  out += name;
+  out += "\":{\"elapsed_ms\":";
+  appendUnsigned(out, static_cast<unsigned long>(t.elapsedUs / 1000ULL));
+  appendField(out, "cycles", t.cycles);
+  out += ",\"active_ms\":{";
+  for (int s = 0; s < EnergyModel::kSubsystemCount; ++s) {
+    if (s) out += ",";
+    out += "\"";
+    out += EnergyModel::kName[s];
+    out += "\":";
+    appendUnsigned(out, static_cast<unsigned long>(t.activeUs[s] / 1000ULL));
+  }
+  char buf[64];
+  snprintf(buf, sizeof(buf), "},\"mah\":%.4f,\"mah_per_day\":%.1f}", t.mAh(gConfig.currents),
+           t.mAhPerDay(gConfig.currents));
+  out += buf;
+}
+
+// GET /stats/energy: active time per subsystem for the last capture cycle,
+// the current uptime day and since boot, priced with the configured currents.
+static void handleEnergyStats(hal::HttpContext &req) {
+  const uint64_t nowUs = hal::clock().nowUs();
+  ArenaString payload;
+  payload.reserve(1024);
+  payload += "{\"cycle_ms\":";
+  appendUnsigned(payload, gConfig.cycleIntervalMs);
+  payload += ",\"currents\":\"";
+  payload += gConfig.currents.format().c_str();
+  payload += "\"";
+  appendEnergyTotals(payload, "last_cycle", gEnergy.lastCycle());
+  appendEnergyTotals(payload, "today", gEnergy.today(nowUs));
+  appendEnergyTotals(payload, "since_boot", gEnergy.sinceBoot(nowUs));
+  payload += "}";
+  req.send(200, "application/json", payload.data(), payload.size());
+}
+
+// GET /stats/io: card bus use per I/O class, in priority order.
+static void handleIoStats(hal::HttpContext &req) {
+  static const char *const kClassName[hal::kIoClassCount] = {"capture", "log", "bulk"};
+  const hal::IoStats io = hal::ioStats();
+  ArenaString payload;
+  payload.reserve(768);
+  payload += "{";
+  for (int c = 0; c < hal::kIoClassCount; ++c) {
+    const hal::IoClassStats &s = io.cls[c];
+    if (c) payload += ",";
+    payload += "\"";
+    payload += kClassName[c];
+    payload += "\":{\"ops\":";
+    appendUnsigned(payload, s.ops);
+    appendField(payload, "kbytes", static_cast<unsigned long>(s.bytes / 1024));
+    appendField(payload, "waited", s.waited);
+    appendField(payload, "queued", s.queued);
+    appendField(payload, "max_queued", s.maxQueued);
+    appendField(payload, "mean_wait_us", static_cast<unsigned long>(s.waited ? s.totalWaitUs / s.waited : 0));
+    appendField(payload, "max_wait_us", s.maxWaitUs);
+    appendField(payload, "max_hold_us", s.maxHoldUs);
+    payload += "}";
+  }
+  payload += "}";
+  req.send(200, "application/json", payload.data(), payload.size());
+}
+
+// GET /stats/sampling: the adaptive cycle, why it last changed and the rates
+// behind it.
+static void handleSamplingStats(hal::HttpContext &req) {
+  const SamplingPolicy::Stats &s = gSampling.stats();
+  ArenaString payload;
+  payload.reserve(512);
+  payload += "{\"adaptive\":";
+  payload += gConfig.adaptive ? "true" : "false";
+  appendField(payload, "cycle_ms", gConfig.adaptive ? s.periodMs : gConfig.cycleIntervalMs);
+  appendField(payload, "fast_ms", gSampling.fastMs());
+  appendField(payload, "slow_ms", gSampling.slowMs());
+  payload += ",\"reason\":\"";
+  payload += SamplingPolicy::kReasonName[s.reason];
+  payload += "\"";
+  appendField(payload, "readings", s.readings);
+  appendField(payload, "speed_ups", s.speedUps);
+  appendField(payload, "backoffs", s.backoffs);
+  appendField(payload, "rate_triggers", s.rateTriggers);
+  appendField(payload, "step_triggers", s.stepTriggers);
+  appendField(payload, "band_triggers", s.bandTriggers);
+  char buf[96];
+  snprintf(buf, sizeof(buf), ",\"temp_rate\":%.2f,\"hum_rate\":%.2f,\"limits\":\"", s.tempRate, s.humRate);
+  payload += buf;
+  payload += gConfig.adaptiveLimits.format().c_str();
+  payload += "\"}";
+  req.send(200, "application/json", payload.data(), payload.size());
+}
+
+// GET /stats/network: station link state, connect/reconnect times and the
+// boot-to-first-frame time.
+static void handleNetworkStats(hal::HttpContext &req) {
+  static const char *const kStateName[] = {"off", "connecting", "connected", "backoff"};
+  const WifiLink::Stats link = gWifi.stats();
+  ArenaString payload;
+  payload.reserve(512);
+  payload += "{\"state\":\"";
+  payload += kStateName[static_cast<int>(link.state)];
+  payload += "\",\"sta\":";
+  payload += link.sta ? "true" : "false";
+  payload += ",\"portal\":";
+  payload += link.portal ? "true" : "false";
+  appendField(payload, "first_frame_ms", static_cast<unsigned long>(gFirstFrameMs));
+  appendField(payload, "first_connect_ms", link.firstConnectMs);
+  appendField(payload, "last_reconnect_ms", link.lastReconnectMs);
+  appendField(payload, "max_reconnect_ms", link.maxReconnectMs);
+  appendField(payload, "attempts", link.attempts);
+  appendField(payload, "fast_attempts", link.fastAttempts);
+  appendField(payload, "connects", link.connects);
+  appendField(payload, "drops", link.drops);
+  appendField(payload, "failures", link.failures);
+  char reason[32];
+  snprintf(reason, sizeof(reason), ",\"last_reason\":%d}", link.lastReason);
+  payload += reason;
+  req.send(200, "application/json", payload.data(), payload.size());
+}
+
+// GET /readings?from=&to=&step=&run= (seconds on the readings.csv clock).
+// Answers from the coarsest rollup tier that still resolves step, so the
+// payload size depends on (to - from) / step only.
+static void handleReadings(hal::HttpContext &req) {
+  if (!requireAuth()) return;
+  constexpr uint32_t kDefaultPoints = 300;
+  const uint32_t nowSec = static_cast<uint32_t>(hal::clock().nowMs() / 1000ULL);
+  const uint32_t from = req.hasArg("from") ? strtoul(req.arg("from").c_str(), nullptr, 10) : 0;
+  const uint32_t to = req.hasArg("to") ? strtoul(req.arg("to").c_str(), nullptr, 10) : nowSec + 1;
+  uint32_t step = req.hasArg("step") ? strtoul(req.arg("step").c_str(), nullptr, 10) : 0;
+  std::string runDir = sessionDir;
+  if (req.hasArg("run")) runDir = "/data/" + req.arg("run");
+
+  size_t tier = Rollups::pickTier(step);
+  if (step == 0 && to > from) {
+    // No step given: use the finest tier that keeps the answer within about
+    // kDefaultPoints points.
+    const uint32_t wanted = (to - from) / kDefaultPoints;
+    tier = Rollups::kTierCount - 1;
+    for (size_t i = 0; i < Rollups::kTierCount; ++i) {
+      if (Rollups::kTierWidthSec[i] >= wanted) {
+        tier = i;
+        break;
+      }
+    }
+  }
+  if (step < Rollups::kTierWidthSec[tier]) step = Rollups::kTierWidthSec[tier];
+
+  // Points are [start, count, tMin, tMax, tMean, hMin, hMax, hMean].
+  ArenaString payload;
+  payload.reserve(4096);
+  payload += "{\"tier\":\"";
+  payload += Rollups::kTierName[tier];
+  payload += "\",\"step\":";
+  appendUnsigned(payload, step);
+  payload += ",\"points\":[";
+  bool first = true;
+  gRollups.query(runDir, tier, from, to, step, [&](const RollupRecord &r) {
+    char buf[96];
+    snprintf(buf, sizeof(buf), "%s[%lu,%u,%d,%d,%.1f,%d,%d,%.1f]", first ? "" : ",",
+             static_cast<unsigned long>(r.startSec), r.count,
+             r.tempMin, r.tempMax, static_cast<double>(r.tempSum) / r.count,
+             r.humMin, r.humMax, static_cast<double>(r.humSum) / r.count);
+    payload += buf;
+    first = false;
+  });
+  payload += "]}";
+  sendText(req, 200, "application/json", payload);
+}
+
+static void handleBrowse(hal::HttpContext &req) {
+  // Simple HTML browser for manual download without token.
+  ArenaString html;
+  html.reserve(16 * 1024);
+  html += "<html><body><h3>Files</h3><ul>";
+  bool ok = hal::storage().listDir("/data", [&](const hal::DirEntry &runDir) {
+    if (runDir.isDir) {
+      const std::string runPath = "/data/" + runDir.name;
+      html += "<li>";
+      html += runPath.c_str();
+      html += "<ul>";
+      gFrames.listFrames(runPath, [&](const hal::DirEntry &f) {
+        if (!f.isDir) {
+          html += "<li><a href=\"/frames/file?run=";
+          html += runDir.name.c_str();
+          html += "&file=";
+          html += f.name.c_str();
+          html += "\">";
+          html += f.name.c_str();
+          html += "</a> (";
+          appendUnsigned(html, static_cast<unsigned long>(f.size));
+          html += " bytes)</li>";
+        }
+        return true;
+      });
+      html += "</ul></li>";
+    }
+    return true;
+  });
+  if (!ok) {
+    req.send(500, "text/plain", "SD not ready");
+    return;
+  }
+  html += "</ul></body></html>";
+  sendText(req, 200, "text/html", html);
+}
+
+// Each request gets the scratch arena back when its handler returns.
+static hal::HttpHandler scoped(void (*handler)(hal::HttpContext &)) {
+  return [handler](hal::HttpContext &req) {
+    ArenaScope scope(scratchArena());
+    handler(req);
+  };
+}
+
+static Scheduler::JobFn scoped(void (*job)()) {
+  return [job]() {
+    ArenaScope scope(scratchArena());
+    job();
+  };
+}
+
+void registerHttpHandlers() {
+  hal::HttpServer &server = hal::http();
+  server.on("/frames", hal::HttpMethod::kGet, scoped(handleListFrames));
+  server.on("/frames/latest", hal::HttpMethod::kGet, scoped(handleLatest));
+  server.on("/frames/file", hal::HttpMethod::kGet, scoped(handleFetchFrame));
+  server.on("/config", hal::HttpMethod::kGet, scoped(handleConfigForm));
+  server.on("/config", hal::HttpMethod::kPost, scoped(handleConfigPost));
+  server.on("/browse", hal::HttpMethod::kGet, scoped(handleBrowse));
+  server.on("/readings", hal::HttpMethod::kGet, scoped(handleReadings));
+  server.on("/stats/scheduler", hal::HttpMethod::kGet, scoped(handleSchedulerStats));
+  server.on("/stats/memory", hal::HttpMethod::kGet, scoped(handleMemoryStats));
+  server.on("/stats/energy", hal::HttpMethod::kGet, scoped(handleEnergyStats));
+  server.on("/stats/network", hal::HttpMethod::kGet, scoped(handleNetworkStats));
+  server.on("/stats/io", hal::HttpMethod::kGet, scoped(handleIoStats));
+  server.on("/stats/sampling", hal::HttpMethod::kGet, scoped(handleSamplingStats));
+  server.on("/events", hal::HttpMethod::kGet, scoped(handleEvents));
+  server.begin();
+  LOG_INFO("HTTP server started");
+}
+
+void loadPrefs() {
+  hal::Settings &prefs = hal::settings();
+  gConfig.apMode = prefs.getString("mode", "sta") == "ap";
+  gConfig.staSsid = prefs.getString("ssid", "");
+  gConfig.staPass = prefs.getString("pass", "");
+  gConfig.apSsid = prefs.getString("ap_ssid", kDefaultApSsid);
+  gConfig.apPass = prefs.getString("ap_pass", kDefaultApPass);
+  gConfig.token = prefs.getString("token", "changeme");
+  gConfig.segmentStore = prefs.getString("store", "files") == "segments";
+  gConfig.logToCard = prefs.getString("sdlog", "off") == "on";
+  gConfig.currents = EnergyModel::Profile();
+  gConfig.currents.parse(prefs.getString("currents", "").c_str());
+  gConfig.adaptive = prefs.getString("adaptive", "off") == "on";
+  gConfig.adaptiveLimits = SamplingPolicy::Limits();
+  gConfig.adaptiveLimits.parse(prefs.getString("adapt_limits", "").c_str());
+  uint32_t storedCycle = prefs.getULong("cycle_ms", kDefaultCycleIntervalMs);
+  uint32_t storedMinFreeMb = prefs.getULong("min_free_mb", static_cast<uint32_t>(kDefaultMinimumFreeSpace / (1024 * 1024)));
+  gConfig.cycleIntervalMs = sanitizeCycleMs(storedCycle);
+  gConfig.minimumFreeSpace = sanitizeMinFreeBytes(storedMinFreeMb);
+}
+
+// ----------------- Setup & loop -----------------
+
+bool appSetup() {
+  gEnergy = EnergyModel(hal::clock().nowUs());
+  setActive(EnergyModel::kCpu, true);
+  if (!initSdCard()) {
+    LOG_ERROR("SD init failed; halt");
+    return false;
+  }
+  if (!ensureDir("/data")) {
+    LOG_ERROR("Failed to create /data; halt");
+    return false;
+  }
+  if (gConfig.logToCard && ensureDir("/logs")) hal::logToFile("/logs");
+
+  // Determine next run directory by scanning existing run_* folders. Every
+  // existing run is closed, so queue it for CSV pre-compression.
+  uint32_t maxRun = 0;
+  hal::storage().listDir("/data", [&](const hal::DirEntry &d) {
+    if (d.isDir) {
+      gSidecar.pendingRuns.push_back(d.name);
+      size_t idx = d.name.rfind('_');  // e.g. run_0005
+      if (idx != std::string::npos) {
+        uint32_t val = static_cast<uint32_t>(strtoul(d.name.c_str() + idx + 1, nullptr, 10));
+        if (val > maxRun) maxRun = val;
+      }
+    }
+    return true;
+  });
+  gRunIndex = maxRun + 1;
+  char dirBuf[32];
+  snprintf(dirBuf, sizeof(dirBuf), "/data/run_%04lu", static_cast<unsigned long>(gRunIndex));
+  if (!ensureDir(dirBuf)) {
+    LOG_ERROR("Failed to create run directory; halt");
+    return false;
+  }
+  sessionDir = dirBuf;
+  LOG_INFO("Session dir: %s", sessionDir.c_str());
+  gFrames.begin(sessionDir);
+  if (maxRun > 0) {
+    // A reset leaves the previous run's last segment without its index.
+    snprintf(dirBuf, sizeof(dirBuf), "/data/run_%04lu", static_cast<unsigned long>(maxRun));
+    gFrames.recover(dirBuf);
+  }
+  if (!gRollups.begin(sessionDir)) {
+    LOG_ERROR("Failed to create rollup directory");
+  }
+
+  if (!ensureCameraReady()) {
+    LOG_ERROR("Camera init failed; halt");
+    return false;
+  }
+  return true;
+}
+
+void appFirstCapture() {
+  if (captureAndSave("Not enough space for initial frame")) {
+    benchmarkSdRead(gLastFramePath.c_str());
+  }
+  powerDownCamera();
+}
+
+// Closes the energy cycle at the top of each capture. Once a day of uptime
+// has gone by, its totals go to <run>/energy.csv.
+static void energyCycleEnd() {
+  const uint64_t nowUs = hal::clock().nowUs();
+  gEnergy.endCycle(nowUs);
+  EnergyModel::Totals day;
+  if (!gEnergy.rollDay(nowUs, day)) return;
+  const double mAh = day.mAh(gConfig.currents);
+  LOG_INFO("Energy: %lu cycles, %.1f mAh over the last day", static_cast<unsigned long>(day.cycles), mAh);
+
+  char path[64];
+  snprintf(path, sizeof(path), "%s/energy.csv", sessionDir.c_str());
+  ActiveScope sd(EnergyModel::kSd);
+  const bool fresh = !hal::storage().exists(path);
+  std::unique_ptr<hal::File> file = hal::storage().open(path, hal::OpenMode::kAppend);
+  if (!file) {
+    LOG_ERROR("Failed to open %s for append", path);
+    return;
+  }
+  std::string line;
+  if (fresh) {
+    line = "day,uptime_s,cycles";
+    for (int s = 0; s < EnergyModel::kSubsystemCount; ++s) {
+      line += ',';
+      line += EnergyModel::kName[s];
+      line += "_s";
+    }
+    line += ",mah\n";
+  }
+  char buf[48];
+  snprintf(buf, sizeof(buf), "%lu,%llu,%lu", static_cast<unsigned long>(nowUs / EnergyModel::kDayUs),
+           static_cast<unsigned long long>(nowUs / 1000000ULL), static_cast<unsigned long>(day.cycles));
+  line += buf;
+  for (int s = 0; s < EnergyModel::kSubsystemCount; ++s) {
+    snprintf(buf, sizeof(buf), ",%.1f", static_cast<double>(day.activeUs[s]) / 1e6);
+    line += buf;
+  }
+  snprintf(buf, sizeof(buf), ",%.2f\n", mAh);
+  line += buf;
+  file->write(reinterpret_cast<const uint8_t *>(line.data()), line.size());
+  file->close();
+}
+
+static void captureJob() {
+  energyCycleEnd();
+  uint64_t freeBytes = sdFreeBytes();
+  if (freeBytes < gConfig.minimumFreeSpace) {
+    LOG_WARN("Not enough free space on TF card; skipping capture");
+    powerDownCamera();
+  } else if (!ensureCameraReady()) {
+    LOG_WARN("Camera init failed; skipping capture");
+  } else {
+    captureAndSave("Not enough space for this frame");
+    powerDownCamera();
+  }
+}
+
+static void sensorJob() {
+  int temperatureC = 0;
+  int humidity = 0;
+  setActive(EnergyModel::kDht, true);
+  const bool read = hal::dht().read(temperatureC, humidity);
+  setActive(EnergyModel::kDht, false);
+  if (read) {
+    gSmoother.add(temperatureC, humidity);
+    int smoothTemp = gSmoother.avgTemp();
+    int smoothHum = gSmoother.avgHum();
+    if (gConfig.adaptive) {
+      const uint32_t before = gSampling.periodMs();
+      const uint32_t cycle = gSampling.update(hal::clock().nowMs(), smoothTemp, smoothHum);
+      if (cycle != before) {
+        LOG_INFO("Cycle %lu -> %lu ms (%s)", static_cast<unsigned long>(before), static_cast<unsigned long>(cycle),
+                 SamplingPolicy::kReasonName[gSampling.stats().reason]);
+        setCycle(cycle, hal::clock().nowMs());
+      }
+    }
+    if (appendReading(smoothTemp, smoothHum)) {
+      gRollups.add(static_cast<uint32_t>(hal::clock().nowMs() / 1000ULL), smoothTemp, smoothHum);
+      LOG_INFO("Logged T=%dC H=%d%% (raw %d/%d)",
+               smoothTemp, smoothHum, temperatureC, humidity);
+      ++gReadingIndex;
+    } else {
+      LOG_ERROR("Failed to append reading");
+    }
+  } else {
+    LOG_WARN("DHT11 read failed");
+  }
+}
+
+// Compresses up to kSidecarSliceBytes of one closed run's readings.csv per
+// call. The sidecar is written under a temporary name and renamed when done.
+static void sidecarJob() {
+  SidecarJob &job = gSidecar;
+  if (!job.src && job.pendingRuns.empty()) return;
+  ActiveScope card(EnergyModel::kSd);
+  hal::Storage &sd = hal::storage();
+  while (!job.src) {
+    if (job.pendingRuns.empty()) return;
+    job.run = job.pendingRuns.back();
+    job.pendingRuns.pop_back();
+    const std::string runDir = "/data/" + job.run;
+    const std::string csv = runDir + "/readings.csv";
+    const std::string gzDir = runDir + "/gz";
+    const std::string sidecar = gzDir + "/readings.csv.gz";
+    if (sd.exists(sidecar.c_str()) || !sd.exists(csv.c_str())) continue;
+    if (!sd.exists(gzDir.c_str()) && !sd.mkdir(gzDir.c_str())) continue;
+    const std::string tmp = sidecar + ".tmp";
+    job.src = sd.open(csv.c_str(), hal::OpenMode::kRead);
+    job.dst = sd.openFor(tmp.c_str(), hal::OpenMode::kWrite, hal::IoClass::kBulk);
+    if (!job.src || !job.dst) {
+      job.src.reset();
+      job.dst.reset();
+      continue;
+    }
+    hal::File *dst = job.dst.get();
+    job.gz.reset(new GzipStream(GzipStream::Options(), [dst](const uint8_t *data, size_t len) { dst->write(data, len); }));
+  }
+
+  uint8_t buf[1024];
+  size_t done = 0;
+  while (done < kSidecarSliceBytes) {
+    size_t n = job.src->read(buf, sizeof(buf));
+    if (n == 0) break;
+    job.gz->write(buf, n);
+    done += n;
+  }
+  if (done == kSidecarSliceBytes) return;  // more to do next time
+
+  job.gz->finish();
+  const uint64_t in = job.gz->bytesIn();
+  const uint64_t out = job.gz->bytesOut();
+  job.gz.reset();
+  job.src->close();
+  job.dst->close();
+  job.src.reset();
+  job.dst.reset();
+  const std::string sidecar = "/data/" + job.run + "/gz/readings.csv.gz";
+  const std::string tmp = sidecar + ".tmp";
+  if (sd.rename(tmp.c_str(), sidecar.c_str())) {
+    LOG_INFO("Compressed %s/readings.csv: %llu -> %llu bytes", job.run.c_str(),
+             static_cast<unsigned long long>(in), static_cast<unsigned long long>(out));
+  } else {
+    sd.remove(tmp.c_str());
+  }
+}
+
+void appStartJobs() {
+  const uint64_t now = hal::clock().nowMs();
+  const uint32_t cycle = gConfig.cycleIntervalMs;
+  gCaptureJob = gScheduler.addPeriodic("capture", cycle, cycle, now, scoped(captureJob));
+  // The reading follows the capture within the same cycle, as before.
+  gSensorJob = gScheduler.addPeriodic("sensor", cycle, cycle + Scheduler::kTickMs, now, scoped(sensorJob));
+  resetSampling();
+  gScheduler.addPeriodic("gzip", kSidecarJobMs, kSidecarJobMs, now, sidecarJob);
+  gScheduler.addPeriodic("events", kEventKeepAliveMs, kEventKeepAliveMs, now,
+                         []() { gEvents.keepAlive(hal::clock().nowMs()); });
+  gMemory.sample(now);
+  gScheduler.addPeriodic("memory", kMemorySampleMs, kMemorySampleMs, now,
+                         []() { gMemory.sample(hal::clock().nowMs()); });
+}
+
+// Follows the radios the Wi-Fi link has up, for the energy accounting.
+static void syncRadioEnergy() {
+  const WifiLink::Stats link = gWifi.stats();
+  if (link.sta != gEnergy.active(EnergyModel::kWifiSta)) setActive(EnergyModel::kWifiSta, link.sta);
+  if (link.portal != gEnergy.active(EnergyModel::kWifiAp)) setActive(EnergyModel::kWifiAp, link.portal);
+}
+
+void appLoop(uint32_t maxWaitMs) {
+  hal::Clock &clk = hal::clock();
+  syncRadioEnergy();
+  gScheduler.runDue(clk.nowMs(), [&clk]() { return clk.nowMs(); });
+  {
+    ActiveScope radio(EnergyModel::kRadio);
+    hal::http().poll();
+    // Retry event data a full socket buffer held back earlier.
+    gEvents.pump(clk.nowMs());
+  }
+  // Sleep until the next job or an HTTP client, whichever comes first. The
+  // task blocks here, so the idle task can put the chip into light sleep.
+  setActive(EnergyModel::kCpu, false);
+  const uint32_t untilNext = gScheduler.msUntilNext(clk.nowMs());
+  hal::http().waitForActivity(untilNext < maxWaitMs ? untilNext : maxWaitMs);
+  setActive(EnergyModel::kCpu, true);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "energy.h"
+#include "sampling_policy.h"
+#include "wifi_link.h"
+
+// Platform independent capture/log/serve logic. Talks to the hardware only
+// through hal/hal.h so the same code runs on the board and in the simulator.
+
+struct AppConfig {
+  std::string staSsid;
+  std::string staPass;
+  std::string apSsid;
+  std::string apPass;
+  std::string token;
+  bool apMode = false;
+  uint32_t cycleIntervalMs = 0;
+  uint64_t minimumFreeSpace = 0;
+  bool segmentStore = false;  // frames in segment files (FrameStore) instead of one file each
+  bool logToCard = false;     // copy the console log to rotating files in /logs
+  EnergyModel::Profile currents;  // battery-side current per subsystem, for /stats/energy
+  bool adaptive = false;          // cycle follows SamplingPolicy instead of staying at cycleIntervalMs
+  SamplingPolicy::Limits adaptiveLimits;
+};
+
+AppConfig &appConfig();
+
+// Station link state shared by the Wi-Fi driver glue (main.cpp) and the
+// /stats/network route.
+WifiLink &wifiLink();
+
+// Loads AppConfig from hal::settings().
+void loadPrefs();
+
+// Mounts storage, creates the next /data/run_xxxx directory and brings the
+// camera up. Returns false when the device cannot log (caller should halt).
+bool appSetup();
+
+// Registers the HTTP routes on hal::http() and starts the server.
+void registerHttpHandlers();
+
+// Initial capture done once at boot (also runs the SD read benchmark).
+void appFirstCapture();
+
+// Registers the periodic jobs (capture, sensor read) on the scheduler. The
+// first run is one cycle after this call.
+void appStartJobs();
+
+// One iteration of the main loop: runs due jobs, services HTTP clients and
+// then blocks until the next deadline or incoming request, or for at most
+// maxWaitMs (hal::http().wake() also ends the wait).
+void appLoop(uint32_t maxWaitMs = UINT32_MAX);
@@ -0,0 +1,52 @@
+#include "arena.h"
+
+#include <cstdlib>
+
+namespace {
+
+constexpr size_t kAlign = alignof(std::max_align_t);
+
+size_t alignUp(size_t v) { return (v + kAlign - 1) & ~(kAlign - 1); }
+
+}  // namespace
+
+Arena::Arena(size_t capacity) : base_(static_cast<uint8_t *>(malloc(capacity))), capacity_(base_ ? capacity : 0) {}
+
+Arena::~Arena() { free(base_); }
+
+void *Arena::allocate(size_t bytes) {
+  const size_t size = alignUp(bytes ? bytes : 1);
+  if (size > capacity_ - top_) {
+    ++overflows_;
+    return malloc(size);
+  }
+  void *p = base_ + top_;
+  top_ += size;
+  if (top_ > highWater_) highWater_ = top_;
+  return p;
+}
+
+void Arena::deallocate(void *p, size_t bytes) {
+  if (!p) return;
+  if (!owns(p)) {
+    free(p);
+    return;
+  }
+  // Only the newest block can be given back early; the rest goes when the
+  // scope ends.
+  if (static_cast<uint8_t *>(p) + alignUp(bytes ? bytes : 1) == base_ + top_) top_ = static_cast<uint8_t *>(p) - base_;
+}
+
+Arena::Stats Arena::stats() const {
+  Stats s;
+  s.capacity = capacity_;
+  s.used = top_;
+  s.highWater = highWater_;
+  s.overflows = overflows_;
+  return s;
+}
+
+Arena &scratchArena() {
+  static Arena arena(kScratchArenaBytes);
+  return arena;
+}
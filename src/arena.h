@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Bump allocator for the short-lived strings and buffers a request handler
+// or a capture/sensor cycle builds. The backing block is allocated once at
+// boot (PSRAM when present: malloc puts blocks this large there), so
+// temporaries stop punching holes into the internal heap that the camera
+// and Wi-Fi drivers need over weeks of uptime.
+//
+// Memory is handed out by bumping a pointer and reclaimed wholesale when the
+// enclosing ArenaScope ends (freeing the newest allocation also steps the
+// pointer back). Growing strings leave their old buffers behind until then,
+// so builders reserve() a good guess first. When the block is exhausted,
+// allocations fall back to the heap and are counted.
+//
+// Not thread safe: only the loop task (handlers and scheduler jobs) uses
+// scratchArena().
+class Arena {
+ public:
+  struct Stats {
+    size_t capacity = 0;
+    size_t used = 0;
+    size_t highWater = 0;
+    uint32_t overflows = 0;  // allocations that went to the heap instead
+  };
+
+  explicit Arena(size_t capacity);
+  ~Arena();
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  void *allocate(size_t bytes);
+  void deallocate(void *p, size_t bytes);
+
+  size_t mark() const { return top_; }
+  // Releases everything allocated since mark.
+  void rewind(size_t mark) { top_ = mark; }
+
+  Stats stats() const;
+
+ private:
+  bool owns(const void *p) const {
+    return static_cast<const uint8_t *>(p) >= base_ && static_cast<const uint8_t *>(p) < base_ + capacity_;
+  }
+
+  uint8_t *base_;
+  size_t capacity_;
+  size_t top_ = 0;
+  size_t highWater_ = 0;
+  uint32_t overflows_ = 0;
+};
+
+// Arena shared by the loop task, kScratchArenaBytes big.
+Arena &scratchArena();
+constexpr size_t kScratchArenaBytes = 32 * 1024;
+
+// Rewinds the arena to where it was when the scope began. Anything allocated
+// from the arena inside the scope must be gone by then.
+class ArenaScope {
+ public:
+  explicit ArenaScope(Arena &arena) : arena_(arena), mark_(arena.mark()) {}
+  ~ArenaScope() { arena_.rewind(mark_); }
+  ArenaScope(const ArenaScope &) = delete;
+  ArenaScope &operator=(const ArenaScope &) = delete;
+
+ private:
+  Arena &arena_;
+  size_t mark_;
+};
+
+// std allocator over scratchArena().
+template <class T>
+class ArenaAllocator {
+ public:
+  using value_type = T;
+
+  ArenaAllocator() = default;
+  template <class U>
+  ArenaAllocator(const ArenaAllocator<U> &) {}
+
+  T *allocate(size_t n) { return static_cast<T *>(scratchArena().allocate(n * sizeof(T))); }
+  void deallocate(T *p, size_t n) { scratchArena().deallocate(p, n * sizeof(T)); }
+
+  template <class U>
+  bool operator==(const ArenaAllocator<U> &) const { return true; }
+  template <class U>
+  bool operator!=(const ArenaAllocator<U> &) const { return false; }
+};
+
+using ArenaString = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
@@ -0,0 +1,24 @@
+#include "crc32.h"
+
+namespace {
+
+uint32_t gTable[256];
+bool gTableReady = false;
+
+void initTable() {
+  for (uint32_t n = 0; n < 256; ++n) {
+    uint32_t c = n;
+    for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+    gTable[n] = c;
+  }
+  gTableReady = true;
+}
+
+}  // namespace
+
+uint32_t crc32Update(uint32_t crc, const uint8_t *data, size_t len) {
+  if (!gTableReady) initTable();
+  crc ^= 0xFFFFFFFFu;
+  for (size_t i = 0; i < len; ++i) crc = gTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  return crc ^ 0xFFFFFFFFu;
+}
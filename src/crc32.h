@@ -0,0 +1,8 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// CRC-32 (IEEE 802.3, as in gzip and zip). Start with crc = 0 and feed the
+// previous result back in to continue over several buffers.
+uint32_t crc32Update(uint32_t crc, const uint8_t *data, size_t len);
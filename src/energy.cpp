@@ -0,0 +1,106 @@
+#include "energy.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+const char *const EnergyModel::kName[kSubsystemCount] = {"cpu", "camera", "sd", "dht", "wifi_sta", "wifi_ap", "radio"};
+
+namespace {
+
+constexpr double kUsPerHour = 3600.0 * 1e6;
+
+}  // namespace
+
+bool EnergyModel::Profile::parse(const char *spec) {
+  Profile p = *this;
+  while (*spec) {
+    const char *eq = strchr(spec, '=');
+    if (!eq) return false;
+    const size_t nameLen = static_cast<size_t>(eq - spec);
+    char *end = nullptr;
+    const float value = strtof(eq + 1, &end);
+    if (end == eq + 1 || value < 0 || (*end && *end != ',')) return false;
+    if (nameLen == 5 && strncmp(spec, "sleep", 5) == 0) p.sleepMa = value;
+    for (int s = 0; s < kSubsystemCount; ++s) {
+      if (strlen(kName[s]) == nameLen && strncmp(spec, kName[s], nameLen) == 0) p.ma[s] = value;
+    }
+    spec = *end ? end + 1 : end;
+  }
+  *this = p;
+  return true;
+}
+
+std::string EnergyModel::Profile::format() const {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "sleep=%g", sleepMa);
+  std::string out = buf;
+  for (int s = 0; s < kSubsystemCount; ++s) {
+    snprintf(buf, sizeof(buf), ",%s=%g", kName[s], ma[s]);
+    out += buf;
+  }
+  return out;
+}
+
+double EnergyModel::Totals::mAh(const Profile &p) const {
+  const uint64_t awake = activeUs[kCpu] < elapsedUs ? activeUs[kCpu] : elapsedUs;
+  double maUs = p.sleepMa * static_cast<double>(elapsedUs - awake);
+  for (int s = 0; s < kSubsystemCount; ++s) maUs += p.ma[s] * static_cast<double>(activeUs[s]);
+  return maUs / kUsPerHour;
+}
+
+double EnergyModel::Totals::mAhPerDay(const Profile &p) const {
+  return elapsedUs ? mAh(p) * static_cast<double>(kDayUs) / static_cast<double>(elapsedUs) : 0.0;
+}
+
+EnergyModel::EnergyModel(uint64_t nowUs) : bootUs_(nowUs), dayStartUs_(nowUs), cycleStartUs_(nowUs) {}
+
+void EnergyModel::settle(uint64_t nowUs) {
+  for (int s = 0; s < kSubsystemCount; ++s) {
+    if (depth_[s] == 0 || nowUs <= since_[s]) continue;
+    const uint64_t d = nowUs - since_[s];
+    boot_.activeUs[s] += d;
+    day_.activeUs[s] += d;
+    cycle_.activeUs[s] += d;
+    since_[s] = nowUs;
+  }
+}
+
+void EnergyModel::set(Subsystem s, bool on, uint64_t nowUs) {
+  if (on) {
+    if (depth_[s]++ == 0) since_[s] = nowUs;
+  } else if (depth_[s] > 0) {
+    settle(nowUs);
+    --depth_[s];
+  }
+}
+
+void EnergyModel::endCycle(uint64_t nowUs) {
+  settle(nowUs);
+  cycle_.elapsedUs = nowUs - cycleStartUs_;
+  cycle_.cycles = 1;
+  lastCycle_ = cycle_;
+  cycle_ = Totals();
+  cycleStartUs_ = nowUs;
+  ++boot_.cycles;
+  ++day_.cycles;
+}
+
+bool EnergyModel::rollDay(uint64_t nowUs, Totals &day) {
+  if (nowUs - dayStartUs_ < kDayUs) return false;
+  settle(nowUs);
+  day = day_;
+  day.elapsedUs = nowUs - dayStartUs_;
+  day_ = Totals();
+  dayStartUs_ = nowUs;
+  return true;
+}
+
+EnergyModel::Totals EnergyModel::snapshot(const Totals &t, uint64_t startUs, uint64_t nowUs) const {
+  Totals out = t;
+  out.elapsedUs = nowUs - startUs;
+  for (int s = 0; s < kSubsystemCount; ++s) {
+    if (depth_[s] > 0 && nowUs > since_[s]) out.activeUs[s] += nowUs - since_[s];
+  }
+  return out;
+}
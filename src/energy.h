@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Duty-cycle accounting for battery sizing. The firmware marks when each
+// subsystem is switched on and off; the model keeps per-subsystem active
+// time for the last capture cycle, the current uptime day and since boot,
+// and turns it into charge with a current profile:
+//
+//   mAh = (sleepMa * (elapsed - cpu active) + sum(ma[s] * active[s])) / 3.6e9 us
+//
+// The CPU line replaces the sleep floor while the chip is awake; the other
+// subsystems draw on top of it. Times are passed in, so the model runs the
+// same on the host (tools/energy_model.cpp) as on the board.
+class EnergyModel {
+ public:
+  enum Subsystem { kCpu, kCamera, kSd, kDht, kWifiSta, kWifiAp, kRadio, kSubsystemCount };
+  static const char *const kName[kSubsystemCount];
+
+  // Currents in mA at the battery. Defaults are datasheet-level guesses for
+  // an ESP32-S3 + OV5640 board; measure yours and set them on /config.
+  struct Profile {
+    float sleepMa = 1.5f;  // light sleep floor, radio in modem sleep between beacons
+    float ma[kSubsystemCount] = {
+        40.0f,   // cpu: awake at 80-240MHz
+        110.0f,  // camera: sensor powered, XCLK running
+        45.0f,   // sd: card powered up for reads/writes
+        1.5f,    // dht: one read
+        3.0f,    // wifi_sta: associated, modem-sleep average over beacons
+        95.0f,   // wifi_ap: soft AP, receiver always on
+        120.0f,  // radio: transmitting or receiving HTTP traffic
+    };
+
+    // "sleep=1.5,cpu=40,camera=110,..." ; unknown or missing names keep
+    // their value. Returns false on a malformed entry.
+    bool parse(const char *spec);
+    std::string format() const;
+  };
+
+  struct Totals {
+    uint64_t elapsedUs = 0;
+    uint64_t activeUs[kSubsystemCount] = {};
+    uint32_t cycles = 0;
+
+    double mAh(const Profile &p) const;
+    // mAh scaled to 24h; 0 when nothing elapsed.
+    double mAhPerDay(const Profile &p) const;
+  };
+
+  static constexpr uint64_t kDayUs = 24ULL * 3600ULL * 1000000ULL;
+
+  explicit EnergyModel(uint64_t nowUs = 0);
+
+  // Switches a subsystem on or off. Calls nest: it stays active until every
+  // on has been matched by an off.
+  void set(Subsystem s, bool on, uint64_t nowUs);
+  bool active(Subsystem s) const { return depth_[s] > 0; }
+
+  // Closes the current capture cycle.
+  void endCycle(uint64_t nowUs);
+  // True once every kDayUs of uptime, with the finished day in day.
+  bool rollDay(uint64_t nowUs, Totals &day);
+
+  // Snapshots including subsystems still on at nowUs.
+  const Totals &lastCycle() const { return lastCycle_; }
+  Totals today(uint64_t nowUs) const { return snapshot(day_, dayStartUs_, nowUs); }
+  Totals sinceBoot(uint64_t nowUs) const { return snapshot(boot_, bootUs_, nowUs); }
+
+ private:
+  Totals snapshot(const Totals &t, uint64_t startUs, uint64_t nowUs) const;
+  // Books the open intervals up to nowUs into all accumulators.
+  void settle(uint64_t nowUs);
+
+  uint32_t depth_[kSubsystemCount] = {};
+  uint64_t since_[kSubsystemCount] = {};
+  uint64_t bootUs_;
+  uint64_t dayStartUs_;
+  uint64_t cycleStartUs_;
+  Totals boot_;
+  Totals day_;
+  Totals cycle_;
+  Totals lastCycle_;
+};
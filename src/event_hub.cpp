@@ -0,0 +1,105 @@
+#include "event_hub.h"
+
+#include <cstdio>
+
+#include "hal/logger.h"
+
+size_t EventHub::clientCount() const {
+  size_t n = 0;
+  for (const Client &c : clients_) {
+    if (c.channel) ++n;
+  }
+  return n;
+}
+
+bool EventHub::subscribe(std::unique_ptr<hal::EventChannel> channel, uint64_t nowMs) {
+  for (Client &c : clients_) {
+    if (c.channel) continue;
+    c.channel = std::move(channel);
+    c.queue.clear();
+    c.queuedBytes = 0;
+    c.frontSent = 0;
+    c.lastProgressMs = nowMs;
+    char hello[32];
+    snprintf(hello, sizeof(hello), "retry: %lu\n\n", static_cast<unsigned long>(kRetryMs));
+    enqueue(c, hello, nowMs);
+    pump(nowMs);
+    LOG_INFO("SSE client subscribed (%u active)", static_cast<unsigned>(clientCount()));
+    return true;
+  }
+  return false;
+}
+
+void EventHub::publish(const char *event, const char *json, uint64_t nowMs) {
+  char head[64];
+  snprintf(head, sizeof(head), "id: %lu\nevent: %s\ndata: ", static_cast<unsigned long>(nextId_++), event);
+  std::string msg = head;
+  msg += json;
+  msg += "\n\n";
+  ++stats_.published;
+  for (Client &c : clients_) {
+    if (c.channel) enqueue(c, msg, nowMs);
+  }
+  pump(nowMs);
+}
+
+void EventHub::keepAlive(uint64_t nowMs) {
+  for (Client &c : clients_) {
+    if (c.channel && c.queue.empty()) enqueue(c, ": ping\n\n", nowMs);
+  }
+  pump(nowMs);
+}
+
+void EventHub::pump(uint64_t nowMs) {
+  for (Client &c : clients_) {
+    if (!c.channel) continue;
+    while (!c.queue.empty()) {
+      const std::string &front = c.queue.front();
+      const int n = c.channel->write(reinterpret_cast<const uint8_t *>(front.data()) + c.frontSent,
+                                     front.size() - c.frontSent);
+      if (n < 0) {
+        drop(c, "closed");
+        break;
+      }
+      if (n == 0) break;  // socket buffer full; retry on the next pump
+      c.lastProgressMs = nowMs;
+      c.frontSent += static_cast<size_t>(n);
+      if (c.frontSent == front.size()) {
+        c.queuedBytes -= front.size();
+        c.queue.pop_front();
+        c.frontSent = 0;
+      }
+    }
+    // A peer that vanished without a FIN never errors, it just stops
+    // draining; the keep-alive pings make sure that shows up here.
+    if (c.channel && !c.queue.empty() && nowMs - c.lastProgressMs > kStallMs) drop(c, "stalled");
+  }
+}
+
+void EventHub::enqueue(Client &c, const std::string &msg, uint64_t nowMs) {
+  if (c.queuedBytes + msg.size() > kQueueBytes) {
+    // Keep a partly written event so the stream stays well-formed, then tell
+    // the client it missed some.
+    ++stats_.overflows;
+    while (c.queue.size() > (c.frontSent > 0 ? 1u : 0u)) {
+      c.queuedBytes -= c.queue.back().size();
+      c.queue.pop_back();
+    }
+    static const std::string kOverflow = "event: overflow\ndata: {}\n\n";
+    c.queue.push_back(kOverflow);
+    c.queuedBytes += kOverflow.size();
+    if (msg.size() + c.queuedBytes > kQueueBytes) return;
+  }
+  if (c.queue.empty()) c.lastProgressMs = nowMs;
+  c.queue.push_back(msg);
+  c.queuedBytes += msg.size();
+}
+
+void EventHub::drop(Client &c, const char *why) {
+  c.channel.reset();
+  c.queue.clear();
+  c.queuedBytes = 0;
+  c.frontSent = 0;
+  ++stats_.dropped;
+  LOG_INFO("SSE client dropped (%s, %u active)", why, static_cast<unsigned>(clientCount()));
+}
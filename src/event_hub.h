@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+
+#include "hal/hal.h"
+
+// Fan-out of Server-Sent Events to a few subscribers of GET /events.
+//
+// publish() only appends to per-client queues and tries a non-blocking write,
+// so a slow or stalled client can never hold up capture. Each queue is capped
+// at kQueueBytes; on overflow the client's backlog is discarded and replaced
+// by a single "overflow" event, after which it should re-list /frames.
+// Clients that accept nothing for kStallMs, or whose socket errors, are
+// dropped.
+class EventHub {
+ public:
+  static constexpr size_t kMaxClients = 4;
+  static constexpr size_t kQueueBytes = 2048;
+  static constexpr uint32_t kStallMs = 60000;
+  static constexpr uint32_t kRetryMs = 5000;   // reconnect delay for EventSource
+
+  struct Stats {
+    uint32_t published = 0;
+    uint32_t overflows = 0;   // backlogs discarded because a queue was full
+    uint32_t dropped = 0;     // clients disconnected or stalled
+  };
+
+  bool full() const { return clientCount() >= kMaxClients; }
+  size_t clientCount() const;
+
+  // Takes over an open event stream. Returns false when all slots are used.
+  bool subscribe(std::unique_ptr<hal::EventChannel> channel, uint64_t nowMs);
+
+  // Queues "event: <event>" with a JSON data line for every client.
+  void publish(const char *event, const char *json, uint64_t nowMs);
+
+  // Queues a comment line so proxies keep the connection and dead peers
+  // surface as write errors.
+  void keepAlive(uint64_t nowMs);
+
+  // Writes as much queued data as the sockets accept without blocking.
+  void pump(uint64_t nowMs);
+
+  const Stats &stats() const { return stats_; }
+
+ private:
+  struct Client {
+    std::unique_ptr<hal::EventChannel> channel;
+    std::deque<std::string> queue;
+    size_t queuedBytes = 0;
+    size_t frontSent = 0;        // bytes of queue.front() already written
+    uint64_t lastProgressMs = 0;  // last write, or when the queue filled up
+  };
+
+  void enqueue(Client &c, const std::string &msg, uint64_t nowMs);
+  void drop(Client &c, const char *why);
+
+  Client clients_[kMaxClients];
+  uint32_t nextId_ = 1;
+  Stats stats_;
+};
@@ -0,0 +1,370 @@
+#include "frame_store.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "crc32.h"
+#include "hal/logger.h"
+
+namespace {
+
+constexpr uint32_t kSegmentMagic = 0x31474553;  // "SEG1"
+constexpr uint32_t kRecordMagic = 0x314D5246;   // "FRM1"
+constexpr uint32_t kFooterMagic = 0x58444953;   // "SIDX"
+constexpr size_t kSegmentHeaderBytes = 16;      // magic, salt, first frame, segment bytes
+constexpr size_t kRecordHeaderBytes = 20;       // magic, salt, frame, length, crc
+constexpr size_t kEntryBytes = 12;              // frame, offset, length
+constexpr size_t kFooterBytes = 20;             // magic, salt, count, index offset, index crc
+
+void put32(uint8_t *p, uint32_t v) {
+  p[0] = static_cast<uint8_t>(v);
+  p[1] = static_cast<uint8_t>(v >> 8);
+  p[2] = static_cast<uint8_t>(v >> 16);
+  p[3] = static_cast<uint8_t>(v >> 24);
+}
+
+uint32_t get32(const uint8_t *p) {
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) |
+         (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint32_t alignUp(uint32_t v) { return (v + FrameStore::kAlign - 1) & ~(FrameStore::kAlign - 1); }
+
+bool readAt(hal::File &f, uint64_t pos, uint8_t *buf, size_t len) {
+  return f.seek(pos) && f.read(buf, len) == len;
+}
+
+// Read-only view of [offset, offset + length) of another file.
+class SliceFile : public hal::File {
+ public:
+  SliceFile(std::unique_ptr<hal::File> base, uint64_t offset, uint64_t length)
+      : base_(std::move(base)), offset_(offset), length_(length) {
+    base_->seek(offset_);
+  }
+
+  size_t read(uint8_t *buf, size_t len) override {
+    if (pos_ >= length_) return 0;
+    if (len > length_ - pos_) len = static_cast<size_t>(length_ - pos_);
+    const size_t n = base_->read(buf, len);
+    pos_ += n;
+    return n;
+  }
+  size_t write(const uint8_t *, size_t) override { return 0; }
+  bool seek(uint64_t pos) override {
+    if (pos > length_ || !base_->seek(offset_ + pos)) return false;
+    pos_ = pos;
+    return true;
+  }
+  uint64_t position() override { return pos_; }
+  uint64_t size() override { return length_; }
+  void close() override { base_->close(); }
+
+ private:
+  std::unique_ptr<hal::File> base_;
+  uint64_t offset_;
+  uint64_t length_;
+  uint64_t pos_ = 0;
+};
+
+}  // namespace
+
+void FrameStore::begin(const std::string &runDir) {
+  runDir_ = runDir;
+  segPath_.clear();
+  entries_.clear();
+}
+
+bool FrameStore::parseFrameName(const char *name, uint32_t &frameIndex) {
+  const size_t len = strlen(name);
+  if (len < 11 || strncmp(name, "frame_", 6) != 0 || strcmp(name + len - 4, ".jpg") != 0) return false;
+  char *end = nullptr;
+  frameIndex = static_cast<uint32_t>(strtoul(name + 6, &end, 10));
+  return end == name + len - 4;
+}
+
+bool FrameStore::parseSegmentName(const std::string &name, uint32_t &firstIndex) {
+  if (name.size() < 9 || name.compare(0, 4, "seg_") != 0 || name.compare(name.size() - 4, 4, ".bin") != 0) {
+    return false;
+  }
+  char *end = nullptr;
+  firstIndex = static_cast<uint32_t>(strtoul(name.c_str() + 4, &end, 10));
+  return end == name.c_str() + name.size() - 4;
+}
+
+std::string FrameStore::segmentPath(const std::string &runDir, uint32_t firstIndex) {
+  char name[24];
+  snprintf(name, sizeof(name), "/seg_%06lu.bin", static_cast<unsigned long>(firstIndex));
+  return runDir + name;
+}
+
+const std::vector<FrameStore::Entry> *FrameStore::liveIndex(const std::string &segPath) const {
+  return (!segPath_.empty() && segPath == segPath_) ? &entries_ : nullptr;
+}
+
+bool FrameStore::startSegment(uint32_t firstIndex, uint64_t spaceBudget, size_t firstLen) {
+  uint64_t bytes = spaceBudget < kSegmentBytes ? spaceBudget : kSegmentBytes;
+  bytes &= ~static_cast<uint64_t>(kAlign - 1);
+  if (bytes < kAlign + alignUp(kRecordHeaderBytes + firstLen) + kEntryBytes + kFooterBytes) {
+    LOG_WARN("No room for a new segment");
+    return false;
+  }
+  const std::string path = segmentPath(runDir_, firstIndex);
+  std::unique_ptr<hal::File> f = hal::storage().openFor(path.c_str(), hal::OpenMode::kWrite, hal::IoClass::kCapture);
+  if (!f) {
+    LOG_ERROR("Failed to create %s", path.c_str());
+    return false;
+  }
+  const uint64_t now = hal::clock().nowUs();
+  salt_ = crc32Update(crc32Update(0, reinterpret_cast<const uint8_t *>(&now), sizeof(now)),
+                      reinterpret_cast<const uint8_t *>(path.data()), path.size());
+  uint8_t header[kSegmentHeaderBytes];
+  put32(header, kSegmentMagic);
+  put32(header + 4, salt_);
+  put32(header + 8, firstIndex);
+  put32(header + 12, static_cast<uint32_t>(bytes));
+  // Writing the last byte makes FAT allocate the whole cluster chain now,
+  // so appends never touch the FAT or the directory entry.
+  const uint8_t zero = 0;
+  const bool ok = f->write(header, sizeof(header)) == sizeof(header) && f->seek(bytes - 1) && f->write(&zero, 1) == 1;
+  f->close();
+  if (!ok) {
+    hal::storage().remove(path.c_str());
+    LOG_ERROR("Failed to preallocate %s", path.c_str());
+    return false;
+  }
+  segPath_ = path;
+  segBytes_ = static_cast<uint32_t>(bytes);
+  writeOffset_ = kAlign;
+  entries_.clear();
+  LOG_INFO("New segment %s (%lu KB)", path.c_str(), static_cast<unsigned long>(bytes / 1024));
+  return true;
+}
+
+bool FrameStore::append(uint32_t frameIndex, const uint8_t *data, size_t len, uint64_t spaceBudget,
+                        std::string &savedPath) {
+  const uint32_t recordEnd = alignUp(writeOffset_ + kRecordHeaderBytes + static_cast<uint32_t>(len));
+  const bool fits = !segPath_.empty() && entries_.size() < kMaxRecords &&
+                    static_cast<uint64_t>(recordEnd) + (entries_.size() + 1) * kEntryBytes + kFooterBytes <= segBytes_;
+  if (!fits) {
+    if (!segPath_.empty()) seal();
+    if (!startSegment(frameIndex, spaceBudget, len)) return false;
+  }
+
+  std::unique_ptr<hal::File> f = hal::storage().openFor(segPath_.c_str(), hal::OpenMode::kUpdate, hal::IoClass::kCapture);
+  if (!f) {
+    LOG_ERROR("Failed to open %s", segPath_.c_str());
+    return false;
+  }
+  uint8_t header[kRecordHeaderBytes];
+  put32(header, kRecordMagic);
+  put32(header + 4, salt_);
+  put32(header + 8, frameIndex);
+  put32(header + 12, static_cast<uint32_t>(len));
+  put32(header + 16, crc32Update(0, data, len));
+  const bool ok = f->seek(writeOffset_) && f->write(header, sizeof(header)) == sizeof(header) &&
+                  f->write(data, len) == len;
+  f->close();
+  if (!ok) {
+    LOG_ERROR("Segment write failed at %lu", static_cast<unsigned long>(writeOffset_));
+    return false;
+  }
+  entries_.push_back(Entry{frameIndex, writeOffset_, static_cast<uint32_t>(len)});
+  writeOffset_ = alignUp(writeOffset_ + kRecordHeaderBytes + static_cast<uint32_t>(len));
+
+  char name[32];
+  snprintf(name, sizeof(name), "/frame_%06lu.jpg", static_cast<unsigned long>(frameIndex));
+  savedPath = runDir_ + name;
+  return true;
+}
+
+bool FrameStore::writeFooter(hal::File &f, uint32_t segmentBytes, uint32_t indexOffset,
+                             const std::vector<Entry> &entries) {
+  uint8_t segHeader[kSegmentHeaderBytes];
+  if (!readAt(f, 0, segHeader, sizeof(segHeader))) return false;
+  std::vector<uint8_t> index(entries.size() * kEntryBytes);
+  for (size_t i = 0; i < entries.size(); ++i) {
+    put32(&index[i * kEntryBytes], entries[i].frameIndex);
+    put32(&index[i * kEntryBytes + 4], entries[i].offset);
+    put32(&index[i * kEntryBytes + 8], entries[i].length);
+  }
+  uint8_t footer[kFooterBytes];
+  put32(footer, kFooterMagic);
+  put32(footer + 4, get32(segHeader + 4));
+  put32(footer + 8, static_cast<uint32_t>(entries.size()));
+  put32(footer + 12, indexOffset);
+  put32(footer + 16, crc32Update(0, index.data(), index.size()));
+  return f.seek(indexOffset) && f.write(index.data(), index.size()) == index.size() &&
+         f.seek(segmentBytes - kFooterBytes) && f.write(footer, sizeof(footer)) == sizeof(footer);
+}
+
+bool FrameStore::seal() {
+  if (segPath_.empty()) return true;
+  std::unique_ptr<hal::File> f = hal::storage().openFor(segPath_.c_str(), hal::OpenMode::kUpdate, hal::IoClass::kCapture);
+  const bool ok = f && writeFooter(*f, segBytes_, writeOffset_, entries_);
+  if (f) f->close();
+  if (!ok) LOG_ERROR("Failed to seal %s", segPath_.c_str());
+  segPath_.clear();
+  entries_.clear();
+  return ok;
+}
+
+bool FrameStore::loadIndex(hal::File &f, std::vector<Entry> &entries, bool &sealed) {
+  entries.clear();
+  sealed = false;
+  uint8_t head[kSegmentHeaderBytes];
+  if (!readAt(f, 0, head, sizeof(head)) || get32(head) != kSegmentMagic) return false;
+  const uint32_t salt = get32(head + 4);
+  const uint64_t size = f.size();
+  if (size < kAlign + kFooterBytes) return false;
+
+  uint8_t footer[kFooterBytes];
+  if (readAt(f, size - kFooterBytes, footer, sizeof(footer)) && get32(footer) == kFooterMagic &&
+      get32(footer + 4) == salt) {
+    const uint32_t count = get32(footer + 8);
+    std::vector<uint8_t> index(static_cast<size_t>(count) * kEntryBytes);
+    if (count <= kMaxRecords && readAt(f, get32(footer + 12), index.data(), index.size()) &&
+        crc32Update(0, index.data(), index.size()) == get32(footer + 16)) {
+      for (uint32_t i = 0; i < count; ++i) {
+        const uint8_t *e = &index[i * kEntryBytes];
+        entries.push_back(Entry{get32(e), get32(e + 4), get32(e + 8)});
+      }
+      sealed = true;
+      return true;
+    }
+  }
+
+  // No valid footer: walk the record headers.
+  uint64_t off = kAlign;
+  uint8_t rec[kRecordHeaderBytes];
+  while (off + kRecordHeaderBytes + kFooterBytes <= size && entries.size() < kMaxRecords) {
+    if (!readAt(f, off, rec, sizeof(rec)) || get32(rec) != kRecordMagic || get32(rec + 4) != salt) break;
+    const uint32_t len = get32(rec + 12);
+    if (len == 0 || off + kRecordHeaderBytes + len + kFooterBytes > size) break;
+    if (!entries.empty() && get32(rec + 8) <= entries.back().frameIndex) break;
+    entries.push_back(Entry{get32(rec + 8), static_cast<uint32_t>(off), len});
+    off = alignUp(static_cast<uint32_t>(off + kRecordHeaderBytes + len));
+  }
+  // Only the last record can be torn; check its payload.
+  if (!entries.empty()) {
+    const Entry &last = entries.back();
+    if (!readAt(f, last.offset, rec, sizeof(rec))) return false;
+    uint32_t crc = 0;
+    uint8_t buf[1024];
+    uint32_t left = last.length;
+    while (left > 0) {
+      const size_t n = f.read(buf, left < sizeof(buf) ? left : sizeof(buf));
+      if (n == 0) break;
+      crc = crc32Update(crc, buf, n);
+      left -= static_cast<uint32_t>(n);
+    }
+    if (left != 0 || crc != get32(rec + 16)) entries.pop_back();
+  }
+  return true;
+}
+
+std::unique_ptr<hal::File> FrameStore::openFrame(const std::string &runDir, uint32_t frameIndex) {
+  // The segment is the one with the largest first index <= frameIndex.
+  bool found = false;
+  uint32_t best = 0;
+  hal::storage().listDir(runDir.c_str(), [&](const hal::DirEntry &d) {
+    uint32_t first = 0;
+    if (!d.isDir && parseSegmentName(d.name, first) && first <= frameIndex && (!found || first > best)) {
+      best = first;
+      found = true;
+    }
+    return true;
+  });
+  if (!found) return nullptr;
+
+  const std::string path = segmentPath(runDir, best);
+  std::unique_ptr<hal::File> f = hal::storage().open(path.c_str(), hal::OpenMode::kRead);
+  if (!f) return nullptr;
+  std::vector<Entry> loaded;
+  const std::vector<Entry> *entries = liveIndex(path);
+  if (!entries) {
+    bool sealed = false;
+    if (!loadIndex(*f, loaded, sealed)) return nullptr;
+    if (!sealed) {
+      // Left open by a reset in an older run: index it once, now.
+      f->close();
+      sealWalked(path, loaded);
+      f = hal::storage().open(path.c_str(), hal::OpenMode::kRead);
+      if (!f) return nullptr;
+    }
+    entries = &loaded;
+  }
+  // Entries are in frame order.
+  size_t lo = 0;
+  size_t hi = entries->size();
+  while (lo < hi) {
+    const size_t mid = (lo + hi) / 2;
+    if ((*entries)[mid].frameIndex < frameIndex) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo == entries->size() || (*entries)[lo].frameIndex != frameIndex) return nullptr;
+  const Entry &e = (*entries)[lo];
+  return std::unique_ptr<hal::File>(new SliceFile(std::move(f), e.offset + kRecordHeaderBytes, e.length));
+}
+
+bool FrameStore::listFrames(const std::string &runDir, const std::function<bool(const hal::DirEntry &)> &fn) {
+  return hal::storage().listDir(runDir.c_str(), [&](const hal::DirEntry &d) {
+    uint32_t first = 0;
+    if (d.isDir || !parseSegmentName(d.name, first)) return fn(d);
+    const std::string path = runDir + "/" + d.name;
+    std::vector<Entry> loaded;
+    const std::vector<Entry> *entries = liveIndex(path);
+    if (!entries) {
+      std::unique_ptr<hal::File> f = hal::storage().open(path.c_str(), hal::OpenMode::kRead);
+      bool sealed = false;
+      if (!f || !loadIndex(*f, loaded, sealed)) return true;
+      f->close();
+      if (!sealed) sealWalked(path, loaded);  // so the next listing reads the footer
+      entries = &loaded;
+    }
+    hal::DirEntry frame;
+    char name[24];
+    for (const Entry &e : *entries) {
+      snprintf(name, sizeof(name), "frame_%06lu.jpg", static_cast<unsigned long>(e.frameIndex));
+      frame.name = name;
+      frame.size = e.length;
+      if (!fn(frame)) return false;
+    }
+    return true;
+  });
+}
+
+bool FrameStore::sealWalked(const std::string &path, const std::vector<Entry> &entries) {
+  std::unique_ptr<hal::File> f = hal::storage().open(path.c_str(), hal::OpenMode::kUpdate);
+  if (!f) return false;
+  const uint32_t indexOffset =
+      entries.empty() ? kAlign : alignUp(entries.back().offset + kRecordHeaderBytes + entries.back().length);
+  const bool ok = writeFooter(*f, static_cast<uint32_t>(f->size()), indexOffset, entries);
+  f->close();
+  if (ok) LOG_INFO("Recovered %s: %u frames", path.c_str(), static_cast<unsigned>(entries.size()));
+  return ok;
+}
+
+int FrameStore::recover(const std::string &runDir) {
+  std::vector<std::string> segments;
+  hal::storage().listDir(runDir.c_str(), [&](const hal::DirEntry &d) {
+    uint32_t first = 0;
+    if (!d.isDir && parseSegmentName(d.name, first)) segments.push_back(runDir + "/" + d.name);
+    return true;
+  });
+  int sealedCount = 0;
+  for (const std::string &path : segments) {
+    if (liveIndex(path)) continue;
+    std::vector<Entry> entries;
+    bool sealed = false;
+    {
+      std::unique_ptr<hal::File> f = hal::storage().open(path.c_str(), hal::OpenMode::kRead);
+      if (!f || !loadIndex(*f, entries, sealed) || sealed) continue;
+    }
+    if (sealWalked(path, entries)) ++sealedCount;
+  }
+  return sealedCount;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "hal/hal.h"
+
+// Optional frame storage that appends JPEGs to large preallocated segment
+// files (<run>/seg_NNNNNN.bin, named after their first frame index) instead
+// of creating one FAT directory entry per frame. FAT directories are
+// unsorted lists that are scanned linearly on every open and create, so a
+// run with tens of thousands of frame files gets slower with each frame; a
+// run in segments has a handful of entries.
+//
+// Segment layout (little endian, kAlign-aligned records):
+//   [segment header][record header + JPEG]...[index entries]...[footer]
+// The segment header carries a random salt repeated in every record header,
+// so stale data in the preallocated clusters is never mistaken for a frame.
+// When a segment fills up, the index of (frame, offset, length) entries is
+// written after the last record and the footer at the very end. A segment
+// left unsealed by a power cut is rebuilt by walking the record headers;
+// the last record's CRC decides whether it survived. The rebuilt index is
+// written back right away: for the previous run at boot (recover()), for
+// older runs the first time a listing or read walks the segment.
+//
+// Frames keep their frame_NNNNNN.jpg names: listFrames() and openFrame()
+// present segments as if they were plain files.
+class FrameStore {
+ public:
+  static constexpr uint32_t kSegmentBytes = 64UL * 1024UL * 1024UL;
+  static constexpr size_t kMaxRecords = 1024;  // per segment; bounds the RAM index
+  static constexpr uint32_t kAlign = 512;      // one SD sector
+
+  struct Entry {
+    uint32_t frameIndex;
+    uint32_t offset;  // of the record header
+    uint32_t length;  // JPEG bytes
+  };
+
+  // Starts writing into runDir (the active run). Nothing is created until
+  // the first append().
+  void begin(const std::string &runDir);
+
+  // Appends one frame, creating a new segment when the current one is full.
+  // A new segment is at most spaceBudget bytes. Fills savedPath with the
+  // frame's virtual path (<run>/frame_NNNNNN.jpg).
+  bool append(uint32_t frameIndex, const uint8_t *data, size_t len, uint64_t spaceBudget, std::string &savedPath);
+
+  // Writes the index and footer of the open segment.
+  bool seal();
+
+  // Opens frame frameIndex of runDir as a read-only file covering exactly the
+  // JPEG bytes. Returns nullptr when no segment holds it.
+  std::unique_ptr<hal::File> openFrame(const std::string &runDir, uint32_t frameIndex);
+
+  // Lists runDir like Storage::listDir, each segment expanded into
+  // frame_NNNNNN.jpg entries.
+  bool listFrames(const std::string &runDir, const std::function<bool(const hal::DirEntry &)> &fn);
+
+  // Seals segments of runDir left open by a reset. Returns how many.
+  int recover(const std::string &runDir);
+
+  // "frame_000123.jpg" -> 123.
+  static bool parseFrameName(const char *name, uint32_t &frameIndex);
+
+ private:
+  static bool parseSegmentName(const std::string &name, uint32_t &firstIndex);
+  static std::string segmentPath(const std::string &runDir, uint32_t firstIndex);
+  // Reads a segment's index from its footer, or by walking record headers
+  // when it has none (sealed is false then).
+  static bool loadIndex(hal::File &f, std::vector<Entry> &entries, bool &sealed);
+  static bool writeFooter(hal::File &f, uint32_t segmentBytes, uint32_t indexOffset, const std::vector<Entry> &entries);
+  // Writes the index and footer of an unsealed segment whose entries were
+  // rebuilt by loadIndex(). The caller's handles on it must be closed.
+  static bool sealWalked(const std::string &path, const std::vector<Entry> &entries);
+  bool startSegment(uint32_t firstIndex, uint64_t spaceBudget, size_t firstLen);
+  // Index of the open segment when segPath is the one being written.
+  const std::vector<Entry> *liveIndex(const std::string &segPath) const;
+
+  std::string runDir_;
+  std::string segPath_;  // empty until the first append
+  uint32_t segBytes_ = 0;
+  uint32_t salt_ = 0;
+  uint32_t writeOffset_ = 0;
+  std::vector<Entry> entries_;
+};
@@ -0,0 +1,458 @@
+#include "gzip_stream.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "crc32.h"
+
+namespace {
+
+const uint16_t kLenBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27,
+                               31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const uint8_t kLenExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2,
+                               2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const uint16_t kDistBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+                                193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+                                6145, 8193, 12289, 16385, 24577};
+const uint8_t kDistExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+                                6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+const uint8_t kClOrder[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+const int kChainForLevel[10] = {0, 4, 8, 16, 32, 64, 128, 256, 1024, 4096};
+
+// 286 literal/length codes are usable, but the fixed code is defined over 288
+// and its canonical codes depend on the two unused ones.
+constexpr size_t kLitSyms = 288;
+constexpr size_t kDistSyms = 30;
+constexpr size_t kClSyms = 19;
+
+// Lookup tables built on first use: match length -> length code index,
+// distance -> distance code index (direct for <= 256, by 128s above).
+uint8_t gLenCode[256];
+uint8_t gDistCodeLow[256];
+uint8_t gDistCodeHigh[256];
+bool gTablesReady = false;
+
+void initTables() {
+  if (gTablesReady) return;
+  for (int code = 0; code < 29; ++code) {
+    const int span = 1 << kLenExtra[code];
+    for (int i = 0; i < span && kLenBase[code] + i <= 258; ++i) gLenCode[kLenBase[code] + i - 3] = static_cast<uint8_t>(code);
+  }
+  gLenCode[255] = 28;  // length 258 has its own code
+  for (int code = 0; code < 30; ++code) {
+    const int span = 1 << kDistExtra[code];
+    for (int i = 0; i < span; ++i) {
+      const int d = kDistBase[code] + i;
+      if (d <= 256) gDistCodeLow[d - 1] = static_cast<uint8_t>(code);
+      if (d > 256) gDistCodeHigh[(d - 1) >> 7] = static_cast<uint8_t>(code);
+    }
+  }
+  gTablesReady = true;
+}
+
+// buildLengths() working set.
+struct HuffScratch {
+  uint32_t freq[kLitSyms];
+  uint16_t leaves[kLitSyms];
+  uint32_t nodeFreq[2 * kLitSyms];
+  int16_t parent[2 * kLitSyms];
+  uint8_t depth[2 * kLitSyms];
+};
+
+inline int distCode(uint32_t dist) { return dist <= 256 ? gDistCodeLow[dist - 1] : gDistCodeHigh[(dist - 1) >> 7]; }
+
+// Huffman code lengths limited to maxBits. When the optimal tree is too deep
+// the frequencies are halved and the tree rebuilt, which converges quickly
+// and costs a fraction of a percent of ratio.
+void buildLengths(const uint32_t *freqIn, size_t n, int maxBits, uint8_t *lens, HuffScratch &h) {
+  uint32_t *freq = h.freq;
+  uint16_t *leaves = h.leaves;
+  uint32_t *nodeFreq = h.nodeFreq;
+  int16_t *parent = h.parent;
+  uint8_t *depth = h.depth;
+  memcpy(freq, freqIn, n * sizeof(uint32_t));
+
+  while (true) {
+    memset(lens, 0, n);
+    size_t m = 0;
+    for (size_t s = 0; s < n; ++s) {
+      if (freq[s]) leaves[m++] = static_cast<uint16_t>(s);
+    }
+    if (m == 0) return;
+    if (m == 1) {
+      lens[leaves[0]] = 1;
+      return;
+    }
+    std::sort(leaves, leaves + m, [freq](uint16_t a, uint16_t b) {
+      return freq[a] != freq[b] ? freq[a] < freq[b] : a < b;
+    });
+    for (size_t i = 0; i < m; ++i) nodeFreq[i] = freq[leaves[i]];
+    // Two-queue construction: leaves are sorted, internal nodes are created
+    // in non-decreasing order, so the two smallest are always at a queue head.
+    size_t leaf = 0;
+    size_t inner = m;
+    for (size_t k = m; k < 2 * m - 1; ++k) {
+      size_t pick[2];
+      for (size_t &p : pick) {
+        if (leaf < m && (inner >= k || nodeFreq[leaf] <= nodeFreq[inner])) {
+          p = leaf++;
+        } else {
+          p = inner++;
+        }
+      }
+      nodeFreq[k] = nodeFreq[pick[0]] + nodeFreq[pick[1]];
+      parent[pick[0]] = parent[pick[1]] = static_cast<int16_t>(k);
+    }
+    const size_t root = 2 * m - 2;
+    depth[root] = 0;
+    int maxDepth = 0;
+    for (size_t k = root; k-- > 0;) {
+      depth[k] = static_cast<uint8_t>(depth[parent[k]] + 1);
+      if (k < m && depth[k] > maxDepth) maxDepth = depth[k];
+    }
+    if (maxDepth <= maxBits) {
+      for (size_t i = 0; i < m; ++i) lens[leaves[i]] = depth[i];
+      return;
+    }
+    for (size_t s = 0; s < n; ++s) {
+      if (freq[s]) freq[s] = (freq[s] >> 1) | 1;
+    }
+  }
+}
+
+// Canonical codes, bit-reversed because deflate emits Huffman codes MSB first
+// into an LSB-first bit stream.
+void buildCodes(const uint8_t *lens, size_t n, uint16_t *codes) {
+  uint16_t count[16] = {0};
+  uint16_t next[16] = {0};
+  for (size_t s = 0; s < n; ++s) ++count[lens[s]];
+  count[0] = 0;
+  uint16_t code = 0;
+  for (int bits = 1; bits < 16; ++bits) {
+    code = static_cast<uint16_t>((code + count[bits - 1]) << 1);
+    next[bits] = code;
+  }
+  for (size_t s = 0; s < n; ++s) {
+    const int len = lens[s];
+    if (len == 0) continue;
+    uint16_t c = next[len]++;
+    uint16_t r = 0;
+    for (int i = 0; i < len; ++i) {
+      r = static_cast<uint16_t>((r << 1) | (c & 1));
+      c >>= 1;
+    }
+    codes[s] = r;
+  }
+}
+
+void fixedLengths(uint8_t *litLens, uint8_t *distLens) {
+  for (size_t s = 0; s < kLitSyms; ++s) litLens[s] = s < 144 ? 8 : s < 256 ? 9 : s < 280 ? 7 : 8;
+  for (size_t s = 0; s < kDistSyms; ++s) distLens[s] = 5;
+}
+
+}  // namespace
+
+// Per-block tables, about 11KB. They live on the heap with the window: the
+// callers run on the loop task, whose 8KB stack cannot hold them.
+struct GzipStream::BlockScratch {
+  HuffScratch huff;
+  uint32_t litFreq[kLitSyms];
+  uint32_t distFreq[kDistSyms];
+  uint32_t buildFreq[kLitSyms];
+  uint8_t litLens[kLitSyms];
+  uint8_t distLens[kDistSyms];
+  uint8_t all[kLitSyms + kDistSyms];
+  uint8_t rleSym[kLitSyms + kDistSyms];
+  uint8_t rleExtra[kLitSyms + kDistSyms];
+  uint8_t fixedLit[kLitSyms];
+  uint8_t fixedDist[kDistSyms];
+  uint16_t litCodes[kLitSyms];
+  uint16_t distCodes[kDistSyms];
+};
+
+GzipStream::GzipStream(const Options &opts, Sink sink) : opts_(opts), sink_(std::move(sink)) {
+  initTables();
+  opts_.windowBits = std::min(15, std::max(9, opts_.windowBits));
+  opts_.level = std::min(9, std::max(1, opts_.level));
+  wsize_ = static_cast<size_t>(1) << opts_.windowBits;
+  maxDist_ = wsize_ - kMinLookahead;
+  maxChain_ = kChainForLevel[opts_.level];
+  window_.reset(new uint8_t[2 * wsize_]);
+  head_.reset(new uint16_t[1 << kHashBits]());
+  prev_.reset(new uint16_t[wsize_]());
+  litLen_.reset(new uint16_t[kMaxTokens]);
+  dist_.reset(new uint16_t[kMaxTokens]);
+  scratch_.reset(new BlockScratch);
+  static const uint8_t kHeader[10] = {0x1F, 0x8B, 8, 0, 0, 0, 0, 0, 0, 0xFF};
+  memcpy(out_, kHeader, sizeof(kHeader));
+  outLen_ = sizeof(kHeader);
+}
+
+GzipStream::~GzipStream() = default;
+
+bool GzipStream::accepts(const char *acceptEncoding) {
+  if (!acceptEncoding) return false;
+  const char *p = strstr(acceptEncoding, "gzip");
+  if (!p) return false;
+  p += 4;
+  while (*p == ' ') ++p;
+  if (*p != ';') return true;
+  const char *q = strstr(p, "q=");
+  return !q || atof(q + 2) > 0.0;
+}
+
+void GzipStream::write(const uint8_t *data, size_t len) {
+  if (finished_) return;
+  bytesIn_ += len;
+  crc_ = crc32Update(crc_, data, len);
+
+  while (len > 0) {
+    if (end_ == 2 * wsize_) slide();
+    const size_t n = std::min(len, 2 * wsize_ - end_);
+    memcpy(window_.get() + end_, data, n);
+    end_ += n;
+    data += n;
+    len -= n;
+    deflate(false);
+  }
+}
+
+void GzipStream::finish() {
+  if (finished_) return;
+  deflate(true);
+  emitBlock(true);
+  flushBits();
+  const uint32_t crc = crc_;
+  const uint32_t isize = static_cast<uint32_t>(bytesIn_);
+  for (int i = 0; i < 4; ++i) putBits((crc >> (8 * i)) & 0xFF, 8);
+  for (int i = 0; i < 4; ++i) putBits((isize >> (8 * i)) & 0xFF, 8);
+  flushOut();
+  finished_ = true;
+}
+
+void GzipStream::slide() {
+  const size_t w = wsize_;
+  memmove(window_.get(), window_.get() + w, w);
+  strStart_ -= w;
+  end_ -= w;
+  for (size_t i = 0; i < (static_cast<size_t>(1) << kHashBits); ++i) head_[i] = head_[i] >= w ? static_cast<uint16_t>(head_[i] - w) : 0;
+  for (size_t i = 0; i < w; ++i) prev_[i] = prev_[i] >= w ? static_cast<uint16_t>(prev_[i] - w) : 0;
+}
+
+void GzipStream::insertHash(size_t pos) {
+  const uint8_t *p = window_.get() + pos;
+  const uint32_t key = (static_cast<uint32_t>(p[0]) << 16) | (static_cast<uint32_t>(p[1]) << 8) | p[2];
+  const uint32_t h = (key * 2654435761u) >> (32 - kHashBits);
+  prev_[pos & (wsize_ - 1)] = head_[h];
+  head_[h] = static_cast<uint16_t>(pos);
+}
+
+size_t GzipStream::longestMatch(size_t pos, size_t &matchPos) const {
+  const uint8_t *win = window_.get();
+  const size_t limit = pos > maxDist_ ? pos - maxDist_ : 0;
+  const size_t maxLen = std::min(kMaxMatch, end_ - pos);
+  size_t cand = prev_[pos & (wsize_ - 1)];  // head before pos was inserted
+  size_t best = 0;
+  int chain = maxChain_;
+  while (cand > limit && chain-- > 0) {
+    if (win[cand + best] == win[pos + best] && win[cand] == win[pos]) {
+      size_t len = 1;
+      while (len < maxLen && win[cand + len] == win[pos + len]) ++len;
+      if (len > best) {
+        best = len;
+        matchPos = cand;
+        if (len >= maxLen) break;
+      }
+    }
+    cand = prev_[cand & (wsize_ - 1)];
+  }
+  return best;
+}
+
+void GzipStream::deflate(bool flush) {
+  while (true) {
+    const size_t lookahead = end_ - strStart_;
+    if (lookahead == 0 || (lookahead < kMinLookahead && !flush)) break;
+    size_t len = 0;
+    size_t matchPos = 0;
+    if (lookahead >= kMinMatch) {
+      insertHash(strStart_);
+      len = longestMatch(strStart_, matchPos);
+    }
+    if (len >= kMinMatch) {
+      litLen_[tokens_] = static_cast<uint16_t>(len);
+      dist_[tokens_] = static_cast<uint16_t>(strStart_ - matchPos);
+      for (size_t p = strStart_ + 1; p < strStart_ + len && p + kMinMatch <= end_; ++p) insertHash(p);
+      strStart_ += len;
+    } else {
+      litLen_[tokens_] = window_[strStart_];
+      dist_[tokens_] = 0;
+      ++strStart_;
+    }
+    if (++tokens_ == kMaxTokens) emitBlock(false);
+  }
+}
+
+void GzipStream::emitBlock(bool last) {
+  BlockScratch &b = *scratch_;
+  uint32_t *litFreq = b.litFreq;
+  uint32_t *distFreq = b.distFreq;
+  memset(litFreq, 0, sizeof(b.litFreq));
+  memset(distFreq, 0, sizeof(b.distFreq));
+  for (size_t i = 0; i < tokens_; ++i) {
+    if (dist_[i] == 0) {
+      ++litFreq[litLen_[i]];
+    } else {
+      ++litFreq[257 + gLenCode[litLen_[i] - 3]];
+      ++distFreq[distCode(dist_[i])];
+    }
+  }
+  litFreq[256] = 1;
+
+  // Dynamic trees. Keep at least two codes in each so zlib-style decoders
+  // never see a degenerate (incomplete) code.
+  uint32_t *buildFreq = b.buildFreq;
+  uint8_t *litLens = b.litLens;
+  uint8_t *distLens = b.distLens;
+  memcpy(buildFreq, litFreq, sizeof(b.litFreq));
+  if (std::count_if(buildFreq, buildFreq + kLitSyms, [](uint32_t f) { return f != 0; }) < 2) buildFreq[0] = 1;
+  buildLengths(buildFreq, kLitSyms, 15, litLens, b.huff);
+  memcpy(buildFreq, distFreq, sizeof(b.distFreq));
+  if (buildFreq[0] == 0) buildFreq[0] = 1;
+  if (std::count_if(buildFreq, buildFreq + kDistSyms, [](uint32_t f) { return f != 0; }) < 2) buildFreq[1] = 1;
+  buildLengths(buildFreq, kDistSyms, 15, distLens, b.huff);
+
+  size_t hlit = kLitSyms;
+  while (hlit > 257 && litLens[hlit - 1] == 0) --hlit;
+  size_t hdist = kDistSyms;
+  while (hdist > 1 && distLens[hdist - 1] == 0) --hdist;
+
+  // Run-length encode the code lengths with symbols 16/17/18.
+  uint8_t *all = b.all;
+  memcpy(all, litLens, hlit);
+  memcpy(all + hlit, distLens, hdist);
+  const size_t total = hlit + hdist;
+  uint8_t *rleSym = b.rleSym;
+  uint8_t *rleExtra = b.rleExtra;
+  size_t rleCount = 0;
+  uint32_t clFreq[kClSyms] = {0};
+  auto rle = [&](uint8_t sym, uint8_t extra) {
+    rleSym[rleCount] = sym;
+    rleExtra[rleCount++] = extra;
+    ++clFreq[sym];
+  };
+  for (size_t i = 0; i < total;) {
+    const uint8_t cur = all[i];
+    size_t run = 1;
+    while (i + run < total && all[i + run] == cur) ++run;
+    i += run;
+    if (cur == 0) {
+      while (run >= 11) {
+        const size_t r = std::min<size_t>(run, 138);
+        rle(18, static_cast<uint8_t>(r - 11));
+        run -= r;
+      }
+      if (run >= 3) {
+        rle(17, static_cast<uint8_t>(run - 3));
+        run = 0;
+      }
+    } else {
+      rle(cur, 0);
+      --run;
+      while (run >= 3) {
+        const size_t r = std::min<size_t>(run, 6);
+        rle(16, static_cast<uint8_t>(r - 3));
+        run -= r;
+      }
+    }
+    while (run-- > 0) rle(cur, 0);
+  }
+  uint8_t clLens[kClSyms];
+  buildLengths(clFreq, kClSyms, 7, clLens, b.huff);
+  size_t hclen = kClSyms;
+  while (hclen > 4 && clLens[kClOrder[hclen - 1]] == 0) --hclen;
+
+  // Pick the cheaper of fixed and dynamic codes for this block. Length and
+  // distance extra bits cost the same in both, so they are left out.
+  uint8_t *fixedLit = b.fixedLit;
+  uint8_t *fixedDist = b.fixedDist;
+  fixedLengths(fixedLit, fixedDist);
+  uint64_t dynBits = 3 + 14 + 3 * hclen;
+  uint64_t fixBits = 3;
+  for (size_t s = 0; s < kLitSyms; ++s) {
+    dynBits += static_cast<uint64_t>(litFreq[s]) * litLens[s];
+    fixBits += static_cast<uint64_t>(litFreq[s]) * fixedLit[s];
+  }
+  for (size_t s = 0; s < kDistSyms; ++s) {
+    dynBits += static_cast<uint64_t>(distFreq[s]) * distLens[s];
+    fixBits += static_cast<uint64_t>(distFreq[s]) * 5;
+  }
+  for (size_t i = 0; i < rleCount; ++i) {
+    dynBits += clLens[rleSym[i]] + (rleSym[i] == 16 ? 2 : rleSym[i] == 17 ? 3 : rleSym[i] == 18 ? 7 : 0);
+  }
+  const bool useDynamic = dynBits < fixBits;
+
+  uint16_t *litCodes = b.litCodes;
+  uint16_t *distCodes = b.distCodes;
+  const uint8_t *lensLit = useDynamic ? litLens : fixedLit;
+  const uint8_t *lensDist = useDynamic ? distLens : fixedDist;
+  buildCodes(lensLit, kLitSyms, litCodes);
+  buildCodes(lensDist, kDistSyms, distCodes);
+
+  putBits((last ? 1u : 0u) | ((useDynamic ? 2u : 1u) << 1), 3);
+  if (useDynamic) {
+    uint16_t clCodes[kClSyms];
+    buildCodes(clLens, kClSyms, clCodes);
+    putBits(static_cast<uint32_t>(hlit - 257), 5);
+    putBits(static_cast<uint32_t>(hdist - 1), 5);
+    putBits(static_cast<uint32_t>(hclen - 4), 4);
+    for (size_t i = 0; i < hclen; ++i) putBits(clLens[kClOrder[i]], 3);
+    for (size_t i = 0; i < rleCount; ++i) {
+      const uint8_t sym = rleSym[i];
+      putBits(clCodes[sym], clLens[sym]);
+      if (sym == 16) putBits(rleExtra[i], 2);
+      if (sym == 17) putBits(rleExtra[i], 3);
+      if (sym == 18) putBits(rleExtra[i], 7);
+    }
+  }
+
+  for (size_t i = 0; i < tokens_; ++i) {
+    if (dist_[i] == 0) {
+      putBits(litCodes[litLen_[i]], lensLit[litLen_[i]]);
+      continue;
+    }
+    const uint32_t len = litLen_[i];
+    const int lc = gLenCode[len - 3];
+    putBits(litCodes[257 + lc], lensLit[257 + lc]);
+    if (kLenExtra[lc]) putBits(len - kLenBase[lc], kLenExtra[lc]);
+    const uint32_t dist = dist_[i];
+    const int dc = distCode(dist);
+    putBits(distCodes[dc], lensDist[dc]);
+    if (kDistExtra[dc]) putBits(dist - kDistBase[dc], kDistExtra[dc]);
+  }
+  putBits(litCodes[256], lensLit[256]);
+  tokens_ = 0;
+}
+
+void GzipStream::putBits(uint32_t value, int bits) {
+  bitBuf_ |= static_cast<uint64_t>(value) << bitCount_;
+  bitCount_ += bits;
+  while (bitCount_ >= 8) {
+    out_[outLen_++] = static_cast<uint8_t>(bitBuf_);
+    bitBuf_ >>= 8;
+    bitCount_ -= 8;
+    if (outLen_ == sizeof(out_)) flushOut();
+  }
+}
+
+void GzipStream::flushBits() {
+  if (bitCount_ > 0) putBits(0, 8 - bitCount_);
+}
+
+void GzipStream::flushOut() {
+  if (outLen_ == 0) return;
+  bytesOut_ += outLen_;
+  sink_(out_, outLen_);
+  outLen_ = 0;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+// Streaming gzip (RFC 1952/1951) encoder with a bounded LZ77 window, sized
+// for the device: window 1 << windowBits bytes, state is roughly
+// 4 * window + 23KB, all on the heap. Blocks use dynamic or fixed Huffman
+// codes, whichever is smaller. Output is pushed to the sink as it is
+// produced.
+class GzipStream {
+ public:
+  using Sink = std::function<void(const uint8_t *data, size_t len)>;
+
+  struct Options {
+    // The defaults are what the firmware uses. Our payloads repeat within a
+    // few lines, so a 1KB window at level 2 compresses as well as 32KB at
+    // level 9 for ~27KB of heap; see tools/gzip_bench.cpp.
+    int level = 2;          // 1 (fastest) .. 9 (smallest): hash chain depth
+    int windowBits = 10;    // 9 .. 15
+  };
+
+  GzipStream(const Options &opts, Sink sink);
+  ~GzipStream();
+
+  void write(const uint8_t *data, size_t len);
+  void write(const char *data, size_t len) { write(reinterpret_cast<const uint8_t *>(data), len); }
+  // Flushes the last block and the gzip trailer. No writes afterwards.
+  void finish();
+
+  uint64_t bytesIn() const { return bytesIn_; }
+  uint64_t bytesOut() const { return bytesOut_; }
+
+  // True when an Accept-Encoding header value allows gzip.
+  static bool accepts(const char *acceptEncoding);
+
+ private:
+  static constexpr size_t kMinMatch = 3;
+  static constexpr size_t kMaxMatch = 258;
+  static constexpr size_t kMinLookahead = kMaxMatch + kMinMatch + 1;
+  static constexpr size_t kMaxTokens = 2048;
+  static constexpr int kHashBits = 11;
+
+  void deflate(bool flush);
+  void slide();
+  size_t longestMatch(size_t pos, size_t &matchPos) const;
+  void insertHash(size_t pos);
+  void emitBlock(bool last);
+  void putBits(uint32_t value, int bits);
+  void flushBits();
+  void flushOut();
+
+  Options opts_;
+  Sink sink_;
+  size_t wsize_;
+  size_t maxDist_;
+  int maxChain_;
+  std::unique_ptr<uint8_t[]> window_;   // 2 * wsize_
+  std::unique_ptr<uint16_t[]> head_;    // 1 << kHashBits
+  std::unique_ptr<uint16_t[]> prev_;    // wsize_
+  std::unique_ptr<uint16_t[]> litLen_;  // kMaxTokens, literal byte or match length
+  std::unique_ptr<uint16_t[]> dist_;    // kMaxTokens, 0 for literals
+  struct BlockScratch;
+  std::unique_ptr<BlockScratch> scratch_;  // Huffman tables for emitBlock()
+  size_t tokens_ = 0;
+  size_t strStart_ = 0;
+  size_t end_ = 0;
+  uint32_t crc_ = 0;
+  uint64_t bytesIn_ = 0;
+  uint64_t bytesOut_ = 0;
+  uint64_t bitBuf_ = 0;
+  int bitCount_ = 0;
+  uint8_t out_[512];
+  size_t outLen_ = 0;
+  bool finished_ = false;
+};
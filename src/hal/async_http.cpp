@@ -0,0 +1,514 @@
+#include "async_http.h"
+
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <map>
+
+#include "logger.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0  // lwip never raises SIGPIPE
+#endif
+
+namespace hal {
+
+namespace {
+
+using StringMap = std::map<std::string, std::string, std::less<>>;
+const std::string kEmpty;
+
+std::string urlDecode(const std::string &in) {
+  std::string out;
+  out.reserve(in.size());
+  for (size_t i = 0; i < in.size(); ++i) {
+    char c = in[i];
+    if (c == '+') {
+      out += ' ';
+    } else if (c == '%' && i + 2 < in.size()) {
+      out += static_cast<char>(strtol(in.substr(i + 1, 2).c_str(), nullptr, 16));
+      i += 2;
+    } else {
+      out += c;
+    }
+  }
+  return out;
+}
+
+void parseArgs(const std::string &query, StringMap &args) {
+  size_t pos = 0;
+  while (pos < query.size()) {
+    size_t amp = query.find('&', pos);
+    if (amp == std::string::npos) amp = query.size();
+    const std::string pair = query.substr(pos, amp - pos);
+    size_t eq = pair.find('=');
+    if (eq == std::string::npos) {
+      args[urlDecode(pair)] = "";
+    } else {
+      args[urlDecode(pair.substr(0, eq))] = urlDecode(pair.substr(eq + 1));
+    }
+    pos = amp + 1;
+  }
+}
+
+std::string lower(std::string s) {
+  for (char &c : s) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+  return s;
+}
+
+const char *reasonPhrase(int code) {
+  switch (code) {
+    case 200: return "OK";
+    case 206: return "Partial Content";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 413: return "Payload Too Large";
+    case 416: return "Range Not Satisfiable";
+    case 431: return "Request Header Fields Too Large";
+    case 500: return "Internal Server Error";
+    case 503: return "Service Unavailable";
+    default: return "Unknown";
+  }
+}
+
+void setNonBlocking(int fd) {
+  const int flags = fcntl(fd, F_GETFL, 0);
+  fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+}
+
+// Returns bytes sent, 0 when the socket buffer is full, -1 on error.
+int sendSome(int fd, const char *data, size_t len) {
+  const ssize_t n = ::send(fd, data, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+  if (n >= 0) return static_cast<int>(n);
+  return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : -1;
+}
+
+void appendChunk(std::string &out, const char *data, size_t len) {
+  char size[20];
+  snprintf(size, sizeof(size), "%zx\r\n", len);
+  out += size;
+  out.append(data, len);
+  out += "\r\n";
+}
+
+// Event stream socket handed to the app. The response header is sent ahead
+// of the first event.
+class SocketChannel : public EventChannel {
+ public:
+  SocketChannel(int fd, std::string header) : fd_(fd), pending_(std::move(header)) {}
+  ~SocketChannel() override { ::close(fd_); }
+
+  int write(const uint8_t *data, size_t len) override {
+    while (!pending_.empty()) {
+      const int n = sendSome(fd_, pending_.data(), pending_.size());
+      if (n <= 0) return n;
+      pending_.erase(0, static_cast<size_t>(n));
+    }
+    if (len == 0) return 0;
+    return sendSome(fd_, reinterpret_cast<const char *>(data), len);
+  }
+
+ private:
+  int fd_;
+  std::string pending_;
+};
+
+}  // namespace
+
+struct AsyncHttpServer::Conn {
+  int fd = -1;
+  std::string in;
+  std::string out;           // queued response bytes
+  size_t outSent = 0;
+  BodySource source;         // rest of the body, pulled as out drains
+  bool chunked = false;      // frame source output as chunks
+  bool keepAlive = true;     // of the response in progress
+  bool peerClosed = false;
+  bool detached = false;     // socket now owned by an EventChannel
+  uint64_t lastActivityMs = 0;
+
+  bool busy() const { return outSent < out.size() || static_cast<bool>(source); }
+  bool requestBuffered() const { return in.find("\r\n\r\n") != std::string::npos; }
+};
+
+class AsyncHttpServer::Context : public HttpContext {
+ public:
+  Context(Conn &conn, bool http11, StringMap args, StringMap headers)
+      : conn_(conn), http11_(http11), args_(std::move(args)), headers_(std::move(headers)) {}
+
+  bool responded() const { return responded_; }
+
+  bool hasArg(const char *name) const override { return args_.count(name) != 0; }
+
+  const std::string &arg(const char *name) const override {
+    auto it = args_.find(name);
+    return it == args_.end() ? kEmpty : it->second;
+  }
+
+  const std::string &header(const char *name) const override {
+    auto it = headers_.find(lower(name));
+    return it == headers_.end() ? kEmpty : it->second;
+  }
+
+  void sendHeader(const char *name, const std::string &value) override {
+    extraHeaders_ += name;
+    extraHeaders_ += ": ";
+    extraHeaders_ += value;
+    extraHeaders_ += "\r\n";
+  }
+
+  using HttpContext::send;
+  void send(int code, const char *contentType, const char *body, size_t len) override {
+    writeHead(code, contentType, static_cast<int64_t>(len));
+    conn_.out.append(body, len);
+  }
+
+  using HttpContext::sendFile;
+  void sendFile(int code, std::unique_ptr<File> f, const char *contentType) override {
+    writeHead(code, contentType, static_cast<int64_t>(f->size() - f->position()));
+    std::shared_ptr<File> file(std::move(f));
+    conn_.chunked = false;
+    conn_.source = [file](std::string &out) {
+      constexpr size_t kChunk = 4096;
+      const size_t start = out.size();
+      out.resize(start + kChunk);
+      const size_t n = file->read(reinterpret_cast<uint8_t *>(&out[start]), kChunk);
+      out.resize(start + n);
+      if (n > 0) return true;
+      file->close();
+      return false;
+    };
+  }
+
+  void sendStream(int code, const char *contentType, BodySource source) override {
+    beginStream(code, contentType);
+    conn_.source = std::move(source);
+  }
+
+  void beginStream(int code, const char *contentType) override {
+    // HTTP/1.0 has no chunking: the body ends when the connection closes.
+    if (http11_) sendHeader("Transfer-Encoding", "chunked");
+    conn_.chunked = http11_;
+    writeHead(code, contentType, -1);
+  }
+
+  void streamWrite(const uint8_t *data, size_t len) override {
+    if (len == 0) return;
+    if (conn_.chunked) {
+      appendChunk(conn_.out, reinterpret_cast<const char *>(data), len);
+    } else {
+      conn_.out.append(reinterpret_cast<const char *>(data), len);
+    }
+  }
+
+  void endStream() override {
+    if (conn_.chunked) conn_.out += "0\r\n\r\n";
+  }
+
+  std::unique_ptr<EventChannel> openEventStream() override {
+    responded_ = true;
+    conn_.detached = true;
+    std::string head = "HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\n";
+    head += extraHeaders_;
+    head += "Connection: keep-alive\r\n\r\n";
+    return std::unique_ptr<EventChannel>(new SocketChannel(conn_.fd, std::move(head)));
+  }
+
+ private:
+  // length < 0: no Content-Length (chunked, or close-delimited on HTTP/1.0).
+  void writeHead(int code, const char *contentType, int64_t length) {
+    responded_ = true;
+    if (length < 0 && !http11_) conn_.keepAlive = false;
+    char line[160];
+    snprintf(line, sizeof(line), "HTTP/1.1 %d %s\r\nContent-Type: %s\r\n", code, reasonPhrase(code), contentType);
+    conn_.out += line;
+    if (length >= 0) conn_.out += "Content-Length: " + std::to_string(length) + "\r\n";
+    conn_.out += extraHeaders_;
+    conn_.out += conn_.keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+    extraHeaders_.clear();
+  }
+
+  Conn &conn_;
+  bool http11_;
+  StringMap args_;
+  StringMap headers_;
+  std::string extraHeaders_;
+  bool responded_ = false;
+};
+
+AsyncHttpServer::AsyncHttpServer(uint16_t port) : port_(port) {}
+
+AsyncHttpServer::~AsyncHttpServer() {
+  while (!conns_.empty()) closeConn(conns_.size() - 1);
+  if (listenFd_ >= 0) ::close(listenFd_);
+  if (wakeFd_ >= 0) ::close(wakeFd_);
+}
+
+void AsyncHttpServer::on(const char *path, HttpMethod method, HttpHandler handler) {
+  routes_.push_back(Route{path, method, std::move(handler)});
+}
+
+void AsyncHttpServer::begin() {
+  if (listenFd_ >= 0) return;
+  listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
+  if (listenFd_ < 0) {
+    LOG_ERROR("HTTP socket() failed");
+    return;
+  }
+  int one = 1;
+  setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port_);
+  if (bind(listenFd_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(listenFd_, 8) != 0) {
+    LOG_ERROR("HTTP bind to port %u failed", port_);
+    ::close(listenFd_);
+    listenFd_ = -1;
+    return;
+  }
+  setNonBlocking(listenFd_);
+  LOG_INFO("HTTP listening on port %u", port_);
+
+  // Loopback socket connected to itself: wake() sends, the wait drains.
+  const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  sockaddr_in self = {};
+  socklen_t selfLen = sizeof(self);
+  self.sin_family = AF_INET;
+  self.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (fd >= 0 && bind(fd, reinterpret_cast<sockaddr *>(&self), sizeof(self)) == 0 &&
+      getsockname(fd, reinterpret_cast<sockaddr *>(&self), &selfLen) == 0 &&
+      connect(fd, reinterpret_cast<sockaddr *>(&self), sizeof(self)) == 0) {
+    setNonBlocking(fd);
+    wakeFd_ = fd;
+  } else {
+    if (fd >= 0) ::close(fd);
+    LOG_WARN("HTTP wake socket unavailable; waits run to their timeout");
+  }
+}
+
+void AsyncHttpServer::wake() {
+  if (wakeFd_ < 0) return;
+  const uint8_t b = 0;
+  send(wakeFd_, &b, 1, MSG_DONTWAIT);  // a full queue is already a pending wake
+}
+
+void AsyncHttpServer::poll() {
+  if (listenFd_ < 0) return;
+  const uint64_t now = clock().nowMs();
+  acceptPending(now);
+  for (size_t i = 0; i < conns_.size();) {
+    Conn &c = *conns_[i];
+    bool ok = readInput(c, now);
+    // One request per connection per pass, and only once the previous
+    // response is out, so responses stay in request order.
+    if (ok && !c.busy()) ok = dispatch(c);
+    if (ok && c.detached) {
+      conns_.erase(conns_.begin() + static_cast<long>(i));
+      continue;
+    }
+    if (ok) ok = flushOutput(c, now);
+    if (ok && !c.busy()) {
+      if (!c.keepAlive || (c.peerClosed && !c.requestBuffered())) ok = false;
+    }
+    if (ok) {
+      const uint32_t limit = c.busy() ? kSendStallMs : kIdleTimeoutMs;
+      if (now - c.lastActivityMs > limit) ok = false;
+    }
+    if (!ok) {
+      closeConn(i);
+      continue;
+    }
+    ++i;
+  }
+}
+
+bool AsyncHttpServer::waitForActivity(uint32_t timeoutMs) {
+  if (listenFd_ < 0) {
+    clock().sleepMs(timeoutMs);
+    return false;
+  }
+  fd_set readFds;
+  fd_set writeFds;
+  FD_ZERO(&readFds);
+  FD_ZERO(&writeFds);
+  FD_SET(listenFd_, &readFds);
+  int maxFd = listenFd_;
+  if (wakeFd_ >= 0) {
+    FD_SET(wakeFd_, &readFds);
+    if (wakeFd_ > maxFd) maxFd = wakeFd_;
+  }
+  for (const std::unique_ptr<Conn> &c : conns_) {
+    if (!c->busy() && c->requestBuffered()) return true;
+    if (c->in.size() < kMaxHeaderBytes + kMaxBodyBytes && !c->peerClosed) FD_SET(c->fd, &readFds);
+    if (c->busy()) FD_SET(c->fd, &writeFds);
+    if (c->fd > maxFd) maxFd = c->fd;
+  }
+  // Wake up in time to expire idle keep-alive connections.
+  if (!conns_.empty() && timeoutMs > kIdleTimeoutMs) timeoutMs = kIdleTimeoutMs;
+  timeval tv;
+  tv.tv_sec = static_cast<long>(timeoutMs / 1000);
+  tv.tv_usec = static_cast<long>((timeoutMs % 1000) * 1000);
+  const int ready = select(maxFd + 1, &readFds, &writeFds, nullptr, &tv);
+  if (ready > 0 && wakeFd_ >= 0 && FD_ISSET(wakeFd_, &readFds)) {
+    uint8_t buf[16];
+    while (recv(wakeFd_, buf, sizeof(buf), 0) > 0) {
+    }
+    return ready > 1;
+  }
+  return ready > 0;
+}
+
+void AsyncHttpServer::acceptPending(uint64_t nowMs) {
+  while (true) {
+    const int fd = accept(listenFd_, nullptr, nullptr);
+    if (fd < 0) return;
+    if (conns_.size() >= kMaxConnections) {
+      static const char kBusy[] =
+          "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nRetry-After: 1\r\nConnection: close\r\n\r\n";
+      sendSome(fd, kBusy, sizeof(kBusy) - 1);
+      ::close(fd);
+      LOG_WARN("HTTP: connection limit (%u) reached, rejected", static_cast<unsigned>(kMaxConnections));
+      continue;
+    }
+    setNonBlocking(fd);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    std::unique_ptr<Conn> c(new Conn);
+    c->fd = fd;
+    c->lastActivityMs = nowMs;
+    conns_.push_back(std::move(c));
+  }
+}
+
+bool AsyncHttpServer::readInput(Conn &c, uint64_t nowMs) {
+  char buf[1024];
+  while (!c.peerClosed && c.in.size() < kMaxHeaderBytes + kMaxBodyBytes) {
+    const ssize_t n = recv(c.fd, buf, sizeof(buf), MSG_DONTWAIT);
+    if (n == 0) {
+      c.peerClosed = true;
+    } else if (n < 0) {
+      return errno == EAGAIN || errno == EWOULDBLOCK;
+    } else {
+      c.in.append(buf, static_cast<size_t>(n));
+      c.lastActivityMs = nowMs;
+    }
+  }
+  return true;
+}
+
+bool AsyncHttpServer::dispatch(Conn &c) {
+  const size_t headerEnd = c.in.find("\r\n\r\n");
+  if (headerEnd == std::string::npos || headerEnd > kMaxHeaderBytes) {
+    if (headerEnd == std::string::npos && c.in.size() <= kMaxHeaderBytes) return true;  // wait for the rest
+    c.keepAlive = false;
+    Context(c, true, StringMap(), StringMap()).send(431, "text/plain", "Header too large");
+    c.in.clear();
+    return true;
+  }
+
+  const size_t lineEnd = c.in.find("\r\n");
+  const std::string line = c.in.substr(0, lineEnd);
+  const size_t sp1 = line.find(' ');
+  const size_t sp2 = line.find(' ', sp1 + 1);
+  if (sp1 == std::string::npos || sp2 == std::string::npos) return false;
+  const std::string method = line.substr(0, sp1);
+  std::string target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+  const bool http11 = line.compare(sp2 + 1, std::string::npos, "HTTP/1.0") != 0;
+
+  StringMap headers;
+  for (size_t pos = lineEnd + 2; pos < headerEnd;) {
+    size_t eol = c.in.find("\r\n", pos);
+    if (eol == std::string::npos || eol > headerEnd) eol = headerEnd;
+    const size_t colon = c.in.find(':', pos);
+    if (colon != std::string::npos && colon < eol) {
+      size_t v = colon + 1;
+      while (v < eol && c.in[v] == ' ') ++v;
+      headers[lower(c.in.substr(pos, colon - pos))] = c.in.substr(v, eol - v);
+    }
+    pos = eol + 2;
+  }
+
+  const size_t contentLength = strtoul(headers["content-length"].c_str(), nullptr, 10);
+  if (contentLength > kMaxBodyBytes) {
+    c.keepAlive = false;
+    Context(c, http11, StringMap(), StringMap()).send(413, "text/plain", "Body too large");
+    c.in.clear();
+    return true;
+  }
+  const size_t bodyStart = headerEnd + 4;
+  if (c.in.size() < bodyStart + contentLength) return !c.peerClosed;  // body still arriving
+
+  StringMap args;
+  const size_t q = target.find('?');
+  if (q != std::string::npos) {
+    parseArgs(target.substr(q + 1), args);
+    target.resize(q);
+  }
+  if (method == "POST") parseArgs(c.in.substr(bodyStart, contentLength), args);
+  c.in.erase(0, bodyStart + contentLength);
+
+  const std::string connection = lower(headers["connection"]);
+  c.keepAlive = http11 ? connection != "close" : connection == "keep-alive";
+
+  const HttpMethod m = (method == "POST") ? HttpMethod::kPost : HttpMethod::kGet;
+  Context ctx(c, http11, std::move(args), std::move(headers));
+  for (const Route &route : routes_) {
+    if (route.path == target && route.method == m) {
+      route.handler(ctx);
+      if (!ctx.responded()) ctx.send(500, "text/plain", "No response");
+      return true;
+    }
+  }
+  ctx.send(404, "text/plain", "Not found: " + target);
+  return true;
+}
+
+bool AsyncHttpServer::flushOutput(Conn &c, uint64_t nowMs) {
+  bool refilled = false;
+  while (true) {
+    if (c.outSent == c.out.size()) {
+      c.out.clear();
+      c.outSent = 0;
+      // At most one buffer of body per pass keeps every pass short.
+      if (!c.source || refilled) return true;
+      refilled = true;
+      while (c.source && c.out.size() < kSendBufferBytes) {
+        std::string piece;
+        const bool more = c.source(piece);
+        if (c.chunked && !piece.empty()) {
+          appendChunk(c.out, piece.data(), piece.size());
+        } else {
+          c.out += piece;
+        }
+        if (!more) {
+          if (c.chunked) c.out += "0\r\n\r\n";
+          c.source = nullptr;
+        }
+      }
+      if (c.out.empty()) return true;
+    }
+    const int n = sendSome(c.fd, c.out.data() + c.outSent, c.out.size() - c.outSent);
+    if (n < 0) return false;
+    if (n == 0) return true;
+    c.outSent += static_cast<size_t>(n);
+    c.lastActivityMs = nowMs;
+  }
+}
+
+void AsyncHttpServer::closeConn(size_t index) {
+  ::close(conns_[index]->fd);
+  conns_.erase(conns_.begin() + static_cast<long>(index));
+}
+
+}  // namespace hal
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "hal.h"
+
+namespace hal {
+
+// Non-blocking HTTP/1.1 server on BSD sockets (lwip on the board, POSIX on
+// Linux), shared by both HttpServer backends.
+//
+// poll() makes one pass over all connections: it accepts, reads and parses
+// requests, runs handlers, and sends at most one send buffer per connection.
+// Handlers queue their response (file and stream bodies are pulled as the
+// socket drains), so a slow download never blocks other clients or the
+// scheduler. Connections are kept alive between requests and closed after
+// kIdleTimeoutMs without traffic or kSendStallMs without send progress.
+class AsyncHttpServer : public HttpServer {
+ public:
+  static constexpr size_t kMaxConnections = 6;
+  static constexpr size_t kMaxHeaderBytes = 8 * 1024;
+  static constexpr size_t kMaxBodyBytes = 8 * 1024;
+  static constexpr size_t kSendBufferBytes = 8 * 1024;  // per connection
+  static constexpr uint32_t kIdleTimeoutMs = 5000;
+  static constexpr uint32_t kSendStallMs = 15000;
+
+  explicit AsyncHttpServer(uint16_t port);
+  ~AsyncHttpServer() override;
+
+  void on(const char *path, HttpMethod method, HttpHandler handler) override;
+  void begin() override;
+  void poll() override;
+  bool waitForActivity(uint32_t timeoutMs) override;
+  void wake() override;
+
+ protected:
+  uint16_t port_;
+
+ private:
+  struct Route {
+    std::string path;
+    HttpMethod method;
+    HttpHandler handler;
+  };
+
+  struct Conn;
+  class Context;
+
+  void acceptPending(uint64_t nowMs);
+  // Each returns false when the connection should be closed.
+  bool readInput(Conn &c, uint64_t nowMs);
+  bool dispatch(Conn &c);
+  bool flushOutput(Conn &c, uint64_t nowMs);
+  void closeConn(size_t index);
+
+  std::vector<Route> routes_;
+  std::vector<std::unique_ptr<Conn>> conns_;
+  int listenFd_ = -1;
+  // UDP socket on 127.0.0.1 that wake() sends a byte to, so select() returns.
+  int wakeFd_ = -1;
+};
+
+}  // namespace hal
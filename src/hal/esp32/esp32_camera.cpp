@@ -0,0 +1,128 @@
+#include <Arduino.h>
+#include "esp_camera.h"
+
+#ifndef CAMERA_MODEL_ESP32S3_EYE
+#define CAMERA_MODEL_ESP32S3_EYE  // default; can be overridden via build_flags
+#endif
+#include "../../camera_pins.h"
+#include "../hal.h"
+#include "../logger.h"
+
+namespace {
+
+class Esp32Camera : public hal::Camera {
+ public:
+  bool begin() override {
+    if (ready_) return true;
+    ready_ = init();
+    return ready_;
+  }
+
+  bool ready() const override { return ready_; }
+
+  bool capture(hal::Frame &out) override {
+    camera_fb_t *fb = esp_camera_fb_get();
+    if (!fb) return false;
+    out.data = fb->buf;
+    out.len = fb->len;
+    out.handle = fb;
+    return true;
+  }
+
+  void release(hal::Frame &frame) override {
+    if (frame.handle) esp_camera_fb_return(static_cast<camera_fb_t *>(frame.handle));
+    frame = hal::Frame();
+  }
+
+  void powerDown() override {
+    setSoftPd(true);
+    esp_camera_deinit();
+    ready_ = false;
+  }
+
+ private:
+  static bool init() {
+    camera_config_t config = {};
+    config.ledc_channel = LEDC_CHANNEL_0;
+    config.ledc_timer = LEDC_TIMER_0;
+    config.pin_d0 = Y2_GPIO_NUM;
+    config.pin_d1 = Y3_GPIO_NUM;
+    config.pin_d2 = Y4_GPIO_NUM;
+    config.pin_d3 = Y5_GPIO_NUM;
+    config.pin_d4 = Y6_GPIO_NUM;
+    config.pin_d5 = Y7_GPIO_NUM;
+    config.pin_d6 = Y8_GPIO_NUM;
+    config.pin_d7 = Y9_GPIO_NUM;
+    config.pin_xclk = XCLK_GPIO_NUM;
+    config.pin_pclk = PCLK_GPIO_NUM;
+    config.pin_vsync = VSYNC_GPIO_NUM;
+    config.pin_href = HREF_GPIO_NUM;
+    config.pin_sccb_sda = SIOD_GPIO_NUM;
+    config.pin_sccb_scl = SIOC_GPIO_NUM;
+    config.pin_pwdn = PWDN_GPIO_NUM;
+    config.pin_reset = RESET_GPIO_NUM;
+    config.xclk_freq_hz = 20000000;
+    config.frame_size = FRAMESIZE_SVGA;
+    config.pixel_format = PIXFORMAT_JPEG;
+    config.grab_mode = CAMERA_GRAB_WHEN_EMPTY;
+    config.fb_location = CAMERA_FB_IN_PSRAM;
+    config.jpeg_quality = 12;
+    config.fb_count = 2;
+
+    if (psramFound()) {
+      config.frame_size = FRAMESIZE_QSXGA;  // 5MP (2592x1944)
+      config.jpeg_quality = 10;
+      config.fb_count = 2;
+      config.grab_mode = CAMERA_GRAB_LATEST;
+      LOG_INFO("PSRAM found and used");
+    } else {
+      config.frame_size = FRAMESIZE_SVGA;
+      config.fb_location = CAMERA_FB_IN_DRAM;
+      config.fb_count = 1;
+      config.jpeg_quality = 14;
+      LOG_WARN("PSRAM not found; using DRAM frame buffer");
+    }
+
+    esp_err_t err = esp_camera_init(&config);
+    if (err != ESP_OK) {
+      LOG_ERROR("Camera init failed: 0x%x", err);
+      return false;
+    }
+
+    sensor_t *s = esp_camera_sensor_get();
+    if (s) {
+      s->set_vflip(s, 1);
+      s->set_brightness(s, 1);
+      s->set_saturation(s, 0);
+      s->set_gain_ctrl(s, 1);
+      s->set_exposure_ctrl(s, 1);
+      LOG_INFO("Camera sensor configured");
+    }
+    return true;
+  }
+
+  static void setSoftPd(bool enable) {
+    sensor_t *s = esp_camera_sensor_get();
+    if (!s || s->id.PID != OV5640_PID) return;
+    int reg = s->get_reg(s, 0x3008, 0xFF);
+    if (reg < 0) return;
+    if (enable) {
+      reg |= 0x40;  // Bit6 = software power down.
+    } else {
+      reg &= ~0x40;
+    }
+    s->set_reg(s, 0x3008, 0xFF, reg);
+  }
+
+  bool ready_ = false;
+};
+
+Esp32Camera gCamera;
+
+}  // namespace
+
+namespace hal {
+
+Camera &camera() { return gCamera; }
+
+}  // namespace hal
@@ -0,0 +1,16 @@
+#include "../async_http.h"
+
+namespace {
+
+// lwip provides the BSD socket API, so the board runs the same non-blocking
+// server as the simulator. select() blocks the loop task between requests,
+// which lets automatic light sleep kick in.
+hal::AsyncHttpServer gHttp(80);
+
+}  // namespace
+
+namespace hal {
+
+HttpServer &http() { return gHttp; }
+
+}  // namespace hal
@@ -0,0 +1,165 @@
+#include <Arduino.h>
+#include <Preferences.h>
+#include <esp_heap_caps.h>
+
+#include "../hal.h"
+
+// DHT11 data pin (set via build flag DHT11_PIN, defaults to GPIO 4).
+#ifndef DHT11_PIN
+#define DHT11_PIN 4
+#endif
+constexpr uint8_t kDhtPin = static_cast<uint8_t>(DHT11_PIN);
+
+static const char *kPrefsNs = "cfg";
+
+namespace {
+
+class Esp32Clock : public hal::Clock {
+ public:
+  uint64_t nowUs() override { return static_cast<uint64_t>(esp_timer_get_time()); }
+  void sleepMs(uint32_t ms) override { delay(ms); }
+};
+
+class Dht11 : public hal::DhtSensor {
+ public:
+  bool read(int &temperatureC, int &humidity) override {
+    constexpr int kAttempts = 3;
+    for (int i = 0; i < kAttempts; ++i) {
+      if (readOnce(temperatureC, humidity)) return true;
+      delay(50);
+    }
+    return false;
+  }
+
+ private:
+  static uint32_t expectPulse(bool level) {
+    constexpr uint32_t kMaxCycles = 12000;  // ~120us guard
+    uint32_t count = 0;
+    while (digitalRead(kDhtPin) == level) {
+      if (++count >= kMaxCycles) return 0;
+    }
+    return count;
+  }
+
+  static bool readOnce(int &temperatureC, int &humidity) {
+    uint8_t data[5] = {0, 0, 0, 0, 0};
+    pinMode(kDhtPin, OUTPUT);
+    digitalWrite(kDhtPin, HIGH);
+    delay(250);
+    digitalWrite(kDhtPin, LOW);
+    delay(20);
+    digitalWrite(kDhtPin, HIGH);
+    delayMicroseconds(40);
+    pinMode(kDhtPin, INPUT_PULLUP);
+
+    if (!expectPulse(LOW) || !expectPulse(HIGH)) return false;
+
+    for (int i = 0; i < 40; ++i) {
+      uint32_t lowCycles = expectPulse(LOW);
+      if (!lowCycles) return false;
+      uint32_t highCycles = expectPulse(HIGH);
+      if (!highCycles) return false;
+      data[i / 8] <<= 1;
+      if (highCycles > lowCycles) data[i / 8] |= 1;
+    }
+
+    uint8_t checksum = (data[0] + data[1] + data[2] + data[3]) & 0xFF;
+    if (checksum != data[4]) return false;
+
+    humidity = data[0];
+    temperatureC = data[2];
+    return true;
+  }
+};
+
+class NvsSettings : public hal::Settings {
+ public:
+  std::string getString(const char *key, const char *def) override {
+    prefs_.begin(kPrefsNs, true);
+    String v = prefs_.getString(key, def);
+    prefs_.end();
+    return std::string(v.c_str());
+  }
+
+  uint32_t getULong(const char *key, uint32_t def) override {
+    prefs_.begin(kPrefsNs, true);
+    uint32_t v = prefs_.getULong(key, def);
+    prefs_.end();
+    return v;
+  }
+
+  void putString(const char *key, const std::string &value) override {
+    prefs_.begin(kPrefsNs, false);
+    prefs_.putString(key, value.c_str());
+    prefs_.end();
+  }
+
+  void putULong(const char *key, uint32_t value) override {
+    prefs_.begin(kPrefsNs, false);
+    prefs_.putULong(key, value);
+    prefs_.end();
+  }
+
+ private:
+  Preferences prefs_;
+};
+
+// Pinned to core 0 (loop() runs on core 1) at the lowest priority above
+// idle, so it only takes time the Wi-Fi stack and system tasks leave over.
+class TaskWorker : public hal::Worker {
+ public:
+  explicit TaskWorker(std::function<void(hal::Worker &)> body) : body_(std::move(body)) {}
+
+  void start(const char *name) { xTaskCreatePinnedToCore(entry, name, 4096, this, tskIDLE_PRIORITY + 1, &task_, 0); }
+  void wake() override {
+    if (task_) xTaskNotifyGive(task_);
+  }
+  bool waitForWork(uint32_t timeoutMs) override { return ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeoutMs)) > 0; }
+
+ private:
+  static void entry(void *arg) {
+    TaskWorker *self = static_cast<TaskWorker *>(arg);
+    self->body_(*self);
+    vTaskDelete(nullptr);
+  }
+
+  std::function<void(hal::Worker &)> body_;
+  TaskHandle_t task_ = nullptr;
+};
+
+Esp32Clock gClock;
+Dht11 gDht;
+NvsSettings gSettings;
+
+}  // namespace
+
+namespace hal {
+
+Clock &clock() { return gClock; }
+DhtSensor &dht() { return gDht; }
+Settings &settings() { return gSettings; }
+
+static void fillHeapRegion(uint32_t caps, HeapRegion &r) {
+  r.totalBytes = heap_caps_get_total_size(caps);
+  r.present = r.totalBytes > 0;
+  r.freeBytes = heap_caps_get_free_size(caps);
+  r.largestFreeBlock = heap_caps_get_largest_free_block(caps);
+  r.minFreeBytes = heap_caps_get_minimum_free_size(caps);
+}
+
+void heapStats(HeapRegion &internal, HeapRegion &psram) {
+  fillHeapRegion(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, internal);
+  fillHeapRegion(MALLOC_CAP_SPIRAM, psram);
+}
+
+void consoleWrite(const char *data, size_t len) { Serial.write(reinterpret_cast<const uint8_t *>(data), len); }
+
+Worker &startWorker(const char *name, std::function<void(Worker &)> body) {
+  TaskWorker *w = new TaskWorker(std::move(body));
+  w->start(name);
+  return *w;
+}
+
+TaskId currentTaskId() { return reinterpret_cast<TaskId>(xTaskGetCurrentTaskHandle()); }
+
+}  // namespace hal
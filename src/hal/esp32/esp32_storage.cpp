@@ -0,0 +1,124 @@
+#include <Arduino.h>
+#include <FS.h>
+#include <SD_MMC.h>
+
+#include "../async_http.h"
+#include "../hal.h"
+#include "../logger.h"
+
+static const int kSdClkPin = 39;
+static const int kSdCmdPin = 38;
+static const int kSdData0Pin = 40;
+// If your hardware wires SD D1/D2/D3, define the pins below and use 4-bit mode.
+// static const int kSdData1Pin = -1;
+// static const int kSdData2Pin = -1;
+// static const int kSdData3Pin = -1;
+// FATFS handles. Every HTTP connection may hold one for a file body for as
+// long as the client takes to drain it, so the rest are counted on top: the
+// loop task's capture/readings/rollup file, the gzip sidecar job's source and
+// destination, and the log drain. A handle costs ~550 bytes of internal RAM.
+static const int kMaxOpenFiles = static_cast<int>(hal::AsyncHttpServer::kMaxConnections) + 4;
+
+namespace {
+
+class SdFile : public hal::File {
+ public:
+  explicit SdFile(fs::File f) : f_(f) {}
+  ~SdFile() override { close(); }
+
+  size_t read(uint8_t *buf, size_t len) override {
+    int n = f_.read(buf, len);
+    return n > 0 ? static_cast<size_t>(n) : 0;
+  }
+  size_t write(const uint8_t *buf, size_t len) override { return f_.write(buf, len); }
+  bool seek(uint64_t pos) override { return f_.seek(static_cast<uint32_t>(pos), SeekSet); }
+  uint64_t position() override { return f_.position(); }
+  uint64_t size() override { return f_.size(); }
+  void close() override {
+    if (f_) f_.close();
+  }
+
+ private:
+  fs::File f_;
+};
+
+static std::string baseName(const char *name) {
+  // Older cores return the full path from File::name(), newer ones the base name.
+  const char *slash = strrchr(name, '/');
+  return std::string(slash ? slash + 1 : name);
+}
+
+class SdMmcStorage : public hal::Storage {
+ public:
+  bool begin() override {
+    SD_MMC.setPins(kSdClkPin, kSdCmdPin, kSdData0Pin);
+    // Use 1-bit mode (only D0 wired) but run at high freq for better throughput.
+    // If you wire D1/D2/D3, change the begin() second argument to false (4-bit) and set pins above.
+    const uint32_t freq = SDMMC_FREQ_HIGHSPEED;  // target 40MHz if board/cable/card are OK
+    if (!SD_MMC.begin("/sdcard", true, true, freq, kMaxOpenFiles)) {
+      return false;
+    }
+
+    uint8_t cardType = SD_MMC.cardType();
+    if (cardType == CARD_NONE) {
+      LOG_ERROR("No SD_MMC card attached");
+      return false;
+    }
+
+    const char *type = "UNKNOWN";
+    switch (cardType) {
+      case CARD_MMC: type = "MMC"; break;
+      case CARD_SD: type = "SDSC"; break;
+      case CARD_SDHC: type = "SDHC"; break;
+      default: break;
+    }
+    LOG_INFO("SD_MMC Card Type: %s", type);
+    LOG_INFO("Card size: %lluMB", SD_MMC.cardSize() / (1024ULL * 1024ULL));
+    return true;
+  }
+
+  bool exists(const char *path) override { return SD_MMC.exists(path); }
+  bool mkdir(const char *path) override { return SD_MMC.mkdir(path); }
+  bool remove(const char *path) override { return SD_MMC.remove(path); }
+  bool rename(const char *from, const char *to) override { return SD_MMC.rename(from, to); }
+
+  std::unique_ptr<hal::File> open(const char *path, hal::OpenMode mode) override {
+    const char *m = FILE_READ;
+    if (mode == hal::OpenMode::kWrite) m = FILE_WRITE;
+    if (mode == hal::OpenMode::kAppend) m = FILE_APPEND;
+    if (mode == hal::OpenMode::kUpdate) m = "r+";
+    fs::File f = SD_MMC.open(path, m);
+    if (!f || f.isDirectory()) return nullptr;
+    return std::unique_ptr<hal::File>(new SdFile(f));
+  }
+
+  bool listDir(const char *path, const std::function<bool(const hal::DirEntry &)> &fn) override {
+    fs::File dir = SD_MMC.open(path);
+    if (!dir || !dir.isDirectory()) return false;
+    hal::DirEntry entry;
+    fs::File f = dir.openNextFile();
+    while (f) {
+      entry.name = baseName(f.name());
+      entry.isDir = f.isDirectory();
+      entry.size = entry.isDir ? 0 : f.size();
+      f.close();
+      if (!fn(entry)) break;
+      f = dir.openNextFile();
+    }
+    dir.close();
+    return true;
+  }
+
+  uint64_t totalBytes() override { return SD_MMC.totalBytes(); }
+  uint64_t usedBytes() override { return SD_MMC.usedBytes(); }
+};
+
+SdMmcStorage gStorage;
+
+}  // namespace
+
+namespace hal {
+
+Storage &cardStorage() { return gStorage; }
+
+}  // namespace hal
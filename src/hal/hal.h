@@ -0,0 +1,230 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+
+// Thin hardware abstraction used by the application code in app.cpp.
+// The ESP32 implementations live in hal/esp32/, the Linux simulator ones in
+// hal/native/, and code shared by both (the socket HTTP server) in hal/.
+// Each platform provides the accessor functions at the bottom.
+namespace hal {
+
+// ----------------- Clock -----------------
+class Clock {
+ public:
+  virtual ~Clock() = default;
+  // Monotonic time since boot.
+  virtual uint64_t nowUs() = 0;
+  uint64_t nowMs() { return nowUs() / 1000ULL; }
+  virtual void sleepMs(uint32_t ms) = 0;
+};
+
+// ----------------- Camera -----------------
+struct Frame {
+  const uint8_t *data = nullptr;
+  size_t len = 0;
+  void *handle = nullptr;  // backend specific (camera_fb_t* on ESP32)
+};
+
+class Camera {
+ public:
+  virtual ~Camera() = default;
+  // Powers the sensor up if needed. Cheap when already running.
+  virtual bool begin() = 0;
+  virtual bool ready() const = 0;
+  // Grabs one JPEG frame. Must be handed back with release().
+  virtual bool capture(Frame &out) = 0;
+  virtual void release(Frame &frame) = 0;
+  virtual void powerDown() = 0;
+};
+
+// ----------------- DHT sensor -----------------
+class DhtSensor {
+ public:
+  virtual ~DhtSensor() = default;
+  virtual bool read(int &temperatureC, int &humidity) = 0;
+};
+
+// ----------------- Storage -----------------
+// kWrite truncates; kUpdate opens an existing file for reading and writing
+// in place.
+enum class OpenMode { kRead, kWrite, kAppend, kUpdate };
+
+// Who is using the card, highest priority first; storage() queues access to
+// the bus by class (hal/io_sched.h).
+enum class IoClass { kCapture, kLog, kBulk };
+constexpr int kIoClassCount = 3;
+
+class File {
+ public:
+  virtual ~File() = default;
+  virtual size_t read(uint8_t *buf, size_t len) = 0;
+  virtual size_t write(const uint8_t *buf, size_t len) = 0;
+  virtual bool seek(uint64_t pos) = 0;
+  virtual uint64_t position() = 0;
+  virtual uint64_t size() = 0;
+  virtual void close() = 0;
+
+  size_t write(const std::string &s) { return write(reinterpret_cast<const uint8_t *>(s.data()), s.size()); }
+};
+
+struct DirEntry {
+  std::string name;  // base name, no directory part
+  bool isDir = false;
+  uint64_t size = 0;
+};
+
+class Storage {
+ public:
+  virtual ~Storage() = default;
+  virtual bool begin() = 0;
+  virtual bool exists(const char *path) = 0;
+  virtual bool mkdir(const char *path) = 0;
+  virtual bool remove(const char *path) = 0;
+  virtual bool rename(const char *from, const char *to) = 0;
+  // Returns nullptr when the file cannot be opened.
+  virtual std::unique_ptr<File> open(const char *path, OpenMode mode) = 0;
+  // open() on behalf of an I/O class. Plain open() counts reads as kBulk and
+  // writes as kLog; backends that do not schedule ignore cls.
+  virtual std::unique_ptr<File> openFor(const char *path, OpenMode mode, IoClass cls) {
+    (void)cls;
+    return open(path, mode);
+  }
+  // Calls fn for each entry in path; fn returns false to stop early.
+  // Returns false when the directory cannot be opened.
+  virtual bool listDir(const char *path, const std::function<bool(const DirEntry &)> &fn) = 0;
+  virtual uint64_t totalBytes() = 0;
+  virtual uint64_t usedBytes() = 0;
+};
+
+// ----------------- HTTP -----------------
+enum class HttpMethod { kGet, kPost };
+
+// Response connection kept open after its handler returned (Server-Sent
+// Events). write() never blocks: it returns how many bytes the socket took,
+// possibly 0, or -1 once the peer is gone. Destroying it closes the socket.
+class EventChannel {
+ public:
+  virtual ~EventChannel() = default;
+  virtual int write(const uint8_t *data, size_t len) = 0;
+};
+
+// Produces a response body piece by piece: appends the next piece to out and
+// returns false after the last one. Called as the connection drains.
+using BodySource = std::function<bool(std::string &out)>;
+
+class HttpContext {
+ public:
+  virtual ~HttpContext() = default;
+  virtual bool hasArg(const char *name) const = 0;
+  // Empty when absent. Valid until the handler returns.
+  virtual const std::string &arg(const char *name) const = 0;
+  // Request header value, empty when absent.
+  virtual const std::string &header(const char *name) const = 0;
+  // Adds a header to the response started by the next send*/beginStream call.
+  virtual void sendHeader(const char *name, const std::string &value) = 0;
+  virtual void send(int code, const char *contentType, const char *body, size_t len) = 0;
+  void send(int code, const char *contentType, const std::string &body) {
+    send(code, contentType, body.data(), body.size());
+  }
+  // Sends the remaining bytes of f as the response body. The server reads
+  // and closes the file as the client drains it, after the handler returned.
+  virtual void sendFile(int code, std::unique_ptr<File> f, const char *contentType) = 0;
+  void sendFile(std::unique_ptr<File> f, const char *contentType) { sendFile(200, std::move(f), contentType); }
+  // Body of unknown length pulled from source as the client drains it
+  // (chunked transfer encoding).
+  virtual void sendStream(int code, const char *contentType, BodySource source) = 0;
+  // Body of unknown length written from within the handler (chunked).
+  virtual void beginStream(int code, const char *contentType) = 0;
+  virtual void streamWrite(const uint8_t *data, size_t len) = 0;
+  virtual void endStream() = 0;
+  // Sends a 200 text/event-stream header and hands the connection to the
+  // caller. Nothing else may be sent on this request afterwards. Returns
+  // nullptr when the connection could not be kept.
+  virtual std::unique_ptr<EventChannel> openEventStream() = 0;
+};
+
+using HttpHandler = std::function<void(HttpContext &)>;
+
+class HttpServer {
+ public:
+  virtual ~HttpServer() = default;
+  virtual void on(const char *path, HttpMethod method, HttpHandler handler) = 0;
+  virtual void begin() = 0;
+  // Services pending clients; returns without blocking when idle.
+  virtual void poll() = 0;
+  // Blocks until a client needs service or timeoutMs elapsed. Returns true
+  // when poll() has work.
+  virtual bool waitForActivity(uint32_t timeoutMs) = 0;
+  // Makes a waitForActivity() in progress (or the next one) return early.
+  // For other tasks, e.g. the Wi-Fi event task; it is a socket call, so not
+  // from timer callbacks or ISRs.
+  virtual void wake() = 0;
+};
+
+// ----------------- Settings -----------------
+// Small persistent key/value store (NVS Preferences on the device).
+class Settings {
+ public:
+  virtual ~Settings() = default;
+  virtual std::string getString(const char *key, const char *def) = 0;
+  virtual uint32_t getULong(const char *key, uint32_t def) = 0;
+  virtual void putString(const char *key, const std::string &value) = 0;
+  virtual void putULong(const char *key, uint32_t value) = 0;
+};
+
+// ----------------- Memory -----------------
+struct HeapRegion {
+  bool present = false;
+  uint32_t totalBytes = 0;
+  uint32_t freeBytes = 0;
+  uint32_t largestFreeBlock = 0;  // biggest single allocation that would succeed
+  uint32_t minFreeBytes = 0;      // lowest freeBytes since boot
+};
+
+// Internal RAM and PSRAM heaps. The simulator reports the process heap as
+// internal and no PSRAM.
+void heapStats(HeapRegion &internal, HeapRegion &psram);
+
+// ----------------- Background work -----------------
+// A low-priority task for work that must never delay the loop (a FreeRTOS
+// task on the idle core on the board, a thread on Linux).
+class Worker {
+ public:
+  virtual ~Worker() = default;
+  // Wakes the worker. Never blocks; any task may call it.
+  virtual void wake() = 0;
+  // Called by the worker itself: blocks until wake() or timeoutMs. Returns
+  // true when woken.
+  virtual bool waitForWork(uint32_t timeoutMs) = 0;
+};
+
+// Starts body on a new worker that lives for the rest of the program; body
+// normally loops forever.
+Worker &startWorker(const char *name, std::function<void(Worker &)> body);
+
+// Identifies the calling task: its FreeRTOS handle on the board (which covers
+// plain xTaskCreate tasks as well as pthreads), its thread on Linux. Never 0.
+using TaskId = uintptr_t;
+TaskId currentTaskId();
+
+// ----------------- Platform accessors -----------------
+Clock &clock();
+Camera &camera();
+DhtSensor &dht();
+// The card, with access queued by IoClass. cardStorage() is the backend
+// itself and only used by that queue.
+Storage &storage();
+Storage &cardStorage();
+HttpServer &http();
+Settings &settings();
+
+// Raw console output (Serial on the device, stdout on Linux). Blocks while
+// the UART drains; application code logs through hal/logger.h instead.
+void consoleWrite(const char *data, size_t len);
+
+}  // namespace hal
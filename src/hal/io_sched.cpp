@@ -0,0 +1,192 @@
+#include "io_sched.h"
+
+namespace hal {
+
+namespace {
+
+class ScheduledFile : public File {
+ public:
+  ScheduledFile(std::unique_ptr<File> f, IoGate &gate, IoClass cls) : f_(std::move(f)), gate_(gate), cls_(cls) {}
+  ~ScheduledFile() override { close(); }
+
+  size_t read(uint8_t *buf, size_t len) override {
+    // Bulk reads give the bus up between slices.
+    const size_t slice = cls_ == IoClass::kBulk ? ScheduledStorage::kBulkSliceBytes : len;
+    size_t done = 0;
+    while (done < len) {
+      IoGate::Lease lease(gate_, cls_);
+      const size_t want = len - done < slice ? len - done : slice;
+      const size_t n = f_->read(buf + done, want);
+      lease.bytes = n;
+      done += n;
+      if (n < want) break;
+    }
+    return done;
+  }
+
+  size_t write(const uint8_t *buf, size_t len) override {
+    IoGate::Lease lease(gate_, cls_);
+    const size_t n = f_->write(buf, len);
+    lease.bytes = n;
+    return n;
+  }
+
+  bool seek(uint64_t pos) override {
+    IoGate::Lease lease(gate_, cls_);
+    return f_->seek(pos);
+  }
+
+  uint64_t position() override { return f_->position(); }
+
+  uint64_t size() override {
+    IoGate::Lease lease(gate_, cls_);
+    return f_->size();
+  }
+
+  void close() override {
+    if (closed_) return;
+    closed_ = true;
+    IoGate::Lease lease(gate_, cls_);
+    f_->close();
+  }
+
+ private:
+  std::unique_ptr<File> f_;
+  IoGate &gate_;
+  IoClass cls_;
+  bool closed_ = false;
+};
+
+uint64_t clockUs() { return clock().nowUs(); }
+
+IoGate &gate() {
+  static IoGate g(clockUs);
+  return g;
+}
+
+}  // namespace
+
+bool IoGate::higherWaiting(int cls) const {
+  for (int c = 0; c < cls; ++c) {
+    if (stats_.cls[c].queued > 0) return true;
+  }
+  return false;
+}
+
+void IoGate::acquire(IoClass cls) {
+  const TaskId self = currentTaskId();
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (depth_ > 0 && owner_ == self) {
+    ++depth_;
+    return;
+  }
+  const int c = static_cast<int>(cls);
+  IoClassStats &s = stats_.cls[c];
+  const uint32_t ticket = nextTicket_[c]++;
+  const bool busy = depth_ > 0 || serving_[c] != ticket || higherWaiting(c);
+  const uint64_t startUs = busy ? nowUs_() : 0;
+  if (busy) {
+    ++s.waited;
+    if (++s.queued > s.maxQueued) s.maxQueued = s.queued;
+    cv_.wait(lock, [&] { return depth_ == 0 && serving_[c] == ticket && !higherWaiting(c); });
+    --s.queued;
+  }
+  ++serving_[c];
+  owner_ = self;
+  depth_ = 1;
+  ownerClass_ = c;
+  heldSinceUs_ = nowUs_();
+  ++s.ops;
+  if (busy) {
+    const uint64_t waitUs = heldSinceUs_ - startUs;
+    s.totalWaitUs += waitUs;
+    if (waitUs > s.maxWaitUs) s.maxWaitUs = static_cast<uint32_t>(waitUs);
+  }
+}
+
+void IoGate::release(uint64_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  IoClassStats &s = stats_.cls[ownerClass_];
+  s.bytes += bytes;
+  if (--depth_ > 0) return;
+  const uint64_t heldUs = nowUs_() - heldSinceUs_;
+  if (heldUs > s.maxHoldUs) s.maxHoldUs = static_cast<uint32_t>(heldUs);
+  owner_ = 0;
+  cv_.notify_all();
+}
+
+IoStats IoGate::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+bool ScheduledStorage::begin() {
+  IoGate::Lease lease(gate_, IoClass::kLog);
+  return backend_.begin();
+}
+
+bool ScheduledStorage::exists(const char *path) {
+  IoGate::Lease lease(gate_, IoClass::kLog);
+  return backend_.exists(path);
+}
+
+bool ScheduledStorage::mkdir(const char *path) {
+  IoGate::Lease lease(gate_, IoClass::kLog);
+  return backend_.mkdir(path);
+}
+
+bool ScheduledStorage::remove(const char *path) {
+  IoGate::Lease lease(gate_, IoClass::kLog);
+  return backend_.remove(path);
+}
+
+bool ScheduledStorage::rename(const char *from, const char *to) {
+  IoGate::Lease lease(gate_, IoClass::kLog);
+  return backend_.rename(from, to);
+}
+
+std::unique_ptr<File> ScheduledStorage::open(const char *path, OpenMode mode) {
+  return openFor(path, mode, mode == OpenMode::kRead ? IoClass::kBulk : IoClass::kLog);
+}
+
+std::unique_ptr<File> ScheduledStorage::openFor(const char *path, OpenMode mode, IoClass cls) {
+  std::unique_ptr<File> f;
+  {
+    IoGate::Lease lease(gate_, cls);
+    f = backend_.open(path, mode);
+  }
+  if (!f) return nullptr;
+  return std::unique_ptr<File>(new ScheduledFile(std::move(f), gate_, cls));
+}
+
+// The lease covers the backend's directory reads only. It is dropped while
+// the callback runs, which may open files or list subdirectories, so a
+// capture waits for one directory entry at most, not for a whole listing.
+bool ScheduledStorage::listDir(const char *path, const std::function<bool(const DirEntry &)> &fn) {
+  IoGate::Lease lease(gate_, IoClass::kBulk);
+  return backend_.listDir(path, [&](const DirEntry &e) {
+    gate_.release();
+    const bool more = fn(e);
+    gate_.acquire(IoClass::kBulk);
+    return more;
+  });
+}
+
+uint64_t ScheduledStorage::totalBytes() {
+  IoGate::Lease lease(gate_, IoClass::kLog);
+  return backend_.totalBytes();
+}
+
+uint64_t ScheduledStorage::usedBytes() {
+  IoGate::Lease lease(gate_, IoClass::kLog);
+  return backend_.usedBytes();
+}
+
+Storage &storage() {
+  static ScheduledStorage scheduled(cardStorage(), gate());
+  return scheduled;
+}
+
+IoStats ioStats() { return gate().stats(); }
+
+}  // namespace hal
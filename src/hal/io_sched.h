@@ -0,0 +1,102 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include "hal.h"
+
+namespace hal {
+
+// Card access is serialized through one gate with a FIFO queue per IoClass.
+// When the bus frees up, the oldest waiter of the highest class with anyone
+// waiting goes next: a frame write waiting behind a log flush or an HTTP read
+// runs as soon as that operation ends, and HTTP reads never hold the bus for
+// more than kBulkSliceBytes at a time.
+//
+// The gate is re-entrant for the task holding it, and the class of the
+// outermost lease applies. listDir() holds it for the directory reads only,
+// not while its callback runs.
+struct IoClassStats {
+  uint32_t ops = 0;          // leases taken
+  uint64_t bytes = 0;        // read or written under them
+  uint32_t waited = 0;       // leases that found the bus busy
+  uint32_t queued = 0;       // waiting right now
+  uint32_t maxQueued = 0;
+  uint64_t totalWaitUs = 0;
+  uint32_t maxWaitUs = 0;
+  uint32_t maxHoldUs = 0;    // longest single operation
+};
+
+struct IoStats {
+  IoClassStats cls[kIoClassCount];
+};
+
+class IoGate {
+ public:
+  using NowUs = uint64_t (*)();
+
+  explicit IoGate(NowUs nowUs) : nowUs_(nowUs) {}
+
+  void acquire(IoClass cls);
+  // bytes moved under the lease, for the stats.
+  void release(uint64_t bytes = 0);
+
+  IoStats stats() const;
+
+  class Lease {
+   public:
+    Lease(IoGate &gate, IoClass cls) : gate_(gate) { gate_.acquire(cls); }
+    ~Lease() { gate_.release(bytes); }
+    Lease(const Lease &) = delete;
+    Lease &operator=(const Lease &) = delete;
+
+    uint64_t bytes = 0;
+
+   private:
+    IoGate &gate_;
+  };
+
+ private:
+  bool higherWaiting(int cls) const;
+
+  NowUs nowUs_;
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  TaskId owner_ = 0;
+  int depth_ = 0;
+  int ownerClass_ = 0;
+  uint64_t heldSinceUs_ = 0;
+  uint32_t nextTicket_[kIoClassCount] = {};
+  uint32_t serving_[kIoClassCount] = {};
+  IoStats stats_;
+};
+
+// Storage decorator putting every call of the backend behind an IoGate.
+class ScheduledStorage : public Storage {
+ public:
+  static constexpr size_t kBulkSliceBytes = 16 * 1024;
+
+  ScheduledStorage(Storage &backend, IoGate &gate) : backend_(backend), gate_(gate) {}
+
+  bool begin() override;
+  bool exists(const char *path) override;
+  bool mkdir(const char *path) override;
+  bool remove(const char *path) override;
+  bool rename(const char *from, const char *to) override;
+  std::unique_ptr<File> open(const char *path, OpenMode mode) override;
+  std::unique_ptr<File> openFor(const char *path, OpenMode mode, IoClass cls) override;
+  bool listDir(const char *path, const std::function<bool(const DirEntry &)> &fn) override;
+  uint64_t totalBytes() override;
+  uint64_t usedBytes() override;
+
+ private:
+  Storage &backend_;
+  IoGate &gate_;
+};
+
+// Queue depth and wait times of storage().
+IoStats ioStats();
+
+}  // namespace hal
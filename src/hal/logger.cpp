@@ -0,0 +1,242 @@
+#include "logger.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <mutex>
+
+#include "hal.h"
+
+namespace hal {
+
+namespace {
+
+static_assert((kLogSlots & (kLogSlots - 1)) == 0, "kLogSlots must be a power of two");
+
+constexpr size_t kFileBufferBytes = 2048;  // lines gathered per card write
+constexpr uint32_t kFileFlushMs = 5000;    // quiet time before a partial buffer is written
+constexpr uint32_t kIdleWaitMs = 60000;
+
+struct Slot {
+  std::atomic<uint32_t> seq;
+  LogLevel level;
+  uint32_t ms;
+  uint16_t len;
+  char text[kLogLineBytes];
+};
+
+// Bounded queue after Vyukov: a producer claims a position with a CAS on
+// head_, fills that slot and publishes it by bumping the slot's sequence, so
+// producers never wait on each other or on the consumer. The drain is the
+// only consumer (serialized by gDrainMutex).
+class Ring {
+ public:
+  Ring() {
+    for (uint32_t i = 0; i < kLogSlots; ++i) slots_[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  // Returns nullptr when the ring is full.
+  Slot *claim(uint32_t &pos) {
+    pos = head_.load(std::memory_order_relaxed);
+    for (;;) {
+      Slot &s = slots_[pos & (kLogSlots - 1)];
+      const int32_t diff = static_cast<int32_t>(s.seq.load(std::memory_order_acquire) - pos);
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) return &s;
+      } else if (diff < 0) {
+        return nullptr;
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  void publish(Slot &s, uint32_t pos) { s.seq.store(pos + 1, std::memory_order_release); }
+
+  // Consumer side.
+  Slot *front() {
+    Slot &s = slots_[tail_ & (kLogSlots - 1)];
+    return s.seq.load(std::memory_order_acquire) == tail_ + 1 ? &s : nullptr;
+  }
+
+  void pop() {
+    slots_[tail_ & (kLogSlots - 1)].seq.store(tail_ + kLogSlots, std::memory_order_release);
+    tail_.store(tail_ + 1, std::memory_order_release);
+  }
+
+  // Lines waiting behind and including pos; 0 once the drain passed it.
+  uint32_t depth(uint32_t pos) const {
+    const int32_t d = static_cast<int32_t>(pos + 1 - tail_.load(std::memory_order_acquire));
+    return d > 0 ? static_cast<uint32_t>(d) : 0;
+  }
+
+ private:
+  Slot slots_[kLogSlots];
+  std::atomic<uint32_t> head_{0};
+  std::atomic<uint32_t> tail_{0};
+};
+
+Ring &ring() {
+  static Ring r;
+  return r;
+}
+
+std::atomic<uint32_t> gWritten{0};
+std::atomic<uint32_t> gDropped{0};
+std::atomic<uint32_t> gHighWater{0};
+std::atomic<uint32_t> gFileBytes{0};
+std::atomic<Worker *> gWorker{nullptr};
+std::atomic<bool> gFileEnabled{false};
+std::string gFileDir;  // set before gFileEnabled
+
+// Drain state.
+std::mutex gDrainMutex;
+std::string gFileBuffer;
+uint32_t gDroppedReported = 0;
+
+char levelTag(LogLevel level) {
+  switch (level) {
+    case LogLevel::kError: return 'E';
+    case LogLevel::kWarn: return 'W';
+    case LogLevel::kInfo: return 'I';
+    case LogLevel::kDebug: return 'D';
+  }
+  return '?';
+}
+
+std::string logPath(int generation) {
+  char name[16];
+  if (generation == 0) {
+    snprintf(name, sizeof(name), "/log.txt");
+  } else {
+    snprintf(name, sizeof(name), "/log.%d.txt", generation);
+  }
+  return gFileDir + name;
+}
+
+void rotateFiles() {
+  storage().remove(logPath(kLogFilesKept).c_str());
+  for (int g = kLogFilesKept - 1; g >= 0; --g) storage().rename(logPath(g).c_str(), logPath(g + 1).c_str());
+  gFileBytes.store(0, std::memory_order_relaxed);
+}
+
+// Errors here go straight to the console: logging them would feed the file
+// that just failed.
+void writeFileBuffer() {
+  if (gFileBuffer.empty()) return;
+  const std::string path = logPath(0);
+  std::unique_ptr<File> f = storage().open(path.c_str(), OpenMode::kAppend);
+  if (f && f->size() + gFileBuffer.size() > kLogFileBytes) {
+    f->close();
+    rotateFiles();
+    f = storage().open(path.c_str(), OpenMode::kAppend);
+  }
+  if (!f || f->write(gFileBuffer) != gFileBuffer.size()) {
+    static const char kMsg[] = "log: write to card failed\n";
+    consoleWrite(kMsg, sizeof(kMsg) - 1);
+  }
+  if (f) {
+    gFileBytes.store(static_cast<uint32_t>(f->size()), std::memory_order_relaxed);
+    f->close();
+  }
+  gFileBuffer.clear();
+}
+
+void emit(const char *line, size_t len) {
+  consoleWrite(line, len);
+  if (gFileEnabled.load(std::memory_order_acquire)) gFileBuffer.append(line, len);
+}
+
+// Moves everything in the ring to the console and the file buffer. The file
+// is written when the buffer is full, after an error line, or when
+// flushFile is set (a quiet period or logFlush()).
+void drain(bool flushFile) {
+  std::lock_guard<std::mutex> lock(gDrainMutex);
+  Ring &r = ring();
+  char line[kLogLineBytes + 32];
+  bool urgent = false;
+  while (Slot *s = r.front()) {
+    const int n = snprintf(line, sizeof(line), "%lu.%03lu %c %.*s\n", static_cast<unsigned long>(s->ms / 1000),
+                           static_cast<unsigned long>(s->ms % 1000), levelTag(s->level), s->len, s->text);
+    if (s->level == LogLevel::kError) urgent = true;
+    r.pop();
+    emit(line, n < static_cast<int>(sizeof(line)) ? static_cast<size_t>(n) : sizeof(line) - 1);
+    if (gFileBuffer.size() >= kFileBufferBytes) writeFileBuffer();
+  }
+  const uint32_t dropped = gDropped.load(std::memory_order_relaxed);
+  if (dropped != gDroppedReported) {
+    const int n = snprintf(line, sizeof(line), "log: %lu lines dropped\n",
+                           static_cast<unsigned long>(dropped - gDroppedReported));
+    gDroppedReported = dropped;
+    emit(line, static_cast<size_t>(n));
+  }
+  if (urgent || flushFile) writeFileBuffer();
+}
+
+bool fileBufferPending() {
+  std::lock_guard<std::mutex> lock(gDrainMutex);
+  return !gFileBuffer.empty();
+}
+
+}  // namespace
+
+void logWrite(LogLevel level, const char *fmt, ...) {
+  Ring &r = ring();
+  uint32_t pos = 0;
+  Slot *s = r.claim(pos);
+  if (!s) {
+    gDropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  s->level = level;
+  s->ms = static_cast<uint32_t>(clock().nowMs());
+  va_list args;
+  va_start(args, fmt);
+  const int n = vsnprintf(s->text, sizeof(s->text), fmt, args);
+  va_end(args);
+  size_t len = n < 0 ? 0 : (static_cast<size_t>(n) < sizeof(s->text) ? static_cast<size_t>(n) : sizeof(s->text) - 1);
+  while (len > 0 && s->text[len - 1] == '\n') --len;
+  s->len = static_cast<uint16_t>(len);
+  r.publish(*s, pos);
+
+  gWritten.fetch_add(1, std::memory_order_relaxed);
+  const uint32_t depth = r.depth(pos);
+  uint32_t high = gHighWater.load(std::memory_order_relaxed);
+  while (depth > high && !gHighWater.compare_exchange_weak(high, depth, std::memory_order_relaxed)) {
+  }
+  if (Worker *w = gWorker.load(std::memory_order_acquire)) w->wake();
+}
+
+void logBegin() {
+  if (gWorker.load(std::memory_order_acquire)) return;
+  Worker &w = startWorker("log", [](Worker &self) {
+    bool quiet = false;
+    for (;;) {
+      drain(quiet);
+      // A partial file buffer goes out after kFileFlushMs without new lines.
+      quiet = !self.waitForWork(fileBufferPending() ? kFileFlushMs : kIdleWaitMs);
+    }
+  });
+  gWorker.store(&w, std::memory_order_release);
+  w.wake();
+}
+
+void logToFile(const std::string &dir) {
+  if (gFileEnabled.load(std::memory_order_acquire)) return;
+  gFileDir = dir;
+  gFileEnabled.store(true, std::memory_order_release);
+}
+
+void logFlush() { drain(true); }
+
+LogStats logStats() {
+  LogStats s;
+  s.written = gWritten.load(std::memory_order_relaxed);
+  s.dropped = gDropped.load(std::memory_order_relaxed);
+  s.highWater = gHighWater.load(std::memory_order_relaxed);
+  s.fileBytes = gFileBytes.load(std::memory_order_relaxed);
+  return s;
+}
+
+}  // namespace hal
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Leveled logging that never blocks the caller. logWrite() formats into a
+// fixed ring of lines (lock-free, any task may log) and returns; a
+// low-priority worker drains the ring to the console and, once logToFile()
+// is called, to a rotating file on the card. When the ring is full the line
+// is dropped and counted instead of waiting for the UART.
+//
+// Levels above LOG_LEVEL (a build flag, default INFO) compile to nothing,
+// arguments included.
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+namespace hal {
+
+enum class LogLevel : uint8_t {
+  kError = LOG_LEVEL_ERROR,
+  kWarn = LOG_LEVEL_WARN,
+  kInfo = LOG_LEVEL_INFO,
+  kDebug = LOG_LEVEL_DEBUG,
+};
+
+struct LogStats {
+  uint32_t written = 0;    // lines taken into the ring
+  uint32_t dropped = 0;    // lines lost to a full ring
+  uint32_t highWater = 0;  // most lines waiting at once
+  uint32_t fileBytes = 0;  // size of the current log file
+};
+
+// Lines longer than this are cut (the trailing newline is optional).
+constexpr size_t kLogLineBytes = 120;
+constexpr size_t kLogSlots = 64;  // power of two
+// The log file rolls over to log.1.txt .. log.N.txt at this size.
+constexpr uint32_t kLogFileBytes = 256 * 1024;
+constexpr int kLogFilesKept = 3;
+
+void logWrite(LogLevel level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+// Starts the drain worker. Lines logged earlier wait in the ring.
+void logBegin();
+
+// Also appends the log to <dir>/log.txt. Call once, after the card is mounted.
+void logToFile(const std::string &dir);
+
+// Drains the ring to the console and the file in the calling task, blocking
+// on the UART and the card. For shutdown paths.
+void logFlush();
+
+LogStats logStats();
+
+}  // namespace hal
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) ::hal::logWrite(::hal::LogLevel::kError, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) ((void)0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) ::hal::logWrite(::hal::LogLevel::kWarn, __VA_ARGS__)
+#else
+#define LOG_WARN(...) ((void)0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) ::hal::logWrite(::hal::LogLevel::kInfo, __VA_ARGS__)
+#else
+#define LOG_INFO(...) ((void)0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) ::hal::logWrite(::hal::LogLevel::kDebug, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) ((void)0)
+#endif
@@ -0,0 +1,100 @@
+#include <dirent.h>
+#include <string.h>
+#include <strings.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "../hal.h"
+#include "../logger.h"
+#include "sim.h"
+
+namespace {
+
+// Replays a folder of JPEGs in name order, looping forever. Without a folder
+// it emits a placeholder JPEG stream (SOI, padding comments, EOI) of the
+// configured size, which is enough for storage and HTTP measurements.
+class FolderCamera : public hal::Camera {
+ public:
+  bool begin() override {
+    if (!scanned_) scan();
+    ready_ = true;
+    return true;
+  }
+
+  bool ready() const override { return ready_; }
+
+  bool capture(hal::Frame &out) override {
+    if (!ready_) return false;
+    if (files_.empty()) {
+      buildPlaceholder();
+    } else {
+      const std::string &path = files_[next_++ % files_.size()];
+      std::ifstream in(path, std::ios::binary);
+      if (!in) return false;
+      buffer_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    out.data = reinterpret_cast<const uint8_t *>(buffer_.data());
+    out.len = buffer_.size();
+    out.handle = nullptr;
+    return true;
+  }
+
+  void release(hal::Frame &frame) override { frame = hal::Frame(); }
+  void powerDown() override { ready_ = false; }
+
+ private:
+  void scan() {
+    scanned_ = true;
+    const std::string &dirPath = simOptions().framesDir;
+    if (dirPath.empty()) return;
+    DIR *dir = opendir(dirPath.c_str());
+    if (!dir) {
+      LOG_WARN("Frames dir %s not readable; using placeholder frames", dirPath.c_str());
+      return;
+    }
+    while (struct dirent *de = readdir(dir)) {
+      const char *dot = strrchr(de->d_name, '.');
+      if (dot && (strcasecmp(dot, ".jpg") == 0 || strcasecmp(dot, ".jpeg") == 0)) {
+        files_.push_back(dirPath + "/" + de->d_name);
+      }
+    }
+    closedir(dir);
+    std::sort(files_.begin(), files_.end());
+    LOG_INFO("Camera replays %u JPEGs from %s", static_cast<unsigned>(files_.size()), dirPath.c_str());
+  }
+
+  void buildPlaceholder() {
+    const size_t target = std::max<size_t>(simOptions().placeholderFrameBytes, 16);
+    if (buffer_.size() == target) return;
+    buffer_.clear();
+    buffer_.reserve(target);
+    buffer_ += "\xFF\xD8";  // SOI
+    while (buffer_.size() + 4 + 2 < target) {
+      size_t payload = std::min<size_t>(target - buffer_.size() - 4 - 2, 65533);
+      buffer_ += "\xFF\xFE";  // COM
+      buffer_ += static_cast<char>(((payload + 2) >> 8) & 0xFF);
+      buffer_ += static_cast<char>((payload + 2) & 0xFF);
+      buffer_.append(payload, 'x');
+    }
+    buffer_ += "\xFF\xD9";  // EOI
+  }
+
+  std::vector<std::string> files_;
+  std::string buffer_;
+  size_t next_ = 0;
+  bool scanned_ = false;
+  bool ready_ = false;
+};
+
+FolderCamera gCamera;
+
+}  // namespace
+
+namespace hal {
+
+Camera &camera() { return gCamera; }
+
+}  // namespace hal
@@ -0,0 +1,35 @@
+#include "../async_http.h"
+#include "sim.h"
+
+namespace {
+
+// The shared socket server, on the port given with --port. Under
+// --virtual-clock nothing can connect in simulated time, so waiting just
+// advances the clock.
+class SimHttpServer : public hal::AsyncHttpServer {
+ public:
+  SimHttpServer() : AsyncHttpServer(8080) {}
+
+  void begin() override {
+    port_ = simOptions().httpPort;
+    AsyncHttpServer::begin();
+  }
+
+  bool waitForActivity(uint32_t timeoutMs) override {
+    if (simOptions().virtualClock) {
+      hal::clock().sleepMs(timeoutMs);
+      return false;
+    }
+    return AsyncHttpServer::waitForActivity(timeoutMs);
+  }
+};
+
+SimHttpServer gHttp;
+
+}  // namespace
+
+namespace hal {
+
+HttpServer &http() { return gHttp; }
+
+}  // namespace hal
@@ -0,0 +1,217 @@
+#include <malloc.h>
+#include <math.h>
+#include <stdio.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../hal.h"
+#include "../logger.h"
+#include "sim.h"
+
+namespace {
+
+class SteadyClock : public hal::Clock {
+ public:
+  SteadyClock() : start_(std::chrono::steady_clock::now()) {}
+
+  uint64_t nowUs() override {
+    auto d = std::chrono::steady_clock::now() - start_;
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+  }
+
+  void sleepMs(uint32_t ms) override { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+ private:
+  std::chrono::steady_clock::time_point start_;
+};
+
+// Replays a script of readings, or a slow synthetic day/night curve when no
+// script is given.
+class ScriptedDht : public hal::DhtSensor {
+ public:
+  bool read(int &temperatureC, int &humidity) override {
+    if (!loaded_) load();
+    const uint32_t n = reads_++;
+    if (script_.empty()) {
+      temperatureC = static_cast<int>(lround(22.0 + 4.0 * sin(n / 120.0)));
+      humidity = static_cast<int>(lround(55.0 + 10.0 * cos(n / 90.0)));
+      return true;
+    }
+    const Sample &s = script_[n % script_.size()];
+    if (s.fail) return false;
+    temperatureC = s.temp;
+    humidity = s.hum;
+    return true;
+  }
+
+ private:
+  struct Sample {
+    int temp = 0;
+    int hum = 0;
+    bool fail = false;
+  };
+
+  void load() {
+    loaded_ = true;
+    const std::string &path = simOptions().sensorScript;
+    if (path.empty()) return;
+    std::ifstream in(path);
+    if (!in) {
+      LOG_WARN("Sensor script %s not readable; using synthetic curve", path.c_str());
+      return;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+      if (line.empty() || line[0] == '#') continue;
+      Sample s;
+      if (line.compare(0, 4, "fail") == 0) {
+        s.fail = true;
+      } else if (sscanf(line.c_str(), "%d,%d", &s.temp, &s.hum) != 2) {
+        continue;
+      }
+      script_.push_back(s);
+    }
+    LOG_INFO("Loaded %u scripted sensor samples", static_cast<unsigned>(script_.size()));
+  }
+
+  std::vector<Sample> script_;
+  uint32_t reads_ = 0;
+  bool loaded_ = false;
+};
+
+// key=value file next to the simulated card, standing in for NVS.
+class FileSettings : public hal::Settings {
+ public:
+  std::string getString(const char *key, const char *def) override {
+    load();
+    auto it = values_.find(key);
+    return it == values_.end() ? std::string(def) : it->second;
+  }
+
+  uint32_t getULong(const char *key, uint32_t def) override {
+    load();
+    auto it = values_.find(key);
+    return it == values_.end() ? def : static_cast<uint32_t>(strtoul(it->second.c_str(), nullptr, 10));
+  }
+
+  void putString(const char *key, const std::string &value) override {
+    load();
+    values_[key] = value;
+    save();
+  }
+
+  void putULong(const char *key, uint32_t value) override { putString(key, std::to_string(value)); }
+
+ private:
+  std::string path() const { return simOptions().sdRoot + "/.prefs"; }
+
+  void load() {
+    if (loaded_) return;
+    loaded_ = true;
+    std::ifstream in(path());
+    std::string line;
+    while (std::getline(in, line)) {
+      size_t eq = line.find('=');
+      if (eq != std::string::npos) values_[line.substr(0, eq)] = line.substr(eq + 1);
+    }
+  }
+
+  void save() {
+    std::ofstream out(path(), std::ios::trunc);
+    for (const auto &kv : values_) out << kv.first << '=' << kv.second << '\n';
+  }
+
+  std::map<std::string, std::string> values_;
+  bool loaded_ = false;
+};
+
+// Fast-forward clock for the simulator: sleeping advances time instantly, so
+// days of capture cycles run in seconds.
+class VirtualClock : public hal::Clock {
+ public:
+  uint64_t nowUs() override { return nowUs_; }
+  void sleepMs(uint32_t ms) override { nowUs_ += static_cast<uint64_t>(ms) * 1000ULL; }
+
+ private:
+  uint64_t nowUs_ = 0;
+};
+
+class ThreadWorker : public hal::Worker {
+ public:
+  void wake() override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    woken_ = true;
+    cv_.notify_one();
+  }
+  bool waitForWork(uint32_t timeoutMs) override {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return woken_; });
+    const bool woken = woken_;
+    woken_ = false;
+    return woken;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool woken_ = false;
+};
+
+SteadyClock gSteadyClock;
+VirtualClock gVirtualClock;
+ScriptedDht gDht;
+FileSettings gSettings;
+SimOptions gOptions;
+
+}  // namespace
+
+SimOptions &simOptions() { return gOptions; }
+
+namespace hal {
+
+Clock &clock() {
+  if (simOptions().virtualClock) return gVirtualClock;
+  return gSteadyClock;
+}
+DhtSensor &dht() { return gDht; }
+Settings &settings() { return gSettings; }
+
+// glibc keeps no low-water mark and does not report its largest free chunk;
+// minFreeBytes is the lowest value seen by callers and the largest block is
+// the top chunk, the one piece of free memory known to be contiguous.
+void heapStats(HeapRegion &internal, HeapRegion &psram) {
+  static uint32_t minFree = UINT32_MAX;
+  const struct mallinfo2 mi = mallinfo2();
+  internal.present = true;
+  internal.totalBytes = static_cast<uint32_t>(mi.arena + mi.hblkhd);
+  internal.freeBytes = static_cast<uint32_t>(mi.fordblks);
+  internal.largestFreeBlock = static_cast<uint32_t>(mi.keepcost);
+  if (internal.freeBytes < minFree) minFree = internal.freeBytes;
+  internal.minFreeBytes = minFree;
+  psram = HeapRegion();
+}
+
+void consoleWrite(const char *data, size_t len) {
+  fwrite(data, 1, len, stdout);
+  fflush(stdout);
+}
+
+Worker &startWorker(const char *, std::function<void(Worker &)> body) {
+  ThreadWorker *w = new ThreadWorker();
+  std::thread([w, body] { body(*w); }).detach();
+  return *w;
+}
+
+// The address of a thread_local is unique to each live thread.
+TaskId currentTaskId() {
+  static thread_local char tag;
+  return reinterpret_cast<TaskId>(&tag);
+}
+
+}  // namespace hal
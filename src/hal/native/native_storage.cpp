@@ -0,0 +1,160 @@
+#include <dirent.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../hal.h"
+#include "../logger.h"
+#include "sim.h"
+
+namespace {
+
+// Makes the host directory behave like a slow card (--sd-latency).
+void cardDelay(size_t bytes) {
+  const SimOptions &opts = simOptions();
+  if (opts.virtualClock || (opts.sdOpUs == 0 && opts.sdUsPerKb == 0)) return;
+  const uint64_t us = opts.sdOpUs + static_cast<uint64_t>(opts.sdUsPerKb) * bytes / 1024;
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+class StdioFile : public hal::File {
+ public:
+  explicit StdioFile(FILE *f) : f_(f) {}
+  ~StdioFile() override { close(); }
+
+  size_t read(uint8_t *buf, size_t len) override {
+    const size_t n = f_ ? fread(buf, 1, len, f_) : 0;
+    cardDelay(n);
+    return n;
+  }
+
+  size_t write(const uint8_t *buf, size_t len) override {
+    const size_t n = f_ ? fwrite(buf, 1, len, f_) : 0;
+    cardDelay(n);
+    return n;
+  }
+
+  bool seek(uint64_t pos) override { return f_ && fseeko(f_, static_cast<off_t>(pos), SEEK_SET) == 0; }
+  uint64_t position() override { return f_ ? static_cast<uint64_t>(ftello(f_)) : 0; }
+
+  uint64_t size() override {
+    if (!f_) return 0;
+    fflush(f_);
+    struct stat st;
+    return fstat(fileno(f_), &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+  }
+
+  void close() override {
+    if (f_) fclose(f_);
+    f_ = nullptr;
+  }
+
+ private:
+  FILE *f_;
+};
+
+// Maps card paths ("/data/run_0001/...") onto a host directory.
+class DirectoryStorage : public hal::Storage {
+ public:
+  bool begin() override {
+    const std::string &root = simOptions().sdRoot;
+    ::mkdir(root.c_str(), 0755);
+    struct stat st;
+    if (stat(root.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) return false;
+    LOG_INFO("Simulated card at %s", root.c_str());
+    return true;
+  }
+
+  bool exists(const char *path) override {
+    cardDelay(0);
+    struct stat st;
+    return stat(hostPath(path).c_str(), &st) == 0;
+  }
+
+  bool mkdir(const char *path) override {
+    cardDelay(0);
+    return ::mkdir(hostPath(path).c_str(), 0755) == 0;
+  }
+
+  bool remove(const char *path) override {
+    cardDelay(0);
+    return ::remove(hostPath(path).c_str()) == 0;
+  }
+
+  bool rename(const char *from, const char *to) override {
+    cardDelay(0);
+    return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+  }
+
+  std::unique_ptr<hal::File> open(const char *path, hal::OpenMode mode) override {
+    const char *m = "rb";
+    if (mode == hal::OpenMode::kWrite) m = "wb";
+    if (mode == hal::OpenMode::kAppend) m = "ab";
+    if (mode == hal::OpenMode::kUpdate) m = "r+b";
+    const std::string p = hostPath(path);
+    cardDelay(0);
+    struct stat st;
+    if (mode == hal::OpenMode::kRead && (stat(p.c_str(), &st) != 0 || S_ISDIR(st.st_mode))) return nullptr;
+    FILE *f = fopen(p.c_str(), m);
+    if (!f) return nullptr;
+    return std::unique_ptr<hal::File>(new StdioFile(f));
+  }
+
+  bool listDir(const char *path, const std::function<bool(const hal::DirEntry &)> &fn) override {
+    const std::string dirPath = hostPath(path);
+    DIR *dir = opendir(dirPath.c_str());
+    if (!dir) return false;
+    // readdir order is hash based on most host filesystems; sort so listings
+    // are stable like the FAT directory order on the card.
+    std::vector<hal::DirEntry> entries;
+    while (struct dirent *de = readdir(dir)) {
+      if (de->d_name[0] == '.') continue;
+      hal::DirEntry entry;
+      entry.name = de->d_name;
+      struct stat st;
+      if (stat((dirPath + "/" + entry.name).c_str(), &st) != 0) continue;
+      entry.isDir = S_ISDIR(st.st_mode);
+      entry.size = entry.isDir ? 0 : static_cast<uint64_t>(st.st_size);
+      entries.push_back(entry);
+    }
+    closedir(dir);
+    cardDelay(entries.size() * 32);  // FAT directory entries are 32 bytes
+    std::sort(entries.begin(), entries.end(),
+              [](const hal::DirEntry &a, const hal::DirEntry &b) { return a.name < b.name; });
+    for (const hal::DirEntry &entry : entries) {
+      if (!fn(entry)) break;
+    }
+    return true;
+  }
+
+  uint64_t totalBytes() override {
+    struct statvfs vfs;
+    if (statvfs(simOptions().sdRoot.c_str(), &vfs) != 0) return 0;
+    return static_cast<uint64_t>(vfs.f_blocks) * vfs.f_frsize;
+  }
+
+  uint64_t usedBytes() override {
+    struct statvfs vfs;
+    if (statvfs(simOptions().sdRoot.c_str(), &vfs) != 0) return 0;
+    return static_cast<uint64_t>(vfs.f_blocks - vfs.f_bavail) * vfs.f_frsize;
+  }
+
+ private:
+  static std::string hostPath(const char *path) { return simOptions().sdRoot + (path[0] == '/' ? "" : "/") + path; }
+};
+
+DirectoryStorage gStorage;
+
+}  // namespace
+
+namespace hal {
+
+Storage &cardStorage() { return gStorage; }
+
+}  // namespace hal
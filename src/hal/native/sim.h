@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Options for the Linux simulator backends, filled from the command line in
+// sim_main.cpp before any hal:: accessor is used.
+struct SimOptions {
+  std::string sdRoot = "sim_sd";    // directory standing in for the TF card
+  std::string framesDir;            // folder of JPEGs replayed as the camera
+  std::string sensorScript;         // "tempC,hum" per line, "fail" for a failed read
+  uint16_t httpPort = 8080;
+  size_t placeholderFrameBytes = 200 * 1024;  // used when framesDir is empty
+  bool virtualClock = false;        // time only advances when the app sleeps
+  // Injected card latency: every storage call costs sdOpUs plus sdUsPerKb per
+  // KB moved, slept on the calling thread (not with --virtual-clock).
+  uint32_t sdOpUs = 0;
+  uint32_t sdUsPerKb = 0;
+};
+
+SimOptions &simOptions();
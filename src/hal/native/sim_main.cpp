@@ -0,0 +1,157 @@
+// Linux entry point for the [env:native] simulator: runs the same capture,
+// log and serve loop as the firmware against the hal/native backends.
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../app.h"
+#include "../../sd_utils.h"
+#include "../hal.h"
+#include "../logger.h"
+#include "sim.h"
+
+static volatile sig_atomic_t gStop = 0;
+
+static void onSignal(int) { gStop = 1; }
+
+static void usage(const char *argv0) {
+  printf("Usage: %s [options]\n"
+         "  --sd DIR           directory used as the TF card (default sim_sd)\n"
+         "  --frames DIR       folder of JPEGs replayed as camera frames\n"
+         "  --frame-bytes N    placeholder frame size when --frames is not set\n"
+         "  --sensor FILE      scripted readings, one \"tempC,hum\" or \"fail\" per line\n"
+         "  --port N           HTTP port (default 8080)\n"
+         "  --cycle-ms N       capture cadence, bypasses the device lower bound\n"
+         "  --duration-s N     exit after N seconds (default: run until SIGINT)\n"
+         "  --virtual-clock    fast-forward time while idle (HTTP is not served)\n"
+         "  --sd-latency US[,US_PER_KB]  make every card call sleep like a slow card\n"
+         "  --synthetic-runs N seed /data with N closed runs before starting (load tests)\n"
+         "  --synthetic-frames N  frames and readings per synthetic run (default 100);\n"
+         "                     frames come from --frames or --frame-bytes\n",
+         argv0);
+}
+
+// Fills /data with closed runs of frames and readings so the HTTP routes can
+// be load-tested against a card the size of a long deployment. Runs already
+// on the card are kept, so restarting with the same flags costs nothing.
+static bool seedSyntheticData(uint32_t runs, uint32_t framesPerRun) {
+  if (!initSdCard() || !ensureDir("/data")) return false;
+  hal::Camera &cam = hal::camera();
+  hal::Frame frame;
+  if (!cam.begin() || !cam.capture(frame)) return false;
+  uint32_t created = 0;
+  bool ok = true;
+  for (uint32_t run = 0; run < runs && ok; ++run) {
+    char dir[32];
+    snprintf(dir, sizeof(dir), "/data/run_%04lu", static_cast<unsigned long>(run));
+    if (hal::storage().exists(dir)) continue;
+    ok = ensureDir(dir);
+    std::string csv;
+    for (uint32_t i = 0; i < framesPerRun && ok; ++i) {
+      std::string saved;
+      ok = saveJpegFrame(dir, i, frame.data, frame.len, saved);
+      char line[64];
+      snprintf(line, sizeof(line), "%lu,%lu,%lu,%d,%d\n", static_cast<unsigned long>(run),
+               static_cast<unsigned long>(i), static_cast<unsigned long>(i) * 30000UL, 18 + static_cast<int>(i % 7),
+               40 + static_cast<int>((i * 3) % 25));
+      csv += line;
+    }
+    const std::string csvPath = std::string(dir) + "/readings.csv";
+    std::unique_ptr<hal::File> f = hal::storage().open(csvPath.c_str(), hal::OpenMode::kWrite);
+    ok = ok && f && f->write(csv) == csv.size();
+    if (ok) ++created;
+  }
+  const size_t frameBytes = frame.len;
+  cam.release(frame);
+  cam.powerDown();
+  LOG_INFO("Synthetic data: %lu runs created, %lu frames of %u bytes each", static_cast<unsigned long>(created),
+           static_cast<unsigned long>(framesPerRun), static_cast<unsigned>(frameBytes));
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  SimOptions &opts = simOptions();
+  uint32_t cycleMs = 0;
+  uint32_t durationS = 0;
+  uint32_t syntheticRuns = 0;
+  uint32_t syntheticFrames = 100;
+  for (int i = 1; i < argc; ++i) {
+    const char *a = argv[i];
+    const char *v = (i + 1 < argc) ? argv[i + 1] : nullptr;
+    if (strcmp(a, "--help") == 0 || strcmp(a, "-h") == 0) {
+      usage(argv[0]);
+      return 0;
+    }
+    if (strcmp(a, "--virtual-clock") == 0) {
+      opts.virtualClock = true;
+      continue;
+    }
+    if (!v) {
+      usage(argv[0]);
+      return 2;
+    }
+    if (strcmp(a, "--sd") == 0) {
+      opts.sdRoot = v;
+    } else if (strcmp(a, "--frames") == 0) {
+      opts.framesDir = v;
+    } else if (strcmp(a, "--frame-bytes") == 0) {
+      opts.placeholderFrameBytes = strtoul(v, nullptr, 10);
+    } else if (strcmp(a, "--sensor") == 0) {
+      opts.sensorScript = v;
+    } else if (strcmp(a, "--port") == 0) {
+      opts.httpPort = static_cast<uint16_t>(atoi(v));
+    } else if (strcmp(a, "--cycle-ms") == 0) {
+      cycleMs = static_cast<uint32_t>(strtoul(v, nullptr, 10));
+    } else if (strcmp(a, "--duration-s") == 0) {
+      durationS = static_cast<uint32_t>(strtoul(v, nullptr, 10));
+    } else if (strcmp(a, "--sd-latency") == 0) {
+      char *end = nullptr;
+      opts.sdOpUs = static_cast<uint32_t>(strtoul(v, &end, 10));
+      if (*end == ',') opts.sdUsPerKb = static_cast<uint32_t>(strtoul(end + 1, nullptr, 10));
+    } else if (strcmp(a, "--synthetic-runs") == 0) {
+      syntheticRuns = static_cast<uint32_t>(strtoul(v, nullptr, 10));
+    } else if (strcmp(a, "--synthetic-frames") == 0) {
+      syntheticFrames = static_cast<uint32_t>(strtoul(v, nullptr, 10));
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+    ++i;
+  }
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  signal(SIGPIPE, SIG_IGN);
+
+  hal::logBegin();
+  LOG_INFO("ESP32-S3 CAM + DHT11 logger (native simulator)");
+  loadPrefs();
+  if (cycleMs > 0) appConfig().cycleIntervalMs = cycleMs;
+  if (syntheticRuns > 0 && !seedSyntheticData(syntheticRuns, syntheticFrames)) {
+    LOG_ERROR("Could not seed synthetic data");
+    hal::logFlush();
+    return 1;
+  }
+
+  if (!appSetup()) {
+    hal::logFlush();
+    return 1;
+  }
+  // The simulator's network is the host's: up from the start.
+  const uint64_t netMs = hal::clock().nowMs();
+  wifiLink().start(netMs, true, false);
+  wifiLink().onAttempt(netMs, false);
+  wifiLink().onConnected(netMs);
+  registerHttpHandlers();
+  appFirstCapture();
+  appStartJobs();
+
+  const uint64_t deadlineMs = durationS ? hal::clock().nowMs() + durationS * 1000ULL : 0;
+  while (!gStop && (deadlineMs == 0 || hal::clock().nowMs() < deadlineMs)) {
+    appLoop();
+  }
+  LOG_INFO("Simulator stopped");
+  hal::logFlush();
+  return 0;
+}
@@ -0,0 +1,32 @@
+#include "mem_monitor.h"
+
+#include "hal/logger.h"
+
+void MemoryMonitor::update(Region &r, const hal::HeapRegion &now, bool first) {
+  r.now = now;
+  r.fragmentationPct = now.largestFreeBlock < now.freeBytes
+                           ? static_cast<uint8_t>(100 - static_cast<uint64_t>(now.largestFreeBlock) * 100 / now.freeBytes)
+                           : 0;
+  if (first || now.largestFreeBlock < r.minLargestFreeBlock) r.minLargestFreeBlock = now.largestFreeBlock;
+  if (r.fragmentationPct > r.maxFragmentationPct) r.maxFragmentationPct = r.fragmentationPct;
+}
+
+void MemoryMonitor::sample(uint64_t nowMs) {
+  hal::HeapRegion internal;
+  hal::HeapRegion psram;
+  hal::heapStats(internal, psram);
+  update(internal_, internal, !sampled_);
+  update(psram_, psram, !sampled_);
+  sampled_ = true;
+  if (nowMs < nextPointMs_) return;
+  nextPointMs_ = nowMs + kHistoryIntervalMs;
+
+  history_[next_] = Point{static_cast<uint32_t>(nowMs / 1000ULL), internal.freeBytes, internal.largestFreeBlock,
+                          psram.freeBytes, psram.largestFreeBlock};
+  next_ = (next_ + 1) % kHistory;
+  if (count_ < kHistory) ++count_;
+  LOG_INFO("Heap: internal free %lu largest %lu min %lu (%u%% frag); psram free %lu largest %lu",
+           static_cast<unsigned long>(internal.freeBytes), static_cast<unsigned long>(internal.largestFreeBlock),
+           static_cast<unsigned long>(internal.minFreeBytes), internal_.fragmentationPct,
+           static_cast<unsigned long>(psram.freeBytes), static_cast<unsigned long>(psram.largestFreeBlock));
+}
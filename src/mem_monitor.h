@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "hal/hal.h"
+
+// Heap telemetry for long-run checks. sample() reads both heaps (cheap; run
+// it every minute or so), tracks the worst values seen and keeps a day of
+// half-hourly points, so GET /stats/memory shows whether free memory and the
+// largest free block stay flat over weeks. Each history point is also
+// logged, which puts the trend into the card log.
+class MemoryMonitor {
+ public:
+  static constexpr size_t kHistory = 48;
+  static constexpr uint32_t kHistoryIntervalMs = 30UL * 60UL * 1000UL;
+
+  struct Region {
+    hal::HeapRegion now;
+    uint32_t minLargestFreeBlock = 0;  // over all samples
+    uint8_t fragmentationPct = 0;      // 100 * (1 - largest / free)
+    uint8_t maxFragmentationPct = 0;
+  };
+
+  struct Point {
+    uint32_t sec;
+    uint32_t internalFree;
+    uint32_t internalLargest;
+    uint32_t psramFree;
+    uint32_t psramLargest;
+  };
+
+  void sample(uint64_t nowMs);
+
+  const Region &internal() const { return internal_; }
+  const Region &psram() const { return psram_; }
+  size_t historySize() const { return count_; }
+  // i = 0 is the oldest point.
+  const Point &history(size_t i) const { return history_[(next_ + kHistory - count_ + i) % kHistory]; }
+
+ private:
+  static void update(Region &r, const hal::HeapRegion &now, bool first);
+
+  Region internal_;
+  Region psram_;
+  Point history_[kHistory] = {};
+  size_t next_ = 0;
+  size_t count_ = 0;
+  uint64_t nextPointMs_ = 0;
+  bool sampled_ = false;
+};
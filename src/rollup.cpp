@@ -0,0 +1,157 @@
+#include "rollup.h"
+
+#include "hal/hal.h"
+#include "hal/logger.h"
+
+const uint32_t Rollups::kTierWidthSec[Rollups::kTierCount] = {60, 3600, 86400};
+const char *const Rollups::kTierName[Rollups::kTierCount] = {"minute", "hour", "day"};
+
+void RollupRecord::add(int temp, int hum) {
+  if (count == 0) {
+    tempMin = tempMax = static_cast<int16_t>(temp);
+    humMin = humMax = static_cast<int16_t>(hum);
+  } else {
+    if (temp < tempMin) tempMin = static_cast<int16_t>(temp);
+    if (temp > tempMax) tempMax = static_cast<int16_t>(temp);
+    if (hum < humMin) humMin = static_cast<int16_t>(hum);
+    if (hum > humMax) humMax = static_cast<int16_t>(hum);
+  }
+  if (count < UINT16_MAX) ++count;
+  tempSum += temp;
+  humSum += hum;
+}
+
+void RollupRecord::merge(const RollupRecord &other) {
+  if (other.count == 0) return;
+  if (count == 0) {
+    const uint32_t start = startSec;
+    *this = other;
+    startSec = start;
+    return;
+  }
+  if (other.tempMin < tempMin) tempMin = other.tempMin;
+  if (other.tempMax > tempMax) tempMax = other.tempMax;
+  if (other.humMin < humMin) humMin = other.humMin;
+  if (other.humMax > humMax) humMax = other.humMax;
+  const uint32_t total = static_cast<uint32_t>(count) + other.count;
+  count = static_cast<uint16_t>(total > UINT16_MAX ? UINT16_MAX : total);
+  tempSum += other.tempSum;
+  humSum += other.humSum;
+}
+
+std::string Rollups::tierPath(const std::string &runDir, size_t tier) {
+  return runDir + "/rollup/" + std::to_string(kTierWidthSec[tier]) + ".bin";
+}
+
+bool Rollups::begin(const std::string &runDir) {
+  runDir_ = runDir;
+  for (size_t i = 0; i < kTierCount; ++i) {
+    hasOpen_[i] = false;
+    openPos_[i] = 0;
+  }
+  const std::string dir = runDir + "/rollup";
+  hal::Storage &sd = hal::storage();
+  return sd.exists(dir.c_str()) || sd.mkdir(dir.c_str());
+}
+
+void Rollups::store(size_t tier) {
+  const std::string path = tierPath(runDir_, tier);
+  hal::Storage &sd = hal::storage();
+  std::unique_ptr<hal::File> f = sd.open(path.c_str(), hal::OpenMode::kUpdate);
+  if (!f) f = sd.open(path.c_str(), hal::OpenMode::kAppend);  // first record
+  const RollupRecord &rec = open_[tier];
+  if (!f || !f->seek(openPos_[tier]) ||
+      f->write(reinterpret_cast<const uint8_t *>(&rec), sizeof(rec)) != sizeof(rec)) {
+    LOG_ERROR("Rollup: failed to write %s", path.c_str());
+  }
+  if (f) f->close();
+}
+
+void Rollups::add(uint32_t tSec, int temp, int hum) {
+  for (size_t i = 0; i < kTierCount; ++i) {
+    const uint32_t start = tSec - (tSec % kTierWidthSec[i]);
+    RollupRecord &rec = open_[i];
+    if (hasOpen_[i] && rec.startSec != start) {
+      openPos_[i] += sizeof(RollupRecord);  // the closed bucket is on the card already
+      hasOpen_[i] = false;
+    }
+    if (!hasOpen_[i]) {
+      rec = RollupRecord();
+      rec.startSec = start;
+      hasOpen_[i] = true;
+    }
+    rec.add(temp, hum);
+    store(i);
+  }
+}
+
+size_t Rollups::pickTier(uint32_t stepSec) {
+  size_t tier = 0;
+  for (size_t i = 0; i < kTierCount; ++i) {
+    if (kTierWidthSec[i] <= stepSec) tier = i;
+  }
+  return tier;
+}
+
+bool Rollups::query(const std::string &runDir, size_t tier, uint32_t fromSec, uint32_t toSec, uint32_t stepSec,
+                    const std::function<void(const RollupRecord &)> &emit) {
+  if (tier >= kTierCount || toSec <= fromSec) return true;
+  const uint32_t width = kTierWidthSec[tier];
+  if (stepSec < width) stepSec = width;
+  const uint32_t firstStart = fromSec - (fromSec % width);
+
+  RollupRecord group;
+  bool hasGroup = false;
+  auto feed = [&](const RollupRecord &rec) {
+    const uint32_t groupStart = rec.startSec - (rec.startSec % stepSec);
+    if (hasGroup && group.startSec != groupStart) {
+      emit(group);
+      hasGroup = false;
+    }
+    if (!hasGroup) {
+      group = RollupRecord();
+      group.startSec = groupStart;
+      hasGroup = true;
+    }
+    group.merge(rec);
+  };
+
+  const std::string path = tierPath(runDir, tier);
+  std::unique_ptr<hal::File> f = hal::storage().open(path.c_str(), hal::OpenMode::kRead);
+  if (f) {
+    // Records are appended in time order: binary search for the first one
+    // at or after firstStart, then read sequentially.
+    const uint64_t n = f->size() / sizeof(RollupRecord);
+    uint64_t lo = 0;
+    uint64_t hi = n;
+    RollupRecord rec;
+    while (lo < hi) {
+      const uint64_t mid = lo + (hi - lo) / 2;
+      f->seek(mid * sizeof(RollupRecord));
+      if (f->read(reinterpret_cast<uint8_t *>(&rec), sizeof(rec)) != sizeof(rec)) break;
+      if (rec.startSec < firstStart) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    f->seek(lo * sizeof(RollupRecord));
+    RollupRecord batch[16];
+    bool done = false;
+    while (!done) {
+      const size_t got = f->read(reinterpret_cast<uint8_t *>(batch), sizeof(batch)) / sizeof(RollupRecord);
+      if (got == 0) break;
+      for (size_t i = 0; i < got; ++i) {
+        if (batch[i].startSec >= toSec) {
+          done = true;
+          break;
+        }
+        feed(batch[i]);
+      }
+    }
+    f->close();
+  }
+
+  if (hasGroup) emit(group);
+  return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// Multi-resolution aggregates of the sensor log. Every reading updates the
+// open minute, hour and day bucket (O(1)) and writes it through to
+// <runDir>/rollup/<width>.bin as a fixed-size record: over the previous copy
+// of the same bucket, or appended when the reading starts a new one. The
+// files are therefore complete up to the last reading even after a reset.
+// Range queries binary-search them, so their cost depends on the number of
+// points returned, not on how many raw readings were logged.
+//
+// Timestamps are seconds on the same clock as the ms column in readings.csv
+// (time since boot of the run).
+
+struct RollupRecord {
+  uint32_t startSec = 0;
+  uint16_t count = 0;
+  uint16_t reserved = 0;
+  int16_t tempMin = 0;
+  int16_t tempMax = 0;
+  int16_t humMin = 0;
+  int16_t humMax = 0;
+  int32_t tempSum = 0;
+  int32_t humSum = 0;
+
+  void add(int temp, int hum);
+  void merge(const RollupRecord &other);
+};
+static_assert(sizeof(RollupRecord) == 24, "RollupRecord is stored raw on the card");
+
+class Rollups {
+ public:
+  static constexpr size_t kTierCount = 3;
+  static const uint32_t kTierWidthSec[kTierCount];
+  static const char *const kTierName[kTierCount];
+
+  // Starts a new set of tiers under runDir/rollup (created if missing).
+  bool begin(const std::string &runDir);
+
+  void add(uint32_t tSec, int temp, int hum);
+
+  // Coarsest tier whose bucket width is <= stepSec (minute tier at least).
+  static size_t pickTier(uint32_t stepSec);
+
+  // Emits records covering [fromSec, toSec) from the given tier, merged into
+  // groups of stepSec (rounded up to the tier width).
+  bool query(const std::string &runDir, size_t tier, uint32_t fromSec, uint32_t toSec, uint32_t stepSec,
+             const std::function<void(const RollupRecord &)> &emit);
+
+ private:
+  static std::string tierPath(const std::string &runDir, size_t tier);
+  void store(size_t tier);
+
+  std::string runDir_;
+  RollupRecord open_[kTierCount];
+  bool hasOpen_[kTierCount] = {false, false, false};
+  uint64_t openPos_[kTierCount] = {0, 0, 0};  // file offset of the open record
+};
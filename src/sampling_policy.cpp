@@ -0,0 +1,132 @@
+#include "sampling_policy.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+const char *const SamplingPolicy::kReasonName[5] = {"start", "rate", "step", "band", "backoff"};
+
+namespace {
+
+bool nameIs(const char *spec, size_t len, const char *name) { return strlen(name) == len && strncmp(spec, name, len) == 0; }
+
+float perMinute(int delta, uint64_t spanMs) {
+  const uint64_t span = spanMs > SamplingPolicy::kMinRateSpanMs ? spanMs : SamplingPolicy::kMinRateSpanMs;
+  return static_cast<float>(delta) * 60000.0f / static_cast<float>(span);
+}
+
+}  // namespace
+
+bool SamplingPolicy::Limits::parse(const char *spec) {
+  Limits l = *this;
+  while (*spec) {
+    const char *eq = strchr(spec, '=');
+    if (!eq) return false;
+    const size_t nameLen = static_cast<size_t>(eq - spec);
+    char *end = nullptr;
+    const float value = strtof(eq + 1, &end);
+    if (end == eq + 1 || (*end && *end != ',')) return false;
+    // Everything but the bands is a non-negative amount. Rates must be above
+    // 0 and steps and calm count from 1: a 0 limit would trip on every reading.
+    const bool band = nameIs(spec, nameLen, "t_lo") || nameIs(spec, nameLen, "t_hi") ||
+                      nameIs(spec, nameLen, "h_lo") || nameIs(spec, nameLen, "h_hi");
+    const bool rate = nameIs(spec, nameLen, "dt") || nameIs(spec, nameLen, "dh");
+    const bool fromOne =
+        nameIs(spec, nameLen, "t_step") || nameIs(spec, nameLen, "h_step") || nameIs(spec, nameLen, "calm");
+    if (!band && value < (fromOne ? 1 : 0)) return false;
+    if (rate && value <= 0) return false;
+    if (nameIs(spec, nameLen, "dt")) l.tempRate = value;
+    else if (nameIs(spec, nameLen, "dh")) l.humRate = value;
+    else if (nameIs(spec, nameLen, "t_step")) l.tempStep = static_cast<int>(value);
+    else if (nameIs(spec, nameLen, "h_step")) l.humStep = static_cast<int>(value);
+    else if (nameIs(spec, nameLen, "t_lo")) l.tempLow = static_cast<int>(value);
+    else if (nameIs(spec, nameLen, "t_hi")) l.tempHigh = static_cast<int>(value);
+    else if (nameIs(spec, nameLen, "h_lo")) l.humLow = static_cast<int>(value);
+    else if (nameIs(spec, nameLen, "h_hi")) l.humHigh = static_cast<int>(value);
+    else if (nameIs(spec, nameLen, "fast_ms")) l.fastMs = static_cast<uint32_t>(value);
+    else if (nameIs(spec, nameLen, "slow_ms")) l.slowMs = static_cast<uint32_t>(value);
+    else if (nameIs(spec, nameLen, "calm")) l.calm = static_cast<uint32_t>(value);
+    spec = *end ? end + 1 : end;
+  }
+  *this = l;
+  return true;
+}
+
+std::string SamplingPolicy::Limits::format() const {
+  char buf[160];
+  snprintf(buf, sizeof(buf), "dt=%g,dh=%g,t_step=%d,h_step=%d,t_lo=%d,t_hi=%d,h_lo=%d,h_hi=%d,fast_ms=%lu,slow_ms=%lu,calm=%lu",
+           tempRate, humRate, tempStep, humStep, tempLow, tempHigh, humLow, humHigh, static_cast<unsigned long>(fastMs),
+           static_cast<unsigned long>(slowMs), static_cast<unsigned long>(calm));
+  return buf;
+}
+
+uint32_t SamplingPolicy::clampMs(uint32_t ms) const {
+  if (ms < floorMs_) return floorMs_;
+  if (ms > ceilMs_) return ceilMs_;
+  return ms;
+}
+
+uint32_t SamplingPolicy::fastMs() const { return clampMs(limits_.fastMs ? limits_.fastMs : floorMs_); }
+
+uint32_t SamplingPolicy::slowMs() const {
+  const uint32_t slow = clampMs(limits_.slowMs ? limits_.slowMs : ceilMs_);
+  return slow > fastMs() ? slow : fastMs();
+}
+
+void SamplingPolicy::reset(uint32_t baseMs, const Limits &limits) {
+  limits_ = limits;
+  stats_ = Stats();
+  const uint32_t base = clampMs(baseMs);
+  stats_.periodMs = base < fastMs() ? fastMs() : (base > slowMs() ? slowMs() : base);
+  count_ = 0;
+  next_ = 0;
+  quiet_ = 0;
+}
+
+uint32_t SamplingPolicy::update(uint64_t nowMs, int temp, int hum) {
+  ++stats_.readings;
+
+  // Reference: the oldest reading still inside the rate window, else the
+  // newest one (a cycle longer than the window).
+  const Sample *ref = nullptr;
+  for (size_t i = 1; i <= count_; ++i) {
+    const Sample &s = history_[(next_ + kHistory - i) % kHistory];
+    if (ref && nowMs - s.ms > kRateWindowMs) break;
+    ref = &s;
+  }
+  stats_.tempRate = ref ? perMinute(temp - ref->temp, nowMs - ref->ms) : 0;
+  stats_.humRate = ref ? perMinute(hum - ref->hum, nowMs - ref->ms) : 0;
+  const size_t back = count_ < SampleSmoother::kWindow ? count_ : SampleSmoother::kWindow;
+  const Sample *stepRef = back ? &history_[(next_ + kHistory - back) % kHistory] : nullptr;
+  const int dTemp = stepRef ? temp - stepRef->temp : 0;
+  const int dHum = stepRef ? hum - stepRef->hum : 0;
+  history_[next_] = Sample{nowMs, temp, hum};
+  next_ = (next_ + 1) % kHistory;
+  if (count_ < kHistory) ++count_;
+
+  const bool rate = std::fabs(stats_.tempRate) > limits_.tempRate || std::fabs(stats_.humRate) > limits_.humRate;
+  const bool step = std::abs(dTemp) >= limits_.tempStep || std::abs(dHum) >= limits_.humStep;
+  const bool band = temp < limits_.tempLow || temp > limits_.tempHigh || hum < limits_.humLow || hum > limits_.humHigh;
+  if (rate) ++stats_.rateTriggers;
+  if (step) ++stats_.stepTriggers;
+  if (band) ++stats_.bandTriggers;
+
+  if (rate || step || band) {
+    quiet_ = 0;
+    if (stats_.periodMs > fastMs()) {
+      stats_.periodMs = fastMs();
+      stats_.reason = rate ? kRate : (step ? kStep : kBand);
+      ++stats_.speedUps;
+    }
+  } else if (++quiet_ >= limits_.calm) {
+    quiet_ = 0;
+    if (stats_.periodMs < slowMs()) {
+      const uint64_t doubled = static_cast<uint64_t>(stats_.periodMs) * 2;
+      stats_.periodMs = doubled < slowMs() ? static_cast<uint32_t>(doubled) : slowMs();
+      stats_.reason = kBackoff;
+      ++stats_.backoffs;
+    }
+  }
+  return stats_.periodMs;
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Moving average over the last kWindow DHT11 readings; what readings.csv and
+// the sampling policy see.
+struct SampleSmoother {
+  static constexpr size_t kWindow = 4;
+  int temps[kWindow] = {0};
+  int hums[kWindow] = {0};
+  size_t count = 0;
+  size_t idx = 0;
+
+  void add(int t, int h) {
+    temps[idx] = t;
+    hums[idx] = h;
+    idx = (idx + 1) % kWindow;
+    if (count < kWindow) ++count;
+  }
+
+  int avgTemp() const {
+    if (count == 0) return 0;
+    int sum = 0;
+    for (size_t i = 0; i < count; ++i) sum += temps[i];
+    return (sum + static_cast<int>(count / 2)) / static_cast<int>(count);
+  }
+
+  int avgHum() const {
+    if (count == 0) return 0;
+    int sum = 0;
+    for (size_t i = 0; i < count; ++i) sum += hums[i];
+    return (sum + static_cast<int>(count / 2)) / static_cast<int>(count);
+  }
+};
+
+// Adaptive capture/reading cadence. Fed the smoothed readings, the policy
+// drops straight to the fast cycle when temperature or humidity change faster
+// than the configured rates, move by a step (all a slow cycle sees of a fast
+// change) or leave their bands, and doubles the cycle after every `calm` quiet
+// readings in a row, up to the slow cycle. Times are passed in, so traces
+// replay on the host (tools/sampling_replay.cpp).
+//
+// Rates are taken against the oldest of the last kHistory readings within
+// kRateWindowMs (or the previous reading when the cycle is longer), over at
+// least kMinRateSpanMs: a single 1-count DHT11 step reads as at most 1/min
+// however fast the cycle is. Steps are taken against the reading one smoother
+// window back, so a jump that the average lets through a quarter at a time
+// still adds up: 8C trips t_step=2 on the first reading after it, 2C on the
+// fourth.
+class SamplingPolicy {
+ public:
+  static constexpr size_t kHistory = 8;
+  static constexpr uint32_t kRateWindowMs = 300000;
+  static constexpr uint32_t kMinRateSpanMs = 60000;
+
+  struct Limits {
+    float tempRate = 1.5f;  // C/min
+    float humRate = 4.0f;   // %RH/min
+    int tempStep = 2;       // C against the rate reference
+    int humStep = 5;        // %RH
+    // Bands; the defaults lie outside the DHT11's range, i.e. off.
+    int tempLow = -100;
+    int tempHigh = 100;
+    int humLow = -1;
+    int humHigh = 101;
+    uint32_t fastMs = 0;  // 0: the policy's floor
+    uint32_t slowMs = 0;  // 0: the policy's ceiling
+    uint32_t calm = 6;    // quiet readings per back-off step
+
+    // "dt=1.5,dh=4,t_step=2,h_step=5,t_lo=,t_hi=,...,fast_ms=,slow_ms=,calm=" ;
+    // unknown or missing names keep their value. Returns false on a malformed
+    // entry.
+    bool parse(const char *spec);
+    std::string format() const;
+  };
+
+  enum Reason { kStart, kRate, kStep, kBand, kBackoff };
+  static const char *const kReasonName[5];
+
+  struct Stats {
+    uint32_t periodMs = 0;
+    Reason reason = kStart;  // of the last change
+    uint32_t readings = 0;
+    uint32_t speedUps = 0;
+    uint32_t backoffs = 0;
+    uint32_t rateTriggers = 0;  // readings over a rate limit
+    uint32_t stepTriggers = 0;  // readings over a step limit
+    uint32_t bandTriggers = 0;  // readings outside a band
+    float tempRate = 0;         // last computed, per minute
+    float humRate = 0;
+  };
+
+  // Cycles are kept within [floorMs, ceilMs].
+  SamplingPolicy(uint32_t floorMs, uint32_t ceilMs) : floorMs_(floorMs), ceilMs_(ceilMs) {}
+
+  // Starts over at baseMs, forgetting the history.
+  void reset(uint32_t baseMs, const Limits &limits);
+
+  // One smoothed reading; returns the cycle to use from now on.
+  uint32_t update(uint64_t nowMs, int temp, int hum);
+
+  uint32_t periodMs() const { return stats_.periodMs; }
+  uint32_t fastMs() const;
+  uint32_t slowMs() const;
+  const Stats &stats() const { return stats_; }
+
+ private:
+  struct Sample {
+    uint64_t ms;
+    int temp;
+    int hum;
+  };
+
+  uint32_t clampMs(uint32_t ms) const;
+
+  uint32_t floorMs_;
+  uint32_t ceilMs_;
+  Limits limits_;
+  Sample history_[kHistory] = {};
+  size_t count_ = 0;
+  size_t next_ = 0;
+  uint32_t quiet_ = 0;
+  Stats stats_;
+};
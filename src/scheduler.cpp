@@ -0,0 +1,120 @@
+#include "scheduler.h"
+
+Scheduler::Scheduler() {
+  for (size_t i = 0; i < kSlots; ++i) slots_[i] = -1;
+}
+
+void Scheduler::link(int id) {
+  const size_t slot = slotFor(jobs_[id].deadlineMs);
+  jobs_[id].next = slots_[slot];
+  jobs_[id].linked = true;
+  slots_[slot] = id;
+}
+
+void Scheduler::unlink(int id) {
+  int *cur = &slots_[slotFor(jobs_[id].deadlineMs)];
+  while (*cur != -1) {
+    if (*cur == id) {
+      *cur = jobs_[id].next;
+      jobs_[id].next = -1;
+      jobs_[id].linked = false;
+      return;
+    }
+    cur = &jobs_[*cur].next;
+  }
+}
+
+int Scheduler::addPeriodic(const char *name, uint32_t periodMs, uint32_t firstDelayMs, uint64_t nowMs, JobFn fn) {
+  if (jobCount_ >= kMaxJobs || periodMs == 0) return -1;
+  if (jobCount_ == 0) lastTick_ = nowMs / kTickMs;
+  const int id = static_cast<int>(jobCount_++);
+  Job &job = jobs_[id];
+  job.fn = std::move(fn);
+  job.stats = JobStats();
+  job.stats.name = name;
+  job.stats.periodMs = periodMs;
+  job.deadlineMs = nowMs + firstDelayMs;
+  link(id);
+  return id;
+}
+
+void Scheduler::setPeriod(int id, uint32_t periodMs, uint64_t nowMs) {
+  if (id < 0 || static_cast<size_t>(id) >= jobCount_ || periodMs == 0) return;
+  Job &job = jobs_[id];
+  job.stats.periodMs = periodMs;
+  if (!job.linked) {
+    // In the due list of the runDue() pass in progress, which links it again
+    // one period after its deadline.
+    job.deadlineMs = nowMs;
+    return;
+  }
+  unlink(id);
+  job.deadlineMs = nowMs + periodMs;
+  link(id);
+}
+
+void Scheduler::runDue(uint64_t nowMs, const std::function<uint64_t()> &clockMs) {
+  if (jobCount_ == 0) return;
+  const uint64_t nowTick = nowMs / kTickMs;
+
+  // Collect due jobs from every slot passed since the last call (each slot is
+  // visited at most once even after a long sleep), sorted by deadline.
+  int due[kMaxJobs];
+  size_t dueCount = 0;
+  uint64_t ticks = nowTick - lastTick_ + 1;
+  if (ticks > kSlots) ticks = kSlots;
+  for (uint64_t t = 0; t < ticks; ++t) {
+    int *cur = &slots_[(lastTick_ + t) & (kSlots - 1)];
+    while (*cur != -1) {
+      const int id = *cur;
+      if (jobs_[id].deadlineMs <= nowMs) {
+        *cur = jobs_[id].next;
+        jobs_[id].next = -1;
+        jobs_[id].linked = false;
+        size_t pos = dueCount++;
+        while (pos > 0 && jobs_[due[pos - 1]].deadlineMs > jobs_[id].deadlineMs) {
+          due[pos] = due[pos - 1];
+          --pos;
+        }
+        due[pos] = id;
+      } else {
+        cur = &jobs_[id].next;
+      }
+    }
+  }
+  lastTick_ = nowTick;
+
+  for (size_t i = 0; i < dueCount; ++i) {
+    Job &job = jobs_[due[i]];
+    const uint64_t startMs = clockMs ? clockMs() : nowMs;
+    const uint32_t jitter = static_cast<uint32_t>(startMs > job.deadlineMs ? startMs - job.deadlineMs : 0);
+    job.stats.lastJitterMs = jitter;
+    if (jitter > job.stats.maxJitterMs) job.stats.maxJitterMs = jitter;
+    ++job.stats.runs;
+
+    job.fn();
+
+    const uint64_t endMs = clockMs ? clockMs() : startMs;
+    job.stats.lastDurationMs = static_cast<uint32_t>(endMs - startMs);
+    job.deadlineMs += job.stats.periodMs;
+    if (job.deadlineMs <= endMs) {
+      const uint64_t behind = endMs - job.deadlineMs;
+      job.stats.missed += static_cast<uint32_t>(behind / job.stats.periodMs) + 1;
+      job.deadlineMs = endMs + job.stats.periodMs;
+    }
+    link(due[i]);
+  }
+}
+
+uint32_t Scheduler::msUntilNext(uint64_t nowMs) const {
+  // Few jobs, so a linear scan for the earliest deadline is cheaper than
+  // walking empty wheel slots.
+  uint64_t earliest = UINT64_MAX;
+  for (size_t i = 0; i < jobCount_; ++i) {
+    if (jobs_[i].deadlineMs < earliest) earliest = jobs_[i].deadlineMs;
+  }
+  if (earliest == UINT64_MAX) return kIdleWaitMs;
+  if (earliest <= nowMs) return 0;
+  const uint64_t wait = earliest - nowMs;
+  return wait > kIdleWaitMs ? kIdleWaitMs : static_cast<uint32_t>(wait);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Hashed timer wheel for the handful of periodic jobs the firmware runs
+// (capture, sensor reads, flushes, ...). Time is passed in by the caller, so
+// the scheduler has no clock dependency and can be driven by a virtual clock
+// on the host.
+//
+// Deadlines are kept in ms; the wheel only buckets them into kTickMs slots.
+// Periodic jobs are rescheduled from their previous deadline (no drift). A
+// job that falls more than a full period behind is re-anchored to now
+// instead of firing a burst of catch-up runs.
+class Scheduler {
+ public:
+  static constexpr size_t kMaxJobs = 8;
+  static constexpr size_t kSlots = 64;      // must be a power of two
+  static constexpr uint32_t kTickMs = 10;
+  static constexpr uint32_t kIdleWaitMs = 60000;  // returned when no job exists
+
+  struct JobStats {
+    const char *name = nullptr;
+    uint32_t periodMs = 0;
+    uint32_t runs = 0;
+    uint32_t missed = 0;          // periods skipped because the job ran late
+    uint32_t lastJitterMs = 0;    // start time minus deadline
+    uint32_t maxJitterMs = 0;
+    uint32_t lastDurationMs = 0;
+  };
+
+  using JobFn = std::function<void()>;
+
+  Scheduler();
+
+  // Adds a periodic job whose first run is firstDelayMs after nowMs.
+  // Returns the job id, or -1 when the table is full.
+  int addPeriodic(const char *name, uint32_t periodMs, uint32_t firstDelayMs, uint64_t nowMs, JobFn fn);
+
+  // Changes the period; the next run is rescheduled to nowMs + periodMs.
+  // Safe from inside a job, also for the running job itself: a job that is
+  // due in the runDue() pass in progress still runs in it, then continues
+  // one new period after nowMs.
+  void setPeriod(int id, uint32_t periodMs, uint64_t nowMs);
+
+  // Runs every job whose deadline is <= nowMs, in deadline order.
+  // clockMs is read after each job to measure its duration.
+  void runDue(uint64_t nowMs, const std::function<uint64_t()> &clockMs);
+
+  // Time until the earliest deadline (0 when something is already due).
+  uint32_t msUntilNext(uint64_t nowMs) const;
+
+  size_t jobCount() const { return jobCount_; }
+  const JobStats &stats(int id) const { return jobs_[id].stats; }
+
+ private:
+  struct Job {
+    JobFn fn;
+    JobStats stats;
+    uint64_t deadlineMs = 0;
+    int next = -1;  // next job in the same wheel slot
+    bool linked = false;  // false while runDue() holds it in its due list
+  };
+
+  static size_t slotFor(uint64_t deadlineMs) { return (deadlineMs / kTickMs) & (kSlots - 1); }
+  void link(int id);
+  void unlink(int id);
+
+  Job jobs_[kMaxJobs];
+  int slots_[kSlots];
+  size_t jobCount_ = 0;
+  uint64_t lastTick_ = 0;
+};
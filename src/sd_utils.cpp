@@ -1,75 +1,54 @@
 #include "sd_utils.h"
 
-static const int kSdClkPin = 39;
-static const int kSdCmdPin = 38;
-static const int kSdData0Pin = 40;
-// If your hardware wires SD D1/D2/D3, define the pins below and use 4-bit mode.
-// static const int kSdData1Pin = -1;
-// static const int kSdData2Pin = -1;
-// static const int kSdData3Pin = -1;
+#include <cstdio>
 
-bool initSdCard() {
-  SD_MMC.setPins(kSdClkPin, kSdCmdPin, kSdData0Pin);
-  // Use 1-bit mode (only D0 wired) but run at high freq for better throughput.
-  // If you wire D1/D2/D3, change the begin() second argument to false (4-bit) and set pins above.
-  const uint32_t freq = SDMMC_FREQ_HIGHSPEED;  // target 40MHz if board/cable/card are OK
-  if (!SD_MMC.begin("/sdcard", true, true, freq, 5)) {
-    Serial.println("Card mount failed");
-    return false;
-  }
+#include "hal/logger.h"
 
-  uint8_t cardType = SD_MMC.cardType();
-  if (cardType == CARD_NONE) {
-    Serial.println("No SD_MMC card attached");
+bool initSdCard() {
+  hal::Storage &sd = hal::storage();
+  if (!sd.begin()) {
+    LOG_ERROR("Card mount failed");
     return false;
   }
-
-  Serial.print("SD_MMC Card Type: ");
-  switch (cardType) {
-    case CARD_MMC: Serial.println("MMC"); break;
-    case CARD_SD: Serial.println("SDSC"); break;
-    case CARD_SDHC: Serial.println("SDHC"); break;
-    default: Serial.println("UNKNOWN"); break;
-  }
-
-  Serial.printf("Card size: %lluMB\n", SD_MMC.cardSize() / (1024ULL * 1024ULL));
-  Serial.printf("Total space: %lluMB\n", SD_MMC.totalBytes() / (1024ULL * 1024ULL));
-  Serial.printf("Used space: %lluMB\n", SD_MMC.usedBytes() / (1024ULL * 1024ULL));
+  LOG_INFO("Total space: %lluMB", static_cast<unsigned long long>(sd.totalBytes() / (1024ULL * 1024ULL)));
+  LOG_INFO("Used space: %lluMB", static_cast<unsigned long long>(sd.usedBytes() / (1024ULL * 1024ULL)));
   return true;
 }
 
 bool ensureDir(const char *path) {
-  if (SD_MMC.exists(path)) {
+  hal::Storage &sd = hal::storage();
+  if (sd.exists(path)) {
     return true;
   }
-  bool created = SD_MMC.mkdir(path);
+  bool created = sd.mkdir(path);
   if (!created) {
-    Serial.printf("Failed to create dir: %s\n", path);
+    LOG_ERROR("Failed to create dir: %s", path);
   }
   return created;
 }
 
 uint64_t sdFreeBytes() {
-  uint64_t total = SD_MMC.totalBytes();
-  uint64_t used = SD_MMC.usedBytes();
+  hal::Storage &sd = hal::storage();
+  uint64_t total = sd.totalBytes();
+  uint64_t used = sd.usedBytes();
   return (total > used) ? (total - used) : 0;
 }
 
-bool saveJpegFrame(const char *dirPath, uint32_t frameIndex, const uint8_t *data, size_t len, String &savedPath) {
+bool saveJpegFrame(const char *dirPath, uint32_t frameIndex, const uint8_t *data, size_t len, std::string &savedPath) {
   char path[96];
   snprintf(path, sizeof(path), "%s/frame_%06lu.jpg", dirPath, (unsigned long)frameIndex);
 
-  File file = SD_MMC.open(path, FILE_WRITE);
+  std::unique_ptr<hal::File> file = hal::storage().openFor(path, hal::OpenMode::kWrite, hal::IoClass::kCapture);
   if (!file) {
-    Serial.printf("Failed to open %s for write\n", path);
+    LOG_ERROR("Failed to open %s for write", path);
     return false;
   }
 
-  size_t written = file.write(data, len);
-  file.close();
+  size_t written = file->write(data, len);
+  file->close();
 
   if (written != len) {
-    Serial.printf("Write incomplete (%u/%u)\n", (unsigned)written, (unsigned)len);
+    LOG_ERROR("Write incomplete (%u/%u)", (unsigned)written, (unsigned)len);
     return false;
   }
 
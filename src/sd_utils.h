@@ -1,10 +1,10 @@
 #pragma once
 
-#include <Arduino.h>
-#include <FS.h>
-#include <SD_MMC.h>
+#include <string>
 
-// Initializes SD_MMC. Returns true on success.
+#include "hal/hal.h"
+
+// Mounts the card through hal::storage(). Returns true on success.
 bool initSdCard();
 
 // Ensures the directory exists (creates it if missing).
@@ -15,4 +15,4 @@ uint64_t sdFreeBytes();
 
 // Saves a JPEG frame into the given directory using an incremental filename.
 // Returns true on success and fills savedPath with the written location.
-bool saveJpegFrame(const char *dirPath, uint32_t frameIndex, const uint8_t *data, size_t len, String &savedPath);
+bool saveJpegFrame(const char *dirPath, uint32_t frameIndex, const uint8_t *data, size_t len, std::string &savedPath);
@@ -0,0 +1,75 @@
+#include "wifi_link.h"
+
+void WifiLink::start(uint64_t nowMs, bool sta, bool portal) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_ = Stats();
+  stats_.sta = sta;
+  stats_.portal = portal;
+  stats_.state = sta ? State::kConnecting : State::kOff;
+  startMs_ = nowMs;
+  downSinceMs_ = nowMs;
+  everConnected_ = false;
+}
+
+bool WifiLink::useCache() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_.failures == 0;
+}
+
+void WifiLink::onAttempt(uint64_t, bool fromCache) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!stats_.sta) return;
+  stats_.state = State::kConnecting;
+  ++stats_.attempts;
+  if (fromCache) ++stats_.fastAttempts;
+}
+
+void WifiLink::onConnected(uint64_t nowMs) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!stats_.sta || stats_.state == State::kConnected) return;
+  const uint32_t tookMs = static_cast<uint32_t>(nowMs - downSinceMs_);
+  if (!everConnected_) {
+    stats_.firstConnectMs = static_cast<uint32_t>(nowMs - startMs_);
+  } else {
+    stats_.lastReconnectMs = tookMs;
+    if (tookMs > stats_.maxReconnectMs) stats_.maxReconnectMs = tookMs;
+  }
+  everConnected_ = true;
+  stats_.state = State::kConnected;
+  stats_.failures = 0;
+  ++stats_.connects;
+}
+
+uint32_t WifiLink::onDisconnected(uint64_t nowMs, int reason) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!stats_.sta || stats_.state == State::kBackoff) return 0;
+  stats_.lastReason = reason;
+  if (stats_.state == State::kConnected) {
+    // A drop: retry at once, from the cache.
+    ++stats_.drops;
+    downSinceMs_ = nowMs;
+    stats_.state = State::kBackoff;
+    return kFirstBackoffMs / 10;
+  }
+  const uint32_t shift = stats_.failures < 6 ? stats_.failures : 6;
+  ++stats_.failures;
+  stats_.state = State::kBackoff;
+  const uint32_t delayMs = kFirstBackoffMs << shift;
+  return delayMs < kMaxBackoffMs ? delayMs : kMaxBackoffMs;
+}
+
+bool WifiLink::wantPortal(uint64_t nowMs) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_.sta && !stats_.portal && stats_.state != State::kConnected &&
+         stats_.failures >= kPortalAfterFailures && nowMs - downSinceMs_ >= kPortalAfterMs;
+}
+
+void WifiLink::setPortal(bool on) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.portal = on;
+}
+
+WifiLink::Stats WifiLink::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
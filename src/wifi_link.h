@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+
+// Station link policy, kept apart from the Wi-Fi driver so it runs the same
+// on the host. main.cpp reports driver events (attempt started, got IP,
+// disconnected) from the Wi-Fi event task and the loop task; the link
+// decides when to retry, whether the cached BSSID/channel/IP may be used and
+// when failures have lasted long enough to open the AP config portal. It also
+// measures how long connects and reconnects take. Times are passed in.
+//
+// Retries back off 1s, 2s, 4s ... up to kMaxBackoffMs. The first attempt
+// after boot or a drop uses the cached access point; once that fails, the
+// following attempts do a full scan and DHCP.
+class WifiLink {
+ public:
+  static constexpr uint32_t kFirstBackoffMs = 1000;
+  static constexpr uint32_t kMaxBackoffMs = 60000;
+  // The portal opens after this many failed attempts in a row, provided the
+  // station has also been down for kPortalAfterMs.
+  static constexpr uint32_t kPortalAfterFailures = 6;
+  static constexpr uint32_t kPortalAfterMs = 120000;
+
+  enum class State { kOff, kConnecting, kConnected, kBackoff };
+
+  struct Stats {
+    State state = State::kOff;
+    bool sta = false;     // station enabled (connecting, waiting or up)
+    bool portal = false;  // soft AP serving the config portal
+    uint32_t attempts = 0;
+    uint32_t fastAttempts = 0;    // attempts with the cached BSSID/channel/IP
+    uint32_t connects = 0;
+    uint32_t drops = 0;           // disconnects after having an IP
+    uint32_t failures = 0;        // failed attempts in a row
+    int lastReason = 0;           // driver's disconnect reason code
+    uint32_t firstConnectMs = 0;  // start() -> first IP, 0 until then
+    uint32_t lastReconnectMs = 0; // drop -> IP again
+    uint32_t maxReconnectMs = 0;
+  };
+
+  // Station mode (sta) and/or the soft AP; without sta the portal is the
+  // only network and nothing retries.
+  void start(uint64_t nowMs, bool sta, bool portal);
+
+  // Whether the next attempt should use the cached access point and address.
+  bool useCache() const;
+  void onAttempt(uint64_t nowMs, bool fromCache);
+  void onConnected(uint64_t nowMs);
+  // Returns the delay before the next attempt, or 0 when the event does not
+  // call for one (station off, or a retry is already pending).
+  uint32_t onDisconnected(uint64_t nowMs, int reason);
+
+  // True once failures are persistent and the portal is not open yet.
+  bool wantPortal(uint64_t nowMs) const;
+  void setPortal(bool on);
+
+  Stats stats() const;
+
+ private:
+  mutable std::mutex mutex_;
+  Stats stats_;
+  uint64_t startMs_ = 0;
+  uint64_t downSinceMs_ = 0;
+  bool everConnected_ = false;
+};
@@ -0,0 +1,120 @@
+// What-if battery estimate with the firmware's EnergyModel (src/energy.h):
+// replays a day of capture cycles with the given on-times and prints the
+// active time per subsystem and mAh/day, without a board or a meter.
+//
+//   g++ -O2 -std=gnu++17 -Isrc tools/energy_model.cpp src/energy.cpp -o energy_model
+//   ./energy_model                                   # 30s cycles, STA, no HTTP
+//   ./energy_model --cycle-ms 10000 --ap             # soft AP, 10s cycles
+//   ./energy_model --http-ms 200 --currents camera=140,sleep=0.8
+//
+// On-times per cycle default to what /stats/energy shows on the bench for a
+// 5MP frame; take last_cycle.active_ms from a real device to refine them.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "energy.h"
+
+namespace {
+
+struct Scenario {
+  uint32_t cycleMs = 30000;
+  uint32_t cameraMs = 900;  // sensor power-up, AE settle and capture
+  uint32_t sdMs = 60;       // frame write plus readings.csv append
+  uint32_t dhtMs = 25;
+  uint32_t cpuMs = 1000;    // awake time per cycle, covering the above
+  uint32_t httpMs = 0;      // radio busy serving clients per cycle
+  bool ap = false;
+  EnergyModel::Profile currents;
+};
+
+void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [--cycle-ms N] [--camera-ms N] [--sd-ms N] [--dht-ms N] [--cpu-ms N]\n"
+          "          [--http-ms N] [--ap] [--currents name=mA,...]\n",
+          argv0);
+}
+
+EnergyModel::Totals simulateDay(const Scenario &sc) {
+  EnergyModel model(0);
+  model.set(sc.ap ? EnergyModel::kWifiAp : EnergyModel::kWifiSta, true, 0);
+  EnergyModel::Totals day;
+  for (uint64_t start = 0;; start += sc.cycleMs * 1000ULL) {
+    if (model.rollDay(start, day)) return day;
+    model.endCycle(start);
+    // Subsystems overlap the way captureJob/sensorJob run them: the CPU is up
+    // for the whole burst, the camera first, then the card and the sensor.
+    const uint64_t cpuEnd = start + sc.cpuMs * 1000ULL;
+    const uint64_t camEnd = start + sc.cameraMs * 1000ULL;
+    const uint64_t sdEnd = camEnd + sc.sdMs * 1000ULL;
+    model.set(EnergyModel::kCpu, true, start);
+    model.set(EnergyModel::kCamera, true, start);
+    model.set(EnergyModel::kCamera, false, camEnd);
+    model.set(EnergyModel::kSd, true, camEnd);
+    model.set(EnergyModel::kSd, false, sdEnd);
+    model.set(EnergyModel::kDht, true, sdEnd);
+    model.set(EnergyModel::kDht, false, sdEnd + sc.dhtMs * 1000ULL);
+    model.set(EnergyModel::kCpu, false, cpuEnd);
+    if (sc.httpMs) {
+      model.set(EnergyModel::kCpu, true, cpuEnd);
+      model.set(EnergyModel::kRadio, true, cpuEnd);
+      model.set(EnergyModel::kRadio, false, cpuEnd + sc.httpMs * 1000ULL);
+      model.set(EnergyModel::kCpu, false, cpuEnd + sc.httpMs * 1000ULL);
+    }
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  Scenario sc;
+  for (int i = 1; i < argc; ++i) {
+    const char *a = argv[i];
+    const char *v = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (strcmp(a, "--ap") == 0) {
+      sc.ap = true;
+      continue;
+    }
+    if (!v) {
+      usage(argv[0]);
+      return 1;
+    }
+    ++i;
+    if (strcmp(a, "--cycle-ms") == 0) sc.cycleMs = strtoul(v, nullptr, 10);
+    else if (strcmp(a, "--camera-ms") == 0) sc.cameraMs = strtoul(v, nullptr, 10);
+    else if (strcmp(a, "--sd-ms") == 0) sc.sdMs = strtoul(v, nullptr, 10);
+    else if (strcmp(a, "--dht-ms") == 0) sc.dhtMs = strtoul(v, nullptr, 10);
+    else if (strcmp(a, "--cpu-ms") == 0) sc.cpuMs = strtoul(v, nullptr, 10);
+    else if (strcmp(a, "--http-ms") == 0) sc.httpMs = strtoul(v, nullptr, 10);
+    else if (strcmp(a, "--currents") == 0) {
+      if (!sc.currents.parse(v)) {
+        fprintf(stderr, "bad current profile: %s\n", v);
+        return 1;
+      }
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  const uint32_t busyMs = (sc.cpuMs > sc.cameraMs + sc.sdMs + sc.dhtMs ? sc.cpuMs : sc.cameraMs + sc.sdMs + sc.dhtMs) +
+                          sc.httpMs;
+  if (sc.cycleMs == 0 || busyMs > sc.cycleMs) {
+    fprintf(stderr, "on-times (%u ms) do not fit in a %u ms cycle\n", busyMs, sc.cycleMs);
+    return 1;
+  }
+
+  const EnergyModel::Totals day = simulateDay(sc);
+  printf("currents: %s\n", sc.currents.format().c_str());
+  printf("%u cycles of %u ms, %s\n\n", day.cycles, sc.cycleMs, sc.ap ? "soft AP" : "station");
+  printf("%-9s %10s %8s %9s\n", "subsystem", "active s", "duty %", "mAh");
+  for (int s = 0; s < EnergyModel::kSubsystemCount; ++s) {
+    const double activeS = static_cast<double>(day.activeUs[s]) / 1e6;
+    printf("%-9s %10.1f %8.2f %9.1f\n", EnergyModel::kName[s], activeS,
+           100.0 * static_cast<double>(day.activeUs[s]) / static_cast<double>(day.elapsedUs),
+           activeS * sc.currents.ma[s] / 3600.0);
+  }
+  const double sleepS = static_cast<double>(day.elapsedUs - day.activeUs[EnergyModel::kCpu]) / 1e6;
+  printf("%-9s %10.1f %8s %9.1f\n", "sleep", sleepS, "", sleepS * sc.currents.sleepMa / 3600.0);
+  printf("\n%.1f mAh/day (%.2f mA average)\n", day.mAhPerDay(sc.currents), day.mAh(sc.currents) / 24.0);
+  return 0;
+}
@@ -0,0 +1,346 @@
+// Host benchmark for frame storage: cost of saving and opening one frame as a
+// run grows, for one-file-per-frame (sd_utils) versus segments (FrameStore).
+//
+//   g++ -O2 -std=gnu++17 -Isrc tools/frame_store_bench.cpp src/frame_store.cpp src/sd_utils.cpp src/crc32.cpp -o frame_store_bench
+//   ./frame_store_bench                  # checkpoints at 1000, 5000, 20000 frames
+//   ./frame_store_bench 2000 50000       # your own checkpoints
+//
+// Files go to a temp directory on the host filesystem, whose directories are
+// hashed, so host times stay flat. The sectors/op columns come from a model
+// of FatFS instead: directories are unsorted lists of 32-byte entries read a
+// sector at a time, an open scans up to the entry, and a create scans the
+// whole directory about three times (name lookup, short-name tail probe,
+// free-slot search). Extending a file writes the FAT sectors covering its new
+// clusters; reads outside the JPEG payload (segment index, footer) count too.
+// ms/op multiplies sectors by --sector-us (single-block reads, default 100us).
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "frame_store.h"
+#include "hal/logger.h"
+#include "sd_utils.h"
+
+namespace {
+
+constexpr uint32_t kSectorBytes = 512;
+constexpr uint32_t kEntriesPerSector = kSectorBytes / 32;
+constexpr uint32_t kClusterBytes = 32 * 1024;
+constexpr size_t kFrameBytes = 4096;
+constexpr size_t kOpsPerCheckpoint = 200;
+
+uint64_t gSectors = 0;  // modeled FAT sectors touched since the last reset
+
+// A directory as FatFS lays it out: entries in creation order after "." and
+// "..", each name taking entrySlots() 32-byte slots.
+struct ModelDir {
+  std::vector<std::string> names;
+  std::unordered_map<std::string, uint32_t> slotsThrough;  // slots scanned to reach a name
+  uint32_t totalSlots = 2;
+};
+
+std::map<std::string, ModelDir> gDirs;
+
+// 8.3 names need one entry; others one per 13 characters plus the short one.
+uint32_t entrySlots(const std::string &name) {
+  const size_t dot = name.rfind('.');
+  const size_t body = dot == std::string::npos ? name.size() : dot;
+  const size_t ext = dot == std::string::npos ? 0 : name.size() - dot - 1;
+  if (body <= 8 && ext <= 3) return 1;
+  return 1 + static_cast<uint32_t>((name.size() + 12) / 13);
+}
+
+void splitPath(const std::string &path, std::string &dir, std::string &name) {
+  const size_t slash = path.rfind('/');
+  dir = slash == std::string::npos ? "" : path.substr(0, slash);
+  name = path.substr(slash + 1);
+}
+
+void chargeSlots(uint32_t slots) { gSectors += (slots + kEntriesPerSector - 1) / kEntriesPerSector; }
+
+void chargeOpen(const std::string &path, bool create) {
+  std::string dir, name;
+  splitPath(path, dir, name);
+  ModelDir &d = gDirs[dir];
+  auto it = d.slotsThrough.find(name);
+  if (it != d.slotsThrough.end()) {
+    chargeSlots(it->second);
+    return;
+  }
+  chargeSlots(d.totalSlots);  // a miss scans everything
+  if (!create) return;
+  const uint32_t slots = entrySlots(name);
+  if (slots > 1) {
+    // Short name "FRAME_~N.JPG": tails 1-5 hit the first files of the
+    // family, then a hashed tail that misses.
+    const uint32_t probes = d.slotsThrough.size() < 5 ? static_cast<uint32_t>(d.slotsThrough.size()) : 5;
+    for (uint32_t i = 1; i <= probes; ++i) chargeSlots(2 + i * slots);
+    chargeSlots(d.totalSlots);
+  }
+  chargeSlots(d.totalSlots);  // free-slot search ends past the last entry
+  d.totalSlots += slots;
+  d.slotsThrough[name] = d.totalSlots;
+  d.names.push_back(name);
+}
+
+void chargeRange(uint64_t pos, size_t len) {
+  if (len == 0) return;
+  gSectors += (pos + len - 1) / kSectorBytes - pos / kSectorBytes + 1;
+}
+
+class ModelFile : public hal::File {
+ public:
+  ModelFile(FILE *fp, uint64_t size) : fp_(fp), size_(size) {}
+  ~ModelFile() override { close(); }
+
+  size_t read(uint8_t *buf, size_t len) override {
+    const uint64_t pos = position();
+    const size_t n = fread(buf, 1, len, fp_);
+    chargeRange(pos, n);
+    return n;
+  }
+  size_t write(const uint8_t *buf, size_t len) override {
+    const size_t n = fwrite(buf, 1, len, fp_);
+    const uint64_t end = position();
+    if (end > size_) {
+      const uint64_t before = (size_ + kClusterBytes - 1) / kClusterBytes;
+      const uint64_t after = (end + kClusterBytes - 1) / kClusterBytes;
+      chargeRange(before * 4, static_cast<size_t>((after - before) * 4));
+      size_ = end;
+    }
+    return n;
+  }
+  bool seek(uint64_t pos) override { return fseeko(fp_, static_cast<off_t>(pos), SEEK_SET) == 0; }
+  uint64_t position() override { return static_cast<uint64_t>(ftello(fp_)); }
+  uint64_t size() override { return size_; }
+  void close() override {
+    if (fp_) fclose(fp_);
+    fp_ = nullptr;
+  }
+
+ private:
+  FILE *fp_;
+  uint64_t size_;
+};
+
+class ModelStorage : public hal::Storage {
+ public:
+  bool begin() override { return true; }
+  bool exists(const char *path) override {
+    chargeOpen(path, false);
+    struct stat st;
+    return stat(path, &st) == 0;
+  }
+  bool mkdir(const char *path) override {
+    chargeOpen(path, true);
+    return ::mkdir(path, 0755) == 0;
+  }
+  bool remove(const char *path) override { return ::remove(path) == 0; }
+  bool rename(const char *from, const char *to) override { return ::rename(from, to) == 0; }
+  std::unique_ptr<hal::File> open(const char *path, hal::OpenMode mode) override {
+    static const char *kModes[] = {"rb", "wb", "ab", "r+b"};
+    chargeOpen(path, mode == hal::OpenMode::kWrite || mode == hal::OpenMode::kAppend);
+    FILE *fp = fopen(path, kModes[static_cast<int>(mode)]);
+    if (!fp) return nullptr;
+    struct stat st;
+    fstat(fileno(fp), &st);
+    return std::unique_ptr<hal::File>(new ModelFile(fp, static_cast<uint64_t>(st.st_size)));
+  }
+  bool listDir(const char *path, const std::function<bool(const hal::DirEntry &)> &fn) override {
+    const ModelDir &dir = gDirs[path];
+    chargeSlots(dir.totalSlots);
+    for (const std::string &name : dir.names) {
+      hal::DirEntry d;
+      d.name = name;
+      struct stat st;
+      if (stat((std::string(path) + "/" + name).c_str(), &st) == 0) {
+        d.isDir = S_ISDIR(st.st_mode);
+        d.size = static_cast<uint64_t>(st.st_size);
+      }
+      if (!fn(d)) break;
+    }
+    return true;
+  }
+  uint64_t totalBytes() override { return 32ULL << 30; }
+  uint64_t usedBytes() override { return 0; }
+};
+
+class HostClock : public hal::Clock {
+ public:
+  uint64_t nowUs() override {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                                     std::chrono::steady_clock::now().time_since_epoch())
+                                     .count());
+  }
+  void sleepMs(uint32_t) override {}
+};
+
+bool gQuiet = false;
+
+struct Cost {
+  double hostUs = 0;
+  double sectors = 0;
+};
+
+struct Row {
+  size_t frames;
+  Cost create;
+  Cost open;
+};
+
+double nowUs() { return static_cast<double>(hal::clock().nowUs()); }
+
+void removeTree(const std::string &path) {
+  DIR *d = opendir(path.c_str());
+  if (!d) return;
+  while (dirent *e = readdir(d)) {
+    const std::string name = e->d_name;
+    if (name == "." || name == "..") continue;
+    const std::string child = path + "/" + name;
+    struct stat st;
+    if (stat(child.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+      removeTree(child);
+    } else {
+      unlink(child.c_str());
+    }
+  }
+  closedir(d);
+  rmdir(path.c_str());
+}
+
+// Saves frames 0..max(checkpoints) into a fresh run directory and measures
+// the last kOpsPerCheckpoint saves and kOpsPerCheckpoint random opens at
+// each checkpoint.
+std::vector<Row> runBackend(const std::string &root, bool segments, const std::vector<size_t> &checkpoints) {
+  const std::string run = root + (segments ? "/run_seg" : "/run_files");
+  hal::storage().mkdir(run.c_str());
+  std::vector<uint8_t> frame(kFrameBytes);
+  for (size_t i = 0; i < frame.size(); ++i) frame[i] = static_cast<uint8_t>(i * 31);
+  frame[0] = 0xFF;
+  frame[1] = 0xD8;
+
+  FrameStore store;
+  store.begin(run);
+  std::mt19937 rng(42);
+  std::vector<Row> rows;
+  size_t next = 0;
+  for (size_t cp : checkpoints) {
+    Row row{cp, {}, {}};
+    const size_t timedFrom = cp > kOpsPerCheckpoint ? cp - kOpsPerCheckpoint : 0;
+    for (; next < cp; ++next) {
+      const bool timed = next >= timedFrom;
+      gSectors = 0;
+      const double t0 = nowUs();
+      std::string saved;
+      const uint32_t idx = static_cast<uint32_t>(next);
+      const bool ok = segments ? store.append(idx, frame.data(), frame.size(), 1ULL << 40, saved)
+                               : saveJpegFrame(run.c_str(), idx, frame.data(), frame.size(), saved);
+      if (!ok) {
+        fprintf(stderr, "save failed at frame %zu\n", next);
+        exit(1);
+      }
+      if (timed) {
+        row.create.hostUs += nowUs() - t0;
+        row.create.sectors += static_cast<double>(gSectors);
+      }
+    }
+    const double created = static_cast<double>(cp - timedFrom);
+    row.create.hostUs /= created;
+    row.create.sectors /= created;
+
+    std::uniform_int_distribution<size_t> pick(0, cp - 1);
+    for (size_t i = 0; i < kOpsPerCheckpoint; ++i) {
+      const uint32_t idx = static_cast<uint32_t>(pick(rng));
+      char name[32];
+      snprintf(name, sizeof(name), "/frame_%06lu.jpg", static_cast<unsigned long>(idx));
+      gSectors = 0;
+      const double t0 = nowUs();
+      std::unique_ptr<hal::File> f =
+          segments ? store.openFrame(run, idx) : hal::storage().open((run + name).c_str(), hal::OpenMode::kRead);
+      row.open.hostUs += nowUs() - t0;
+      row.open.sectors += static_cast<double>(gSectors);
+      if (!f || f->size() != kFrameBytes) {
+        fprintf(stderr, "open failed for frame %u\n", static_cast<unsigned>(idx));
+        exit(1);
+      }
+    }
+    row.open.hostUs /= kOpsPerCheckpoint;
+    row.open.sectors /= kOpsPerCheckpoint;
+    rows.push_back(row);
+  }
+  store.seal();
+  return rows;
+}
+
+}  // namespace
+
+namespace hal {
+Clock &clock() {
+  static HostClock c;
+  return c;
+}
+Storage &storage() {
+  static ModelStorage s;
+  return s;
+}
+void logWrite(LogLevel, const char *fmt, ...) {
+  if (gQuiet) return;
+  va_list ap;
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  fputc('\n', stderr);
+}
+}  // namespace hal
+
+int main(int argc, char **argv) {
+  std::vector<size_t> checkpoints;
+  double sectorUs = 100;
+  for (int i = 1; i < argc; ++i) {
+    const std::string a = argv[i];
+    if (a == "--sector-us" && i + 1 < argc) {
+      sectorUs = atof(argv[++i]);
+    } else if (atol(argv[i]) > 0) {
+      checkpoints.push_back(static_cast<size_t>(atol(argv[i])));
+    } else {
+      fprintf(stderr, "usage: %s [--sector-us N] [frames...]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (checkpoints.empty()) checkpoints = {1000, 5000, 20000};
+  std::sort(checkpoints.begin(), checkpoints.end());
+
+  char tmpl[] = "/tmp/frame_store_bench.XXXXXX";
+  if (!mkdtemp(tmpl)) {
+    perror("mkdtemp");
+    return 1;
+  }
+  const std::string root = tmpl;
+  gQuiet = true;
+
+  printf("%zu-byte frames, %zu ops per checkpoint, %.0fus per modeled sector\n\n", kFrameBytes, kOpsPerCheckpoint,
+         sectorUs);
+  printf("%-9s %8s | %-28s | %-28s\n", "", "", "save one frame", "open one frame");
+  printf("%-9s %8s | %8s %9s %9s | %8s %9s %9s\n", "backend", "frames", "host us", "sectors", "card ms", "host us",
+         "sectors", "card ms");
+  for (bool segments : {false, true}) {
+    for (const Row &r : runBackend(root, segments, checkpoints)) {
+      printf("%-9s %8zu | %8.1f %9.1f %9.1f | %8.1f %9.1f %9.1f\n", segments ? "segments" : "files", r.frames,
+             r.create.hostUs, r.create.sectors, r.create.sectors * sectorUs / 1000.0, r.open.hostUs, r.open.sectors,
+             r.open.sectors * sectorUs / 1000.0);
+    }
+  }
+  removeTree(root);
+  return 0;
+}
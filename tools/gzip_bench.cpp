@@ -0,0 +1,111 @@
+// Host benchmark for src/gzip_stream.cpp: CPU time per KB versus bytes saved
+// for each level/window, on synthetic device payloads or on given files.
+//
+//   g++ -O2 -std=gnu++17 -Isrc tools/gzip_bench.cpp src/gzip_stream.cpp src/crc32.cpp -o gzip_bench
+//   ./gzip_bench                     # synthetic readings.csv, /frames JSON, /browse HTML
+//   ./gzip_bench a.csv b.json        # your own captures
+//
+// Host CPUs are 10-30x faster than the 240MHz ESP32-S3, so read the us/KB
+// column as a relative cost between settings.
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "gzip_stream.h"
+
+struct Sample {
+  std::string name;
+  std::string data;
+};
+
+static std::string syntheticCsv(size_t rows) {
+  std::string s;
+  char line[64];
+  for (size_t i = 0; i < rows; ++i) {
+    int t = 22 + static_cast<int>((i / 97) % 5);
+    int h = 50 + static_cast<int>((i / 53) % 9);
+    snprintf(line, sizeof(line), "3,%zu,%zu,%d,%d\n", i, 1000 + i * 30000, t, h);
+    s += line;
+  }
+  return s;
+}
+
+static std::string syntheticFramesJson(size_t items) {
+  std::string s = "{\"items\":[";
+  char item[128];
+  for (size_t i = 0; i < items; ++i) {
+    snprintf(item, sizeof(item), "%s{\"run\":\"run_0003\",\"file\":\"frame_%06zu.jpg\",\"size\":%zu}",
+             i ? "," : "", i, 180000 + (i * 7919) % 60000);
+    s += item;
+  }
+  s += "],\"has_more\":true}";
+  return s;
+}
+
+static std::string syntheticBrowseHtml(size_t items) {
+  std::string s = "<html><body><h3>Files</h3><ul><li>/data/run_0003<ul>";
+  char item[192];
+  for (size_t i = 0; i < items; ++i) {
+    snprintf(item, sizeof(item),
+             "<li><a href=\"/frames/file?run=run_0003&file=frame_%06zu.jpg\">frame_%06zu.jpg</a> (%zu bytes)</li>",
+             i, i, 180000 + (i * 7919) % 60000);
+    s += item;
+  }
+  s += "</ul></li></ul></body></html>";
+  return s;
+}
+
+int main(int argc, char **argv) {
+  std::vector<Sample> samples;
+  if (argc > 1) {
+    for (int i = 1; i < argc; ++i) {
+      std::ifstream in(argv[i], std::ios::binary);
+      if (!in) {
+        fprintf(stderr, "cannot read %s\n", argv[i]);
+        return 1;
+      }
+      samples.push_back({argv[i], std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>())});
+    }
+  } else {
+    samples.push_back({"readings.csv (20k rows)", syntheticCsv(20000)});
+    samples.push_back({"/frames JSON (500 items)", syntheticFramesJson(500)});
+    samples.push_back({"/browse HTML (2000 items)", syntheticBrowseHtml(2000)});
+  }
+
+  const int windows[] = {10, 12, 15};
+  for (const Sample &sample : samples) {
+    printf("\n%s: %zu bytes\n", sample.name.c_str(), sample.data.size());
+    printf("%5s %6s %10s %9s %9s %12s %10s\n", "level", "window", "out bytes", "ratio", "us/KB", "saved B/KB", "state KB");
+    for (int w : windows) {
+      for (int level = 1; level <= 9; ++level) {
+        GzipStream::Options opts;
+        opts.level = level;
+        opts.windowBits = w;
+        uint64_t outBytes = 0;
+        int reps = 0;
+        const auto start = std::chrono::steady_clock::now();
+        double elapsedUs = 0;
+        do {
+          GzipStream gz(opts, [](const uint8_t *, size_t) {});
+          gz.write(sample.data.data(), sample.data.size());
+          gz.finish();
+          outBytes = gz.bytesOut();
+          ++reps;
+          elapsedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        } while (elapsedUs < 200000.0);
+        const double kb = sample.data.size() / 1024.0;
+        const double usPerKb = elapsedUs / reps / kb;
+        const double savedPerKb = (sample.data.size() - static_cast<double>(outBytes)) / kb;
+        // window + hash chains + token buffer + block tables, see GzipStream members.
+        const double stateKb = (4.0 * (1 << w) + 2.0 * 2048 + 4.0 * 2048 + 10.4 * 1024) / 1024.0;
+        printf("%5d %6d %10llu %8.2fx %9.2f %12.0f %10.1f\n", level, 1 << w,
+               static_cast<unsigned long long>(outBytes), sample.data.size() / static_cast<double>(outBytes),
+               usPerKb, savedPerKb, stateKb);
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,244 @@
+// Host check for the SD I/O scheduler (src/hal/io_sched.cpp): a capture
+// writer, a log flusher and a few HTTP-style readers share one fake card that
+// sleeps like an SD_MMC bus, once through a single FIFO queue (every caller in
+// one class: first come, first served, like the bare driver lock) and once
+// with the real classes. Prints how long a frame save and a log flush take
+// end to end, queueing included, and what the readers still get through.
+//
+//   g++ -O2 -std=gnu++17 -pthread -Isrc tools/io_sched_bench.cpp src/hal/io_sched.cpp -o io_sched_bench
+//   ./io_sched_bench                     # 3 readers, 200KB frames, 10s per mode
+//   ./io_sched_bench --readers 6 --op-us 300 --us-per-kb 250 --seconds 5
+//
+// Writes and reads only cost time here; nothing is stored.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "hal/io_sched.h"
+
+namespace {
+
+using SteadyClock = std::chrono::steady_clock;
+
+struct Options {
+  int readers = 3;
+  int seconds = 10;
+  uint32_t opUs = 500;     // per call: command, FAT lookups
+  uint32_t usPerKb = 200;  // ~5MB/s, a 1-bit bus at 20MHz with overhead
+  size_t frameBytes = 200 * 1024;
+  uint32_t captureMs = 500;
+  uint32_t logMs = 100;
+};
+
+Options gOpts;
+
+void busy(size_t bytes) {
+  std::this_thread::sleep_for(std::chrono::microseconds(gOpts.opUs + gOpts.usPerKb * bytes / 1024));
+}
+
+// A card that only spends time. The hardware bus allows one command at a
+// time; the mutex stands in for the driver's lock.
+class SlowFile : public hal::File {
+ public:
+  SlowFile(std::mutex &bus, uint64_t size) : bus_(bus), size_(size) {}
+  size_t read(uint8_t *, size_t len) override {
+    std::lock_guard<std::mutex> lock(bus_);
+    const size_t n = static_cast<size_t>(std::min<uint64_t>(len, size_ - pos_));
+    busy(n);
+    pos_ += n;
+    return n;
+  }
+  size_t write(const uint8_t *, size_t len) override {
+    std::lock_guard<std::mutex> lock(bus_);
+    busy(len);
+    pos_ += len;
+    return len;
+  }
+  bool seek(uint64_t pos) override {
+    pos_ = pos;
+    return true;
+  }
+  uint64_t position() override { return pos_; }
+  uint64_t size() override { return size_; }
+  void close() override {}
+
+ private:
+  std::mutex &bus_;
+  uint64_t size_;
+  uint64_t pos_ = 0;
+};
+
+class SlowStorage : public hal::Storage {
+ public:
+  bool begin() override { return true; }
+  bool exists(const char *) override { return op(); }
+  bool mkdir(const char *) override { return op(); }
+  bool remove(const char *) override { return op(); }
+  bool rename(const char *, const char *) override { return op(); }
+  std::unique_ptr<hal::File> open(const char *, hal::OpenMode) override {
+    op();
+    return std::unique_ptr<hal::File>(new SlowFile(bus_, gOpts.frameBytes));
+  }
+  bool listDir(const char *, const std::function<bool(const hal::DirEntry &)> &) override { return op(); }
+  uint64_t totalBytes() override { return 0; }
+  uint64_t usedBytes() override { return 0; }
+
+ private:
+  bool op() {
+    std::lock_guard<std::mutex> lock(bus_);
+    busy(0);
+    return true;
+  }
+  std::mutex bus_;
+};
+
+uint64_t steadyUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(SteadyClock::now().time_since_epoch()).count();
+}
+
+struct Latencies {
+  std::mutex mutex;
+  std::vector<double> captureMs;  // whole frame: open, write, close
+  std::vector<double> logMs;
+  uint64_t readBytes = 0;
+};
+
+double percentile(std::vector<double> v, double p) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  return v[std::min(v.size() - 1, static_cast<size_t>(p / 100.0 * v.size()))];
+}
+
+double msSince(SteadyClock::time_point t0) {
+  return std::chrono::duration<double, std::milli>(SteadyClock::now() - t0).count();
+}
+
+void runMode(const char *name, bool prioritized) {
+  SlowStorage card;
+  hal::IoGate gate(steadyUs);
+  hal::ScheduledStorage sd(card, gate);
+  // FIFO mode puts everyone in one class, so the queue is plain arrival order.
+  auto classOf = [prioritized](hal::IoClass cls) { return prioritized ? cls : hal::IoClass::kLog; };
+  Latencies lat;
+  std::atomic<bool> stop{false};
+  std::vector<uint8_t> frame(gOpts.frameBytes);
+
+  std::vector<std::thread> threads;
+  threads.emplace_back([&] {
+    while (!stop) {
+      const SteadyClock::time_point t0 = SteadyClock::now();
+      std::unique_ptr<hal::File> f = sd.openFor("/frame.jpg", hal::OpenMode::kWrite, classOf(hal::IoClass::kCapture));
+      f->write(frame.data(), frame.size());
+      f->close();
+      {
+        std::lock_guard<std::mutex> lock(lat.mutex);
+        lat.captureMs.push_back(msSince(t0));
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(gOpts.captureMs));
+    }
+  });
+  threads.emplace_back([&] {
+    const std::string line(600, 'x');
+    while (!stop) {
+      const SteadyClock::time_point t0 = SteadyClock::now();
+      std::unique_ptr<hal::File> f = sd.openFor("/log.txt", hal::OpenMode::kAppend, classOf(hal::IoClass::kLog));
+      f->write(line);
+      f->close();
+      {
+        std::lock_guard<std::mutex> lock(lat.mutex);
+        lat.logMs.push_back(msSince(t0));
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(gOpts.logMs));
+    }
+  });
+  for (int r = 0; r < gOpts.readers; ++r) {
+    threads.emplace_back([&] {
+      // The HTTP server refills a connection 8KB at a time.
+      std::vector<uint8_t> buf(8 * 1024);
+      while (!stop) {
+        std::unique_ptr<hal::File> f = sd.openFor("/frame.jpg", hal::OpenMode::kRead, classOf(hal::IoClass::kBulk));
+        size_t n;
+        while (!stop && (n = f->read(buf.data(), buf.size())) > 0) {
+          std::lock_guard<std::mutex> lock(lat.mutex);
+          lat.readBytes += n;
+        }
+      }
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::seconds(gOpts.seconds));
+  stop = true;
+  for (std::thread &t : threads) t.join();
+
+  const hal::IoStats io = gate.stats();
+  uint32_t maxQueued = 0;
+  for (const hal::IoClassStats &s : io.cls) maxQueued = std::max(maxQueued, s.maxQueued);
+  printf("%-12s %8.1f %8.1f %8.1f %8.1f %8.1f %9.2f %6u\n", name, percentile(lat.captureMs, 50),
+         percentile(lat.captureMs, 99), percentile(lat.logMs, 50), percentile(lat.logMs, 99),
+         percentile(lat.logMs, 100), lat.readBytes / 1e6 / gOpts.seconds, maxQueued);
+}
+
+void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [--readers N] [--seconds N] [--op-us N] [--us-per-kb N] [--frame-kb N] [--capture-ms N]\n",
+          argv0);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  for (int i = 1; i < argc; ++i) {
+    if (i + 1 >= argc) {
+      usage(argv[0]);
+      return 2;
+    }
+    const char *a = argv[i];
+    const unsigned long v = strtoul(argv[++i], nullptr, 10);
+    if (strcmp(a, "--readers") == 0) gOpts.readers = static_cast<int>(v);
+    else if (strcmp(a, "--seconds") == 0) gOpts.seconds = static_cast<int>(std::max(1UL, v));
+    else if (strcmp(a, "--op-us") == 0) gOpts.opUs = static_cast<uint32_t>(v);
+    else if (strcmp(a, "--us-per-kb") == 0) gOpts.usPerKb = static_cast<uint32_t>(v);
+    else if (strcmp(a, "--frame-kb") == 0) gOpts.frameBytes = std::max(1UL, v) * 1024;
+    else if (strcmp(a, "--capture-ms") == 0) gOpts.captureMs = static_cast<uint32_t>(v);
+    else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  printf("%d readers, %zuKB frames every %ums, card %uus/op + %uus/KB\n\n", gOpts.readers, gOpts.frameBytes / 1024,
+         gOpts.captureMs, gOpts.opUs, gOpts.usPerKb);
+  printf("%-12s %8s %8s %8s %8s %8s %9s %6s\n", "mode", "frame", "frame", "log", "log", "log", "reads", "max");
+  printf("%-12s %8s %8s %8s %8s %8s %9s %6s\n", "", "p50 ms", "p99 ms", "p50 ms", "p99 ms", "max ms", "MB/s",
+         "queue");
+  runMode("fifo", false);
+  runMode("prioritized", true);
+  return 0;
+}
+
+namespace hal {
+// io_sched.cpp's own storage()/ioStats() sit on these; the bench builds its
+// gates directly.
+Clock &clock() {
+  struct SteadyHalClock : Clock {
+    uint64_t nowUs() override { return steadyUs(); }
+    void sleepMs(uint32_t ms) override { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+  };
+  static SteadyHalClock c;
+  return c;
+}
+Storage &cardStorage() {
+  static SlowStorage card;
+  return card;
+}
+TaskId currentTaskId() {
+  static thread_local char tag;
+  return reinterpret_cast<TaskId>(&tag);
+}
+}  // namespace hal
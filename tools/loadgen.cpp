@@ -0,0 +1,524 @@
+// Host tool: HTTP load generator for the device API. N keep-alive clients
+// issue a weighted mix of requests for a fixed time and the tool reports
+// per-route latency percentiles and throughput.
+//
+//   g++ -O2 -std=gnu++17 -pthread tools/loadgen.cpp -o loadgen
+//   ./loadgen -c 4 -d 30 192.168.1.40
+//   ./loadgen -c 8 -d 60 --mix file=6,latest=2,frames=1,browse=1 --csv samples.csv localhost:8080
+//
+// Routes in the mix: frames (/frames, a random page), latest (/frames/latest),
+// file (/frames/file, a random listed frame), browse, readings, stats
+// (/stats/scheduler). Latency is request sent -> last body byte; "head" is
+// request sent -> status line and headers. The device serves 6 connections, so
+// -c 7 and up also measures its 503 path. Against the simulator, a card the
+// size of a long deployment comes from
+// `program --sd /tmp/sd --port 8080 --synthetic-runs 50 --synthetic-frames 500 --frame-bytes 60000`.
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int kRecvTimeoutSec = 15;
+
+using Clock = std::chrono::steady_clock;
+
+double msSince(Clock::time_point t0) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+struct Target {
+  std::string host;
+  std::string port;
+};
+
+struct Item {
+  std::string run;
+  std::string file;
+  uint64_t size = 0;
+};
+
+// ----------------- HTTP client -----------------
+struct Response {
+  int status = 0;
+  std::map<std::string, std::string> headers;  // lower-case names
+  int64_t contentLength = -1;
+  bool chunked = false;
+  bool close = false;
+
+  const std::string &header(const char *name) const {
+    static const std::string kEmpty;
+    auto it = headers.find(name);
+    return it == headers.end() ? kEmpty : it->second;
+  }
+};
+
+std::string lower(std::string s) {
+  for (char &c : s) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+  return s;
+}
+
+// One keep-alive connection, reopened when the server drops it.
+class HttpClient {
+ public:
+  HttpClient(const Target &target, const std::string &token) : target_(target), token_(token) {}
+  ~HttpClient() { disconnect(); }
+
+  // Sends the request and reads the response head; the body must be read
+  // with readBody() before the next request. A reused connection the server
+  // already closed is reopened once.
+  bool get(const std::string &target, const std::string &extraHeaders, Response &resp) {
+    std::string req = "GET " + target + " HTTP/1.1\r\nHost: " + target_.host + "\r\n";
+    if (!token_.empty()) req += "X-Auth-Token: " + token_ + "\r\n";
+    req += extraHeaders;
+    req += "\r\n";
+    for (int attempt = 0; attempt < 2; ++attempt) {
+      const bool reused = fd_ >= 0;
+      if (!reused && !connect()) return false;
+      if (sendAll(req) && readHead(resp)) return true;
+      disconnect();
+      if (!reused) return false;
+    }
+    return false;
+  }
+
+  // Streams the body to sink; false when the connection broke or sink did.
+  bool readBody(const Response &resp, const std::function<bool(const char *, size_t)> &sink) {
+    bool ok = resp.chunked ? readChunked(sink) : readLength(resp.contentLength, sink);
+    if (!ok || resp.close || (resp.contentLength < 0 && !resp.chunked)) disconnect();
+    return ok;
+  }
+
+  void disconnect() {
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+    buf_.clear();
+  }
+
+  uint32_t connects() const { return connects_; }
+
+ private:
+  bool connect() {
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *res = nullptr;
+    if (getaddrinfo(target_.host.c_str(), target_.port.c_str(), &hints, &res) != 0) return false;
+    for (addrinfo *ai = res; ai && fd_ < 0; ai = ai->ai_next) {
+      const int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+      if (fd < 0) continue;
+      timeval tv = {kRecvTimeoutSec, 0};
+      setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+      setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+      int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      if (::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+        fd_ = fd;
+      } else {
+        ::close(fd);
+      }
+    }
+    freeaddrinfo(res);
+    if (fd_ >= 0) ++connects_;
+    return fd_ >= 0;
+  }
+
+  bool sendAll(const std::string &data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+      const ssize_t n = send(fd_, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+      if (n <= 0) return false;
+      sent += static_cast<size_t>(n);
+    }
+    return true;
+  }
+
+  // Appends what the socket has to buf_; false on EOF, error or timeout.
+  bool fill() {
+    char tmp[16384];
+    const ssize_t n = recv(fd_, tmp, sizeof(tmp), 0);
+    if (n <= 0) return false;
+    buf_.append(tmp, static_cast<size_t>(n));
+    return true;
+  }
+
+  bool readLine(std::string &line) {
+    size_t eol;
+    while ((eol = buf_.find("\r\n")) == std::string::npos) {
+      if (!fill()) return false;
+    }
+    line = buf_.substr(0, eol);
+    buf_.erase(0, eol + 2);
+    return true;
+  }
+
+  bool readHead(Response &resp) {
+    resp = Response();
+    std::string line;
+    if (!readLine(line) || sscanf(line.c_str(), "HTTP/%*d.%*d %d", &resp.status) != 1) return false;
+    while (readLine(line)) {
+      if (line.empty()) {
+        resp.chunked = lower(resp.header("transfer-encoding")) == "chunked";
+        resp.close = lower(resp.header("connection")) == "close";
+        const std::string &len = resp.header("content-length");
+        if (!len.empty()) resp.contentLength = strtoll(len.c_str(), nullptr, 10);
+        return true;
+      }
+      const size_t colon = line.find(':');
+      if (colon == std::string::npos) continue;
+      size_t v = colon + 1;
+      while (v < line.size() && line[v] == ' ') ++v;
+      resp.headers[lower(line.substr(0, colon))] = line.substr(v);
+    }
+    return false;
+  }
+
+  // length < 0: until the server closes the connection.
+  bool readLength(int64_t length, const std::function<bool(const char *, size_t)> &sink) {
+    uint64_t left = length < 0 ? UINT64_MAX : static_cast<uint64_t>(length);
+    while (left > 0) {
+      if (buf_.empty() && !fill()) return length < 0;
+      const size_t n = static_cast<size_t>(std::min<uint64_t>(left, buf_.size()));
+      if (!sink(buf_.data(), n)) return false;
+      buf_.erase(0, n);
+      left -= n;
+    }
+    return true;
+  }
+
+  bool readChunked(const std::function<bool(const char *, size_t)> &sink) {
+    std::string line;
+    for (;;) {
+      if (!readLine(line)) return false;
+      const uint64_t size = strtoull(line.c_str(), nullptr, 16);
+      if (size == 0) return readLine(line);  // trailer ends with an empty line
+      if (!readLength(static_cast<int64_t>(size), sink) || !readLine(line)) return false;
+    }
+  }
+
+  const Target &target_;
+  std::string token_;
+  int fd_ = -1;
+  std::string buf_;
+  uint32_t connects_ = 0;
+};
+
+// ----------------- /frames listing -----------------
+// Reads a JSON string starting at the opening quote.
+bool jsonString(const std::string &s, size_t &pos, std::string &out) {
+  out.clear();
+  if (pos >= s.size() || s[pos] != '"') return false;
+  for (++pos; pos < s.size(); ++pos) {
+    char c = s[pos];
+    if (c == '"') {
+      ++pos;
+      return true;
+    }
+    if (c == '\\' && pos + 1 < s.size()) {
+      c = s[++pos];
+      if (c == 'n') c = '\n';
+      if (c == 't') c = '\t';
+      if (c == 'u') {  // device names are ASCII; keep the low byte
+        c = static_cast<char>(strtol(s.substr(pos + 1, 4).c_str(), nullptr, 16));
+        pos += 4;
+      }
+    }
+    out += c;
+  }
+  return false;
+}
+
+// {"items":[{"run":"..","file":"..","size":N},...],"has_more":bool}
+bool parseFrames(const std::string &json, std::vector<Item> &items, bool &hasMore) {
+  size_t pos = json.find('[', json.find("\"items\""));
+  if (pos == std::string::npos) return false;
+  Item item;
+  std::string key;
+  std::string value;
+  for (++pos;;) {
+    pos = json.find_first_of("\"]", pos);
+    if (pos == std::string::npos) return false;
+    if (json[pos] == ']') break;
+    if (!jsonString(json, pos, key) || (pos = json.find(':', pos)) == std::string::npos) return false;
+    ++pos;
+    if (key == "size") {
+      char *end = nullptr;
+      item.size = strtoull(json.c_str() + pos, &end, 10);
+      pos = static_cast<size_t>(end - json.c_str());
+      items.push_back(item);
+      item = Item();
+    } else if (jsonString(json, pos, value)) {
+      if (key == "run") item.run = value;
+      if (key == "file") item.file = value;
+    }
+  }
+  hasMore = json.find("\"has_more\":true", pos) != std::string::npos;
+  return true;
+}
+
+// Every frame on the card, a few large pages at a time.
+bool listAll(HttpClient &client, std::vector<Item> &items, std::string &error) {
+  bool hasMore = true;
+  for (int page = 1; hasMore; ++page) {
+    Response resp;
+    std::string body;
+    const std::string target = "/frames?page=" + std::to_string(page) + "&page_size=500";
+    if (!client.get(target, "", resp) || !client.readBody(resp, [&body](const char *d, size_t n) {
+          body.append(d, n);
+          return true;
+        })) {
+      error = "connection failed";
+      return false;
+    }
+    if (resp.status != 200 || !parseFrames(body, items, hasMore)) {
+      error = "GET " + target + " -> " + std::to_string(resp.status);
+      return false;
+    }
+  }
+  return true;
+}
+
+// ----------------- Load -----------------
+enum Route { kFrames, kLatest, kFile, kBrowse, kReadings, kStats, kRouteCount };
+const char *const kRouteName[kRouteCount] = {"frames", "latest", "file", "browse", "readings", "stats"};
+
+constexpr int kFramesPageSize = 50;  // the device default
+
+struct Options {
+  Target target;
+  std::string token;
+  int clients = 4;
+  int durationS = 10;
+  int weight[kRouteCount] = {3, 3, 3, 1, 0, 0};
+  std::string csvPath;
+};
+
+struct Sample {
+  uint8_t route;
+  uint16_t status;  // 0: connection failed
+  float startMs;    // since the run started
+  float headMs;
+  float totalMs;
+  uint32_t bytes;
+};
+
+// "file=6,latest=2"; routes not named get weight 0.
+bool parseMix(const char *spec, int weight[kRouteCount]) {
+  std::fill(weight, weight + kRouteCount, 0);
+  int total = 0;
+  while (*spec) {
+    const char *eq = strchr(spec, '=');
+    if (!eq) return false;
+    int route = -1;
+    for (int r = 0; r < kRouteCount; ++r) {
+      if (strlen(kRouteName[r]) == static_cast<size_t>(eq - spec) && strncmp(spec, kRouteName[r], eq - spec) == 0) {
+        route = r;
+      }
+    }
+    char *end = nullptr;
+    const long w = strtol(eq + 1, &end, 10);
+    if (route < 0 || end == eq + 1 || w < 0 || (*end && *end != ',')) return false;
+    weight[route] = static_cast<int>(w);
+    total += weight[route];
+    spec = *end ? end + 1 : end;
+  }
+  return total > 0;
+}
+
+std::string pathFor(Route route, const std::vector<Item> &items, std::mt19937 &rng) {
+  switch (route) {
+    case kFrames: {
+      const size_t pages = std::max<size_t>(1, (items.size() + kFramesPageSize - 1) / kFramesPageSize);
+      return "/frames?page=" + std::to_string(rng() % pages + 1) + "&page_size=" + std::to_string(kFramesPageSize);
+    }
+    case kLatest:
+      return "/frames/latest";
+    case kFile: {
+      const Item &item = items[rng() % items.size()];
+      return "/frames/file?run=" + item.run + "&file=" + item.file;
+    }
+    case kBrowse:
+      return "/browse";
+    case kReadings:
+      return "/readings";
+    default:
+      return "/stats/scheduler";
+  }
+}
+
+void runClient(const Options &opts, const std::vector<Item> &items, unsigned seed, Clock::time_point t0,
+               Clock::time_point deadline, std::vector<Sample> &out, uint32_t &connects) {
+  HttpClient client(opts.target, opts.token);
+  std::mt19937 rng(seed);
+  int totalWeight = 0;
+  for (int w : opts.weight) totalWeight += w;
+  while (Clock::now() < deadline) {
+    int pick = static_cast<int>(rng() % totalWeight);
+    int route = 0;
+    while (pick >= opts.weight[route]) pick -= opts.weight[route++];
+    Sample s = {};
+    s.route = static_cast<uint8_t>(route);
+    const Clock::time_point start = Clock::now();
+    s.startMs = static_cast<float>(std::chrono::duration<double, std::milli>(start - t0).count());
+    Response resp;
+    if (client.get(pathFor(static_cast<Route>(route), items, rng), "", resp)) {
+      s.headMs = static_cast<float>(msSince(start));
+      uint64_t bytes = 0;
+      if (client.readBody(resp, [&bytes](const char *, size_t n) {
+            bytes += n;
+            return true;
+          })) {
+        s.status = static_cast<uint16_t>(resp.status);
+      }
+      s.bytes = static_cast<uint32_t>(std::min<uint64_t>(bytes, UINT32_MAX));
+    }
+    s.totalMs = static_cast<float>(msSince(start));
+    out.push_back(s);
+    // Back off like a browser would when every device connection is busy.
+    if (s.status == 503 || s.status == 0) std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  }
+  connects = client.connects();
+}
+
+double percentile(std::vector<double> v, double p) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  return v[std::min(v.size() - 1, static_cast<size_t>(p / 100.0 * v.size()))];
+}
+
+void printRow(const char *name, const std::vector<Sample> &samples, int route, double seconds) {
+  std::vector<double> total;
+  std::vector<double> head;
+  uint32_t failed = 0, rejected = 0, other = 0;
+  uint64_t bytes = 0;
+  for (const Sample &s : samples) {
+    if (route >= 0 && s.route != route) continue;
+    if (s.status == 0) {
+      ++failed;
+      continue;
+    }
+    if (s.status == 503) ++rejected;
+    else if (s.status >= 300) ++other;
+    total.push_back(s.totalMs);
+    head.push_back(s.headMs);
+    bytes += s.bytes;
+  }
+  if (total.empty() && failed == 0) return;
+  printf("%-9s %7zu %7.1f %8.2f %5u %5u %5u %8.1f %8.1f %8.1f %8.1f %8.1f\n", name, total.size(),
+         total.size() / seconds, bytes / 1e6 / seconds, rejected, other, failed, percentile(head, 50),
+         percentile(total, 50), percentile(total, 95), percentile(total, 99), percentile(total, 100));
+}
+
+void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s [-c CLIENTS] [-d SECONDS] [--mix route=weight,...] [--token T] [--csv FILE] HOST[:PORT]\n"
+          "routes: frames latest file browse readings stats (default frames=3,latest=3,file=3,browse=1)\n",
+          argv0);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  Options opts;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (arg == "-c" && hasValue) {
+      opts.clients = std::max(1, atoi(argv[++i]));
+    } else if (arg == "-d" && hasValue) {
+      opts.durationS = std::max(1, atoi(argv[++i]));
+    } else if (arg == "--mix" && hasValue) {
+      if (!parseMix(argv[++i], opts.weight)) {
+        fprintf(stderr, "bad mix: %s\n", argv[i]);
+        return 2;
+      }
+    } else if (arg == "--token" && hasValue) {
+      opts.token = argv[++i];
+    } else if (arg == "--csv" && hasValue) {
+      opts.csvPath = argv[++i];
+    } else if (!arg.empty() && arg[0] != '-' && opts.target.host.empty()) {
+      const size_t colon = arg.rfind(':');
+      opts.target.host = colon == std::string::npos ? arg : arg.substr(0, colon);
+      opts.target.port = colon == std::string::npos ? "80" : arg.substr(colon + 1);
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (opts.target.host.empty()) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  std::vector<Item> items;
+  {
+    HttpClient client(opts.target, opts.token);
+    std::string error;
+    const Clock::time_point t0 = Clock::now();
+    if (!listAll(client, items, error)) {
+      fprintf(stderr, "listing frames failed: %s\n", error.c_str());
+      return 1;
+    }
+    printf("%zu frames listed in %.0f ms\n", items.size(), msSince(t0));
+  }
+  if (items.empty() && opts.weight[kFile] > 0) {
+    fprintf(stderr, "no frames on the card; drop 'file' from the mix\n");
+    return 1;
+  }
+
+  std::vector<std::vector<Sample>> perClient(opts.clients);
+  std::vector<uint32_t> connects(opts.clients);
+  const Clock::time_point t0 = Clock::now();
+  const Clock::time_point deadline = t0 + std::chrono::seconds(opts.durationS);
+  std::vector<std::thread> threads;
+  for (int c = 0; c < opts.clients; ++c) {
+    threads.emplace_back(runClient, std::cref(opts), std::cref(items), 1234u + c, t0, deadline,
+                         std::ref(perClient[c]), std::ref(connects[c]));
+  }
+  for (std::thread &t : threads) t.join();
+  const double seconds = msSince(t0) / 1000.0;
+
+  std::vector<Sample> samples;
+  uint32_t connections = 0;
+  for (int c = 0; c < opts.clients; ++c) {
+    samples.insert(samples.end(), perClient[c].begin(), perClient[c].end());
+    connections += connects[c];
+  }
+  printf("%d clients for %.1fs, %u connections\n\n", opts.clients, seconds, connections);
+  printf("%-9s %7s %7s %8s %5s %5s %5s %8s %8s %8s %8s %8s\n", "route", "done", "req/s", "MB/s", "503", "other",
+         "fail", "head p50", "p50 ms", "p95 ms", "p99 ms", "max ms");
+  for (int r = 0; r < kRouteCount; ++r) printRow(kRouteName[r], samples, r, seconds);
+  printRow("all", samples, -1, seconds);
+
+  if (!opts.csvPath.empty()) {
+    FILE *f = fopen(opts.csvPath.c_str(), "w");
+    if (!f) {
+      fprintf(stderr, "cannot write %s\n", opts.csvPath.c_str());
+      return 1;
+    }
+    fprintf(f, "route,start_ms,status,head_ms,total_ms,bytes\n");
+    for (const Sample &s : samples) {
+      fprintf(f, "%s,%.1f,%u,%.2f,%.2f,%u\n", kRouteName[s.route], s.startMs, s.status, s.headMs, s.totalMs,
+              s.bytes);
+    }
+    fclose(f);
+  }
+  return 0;
+}
@@ -0,0 +1,545 @@
+// Host tool: mirrors the runs of one or more devices into a local directory,
+// incrementally. Lists /frames, skips files already present with the same
+// size, and fetches the rest over a few keep-alive connections per device.
+// Interrupted downloads stay as <file>.part and resume with a Range request,
+// and a growing readings.csv is fetched from where the local copy ends.
+//
+//   g++ -O2 -std=gnu++17 -pthread tools/mirror.cpp -o mirror
+//   ./mirror -o archive 192.168.1.40 cam2.local     # port 80 unless host:port
+//   ./mirror -o archive -j 4 --run run_0003 192.168.1.40
+//
+// Files land in archive/<host>_<port>/<run>/<file>. The simulator serves the
+// same API, so `program --sd /tmp/sd --port 8080 --cycle-ms 200` is a local stand-in
+// for a device (start several on different ports for a fleet).
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int kRecvTimeoutSec = 15;
+constexpr int kAttempts = 4;  // per file; each one resumes the last
+
+using Clock = std::chrono::steady_clock;
+
+double msSince(Clock::time_point t0) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+struct Device {
+  std::string host;
+  std::string port;
+  std::string dir;  // archive/<host>_<port>
+};
+
+struct Item {
+  std::string run;
+  std::string file;
+  uint64_t size = 0;
+};
+
+// ----------------- HTTP client -----------------
+struct Response {
+  int status = 0;
+  std::map<std::string, std::string> headers;  // lower-case names
+  int64_t contentLength = -1;
+  bool chunked = false;
+  bool close = false;
+
+  const std::string &header(const char *name) const {
+    static const std::string kEmpty;
+    auto it = headers.find(name);
+    return it == headers.end() ? kEmpty : it->second;
+  }
+};
+
+std::string lower(std::string s) {
+  for (char &c : s) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+  return s;
+}
+
+// One keep-alive connection, reopened when the device drops it.
+class HttpClient {
+ public:
+  HttpClient(const Device &device, const std::string &token) : device_(device), token_(token) {}
+  ~HttpClient() { disconnect(); }
+
+  // Sends the request and reads the response head; the body must be read
+  // with readBody() before the next request. A reused connection the device
+  // already closed is reopened once.
+  bool get(const std::string &target, const std::string &extraHeaders, Response &resp) {
+    std::string req = "GET " + target + " HTTP/1.1\r\nHost: " + device_.host + "\r\n";
+    if (!token_.empty()) req += "X-Auth-Token: " + token_ + "\r\n";
+    req += extraHeaders;
+    req += "\r\n";
+    for (int attempt = 0; attempt < 2; ++attempt) {
+      const bool reused = fd_ >= 0;
+      if (!reused && !connect()) return false;
+      if (sendAll(req) && readHead(resp)) return true;
+      disconnect();
+      if (!reused) return false;
+    }
+    return false;
+  }
+
+  // Streams the body to sink; false when the connection broke or sink did.
+  bool readBody(const Response &resp, const std::function<bool(const char *, size_t)> &sink) {
+    bool ok = resp.chunked ? readChunked(sink) : readLength(resp.contentLength, sink);
+    if (!ok || resp.close || (resp.contentLength < 0 && !resp.chunked)) disconnect();
+    return ok;
+  }
+
+  void disconnect() {
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+    buf_.clear();
+  }
+
+  uint32_t connects() const { return connects_; }
+
+ private:
+  bool connect() {
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *res = nullptr;
+    if (getaddrinfo(device_.host.c_str(), device_.port.c_str(), &hints, &res) != 0) return false;
+    for (addrinfo *ai = res; ai && fd_ < 0; ai = ai->ai_next) {
+      const int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+      if (fd < 0) continue;
+      timeval tv = {kRecvTimeoutSec, 0};
+      setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+      setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+      int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      if (::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+        fd_ = fd;
+      } else {
+        ::close(fd);
+      }
+    }
+    freeaddrinfo(res);
+    if (fd_ >= 0) ++connects_;
+    return fd_ >= 0;
+  }
+
+  bool sendAll(const std::string &data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+      const ssize_t n = send(fd_, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+      if (n <= 0) return false;
+      sent += static_cast<size_t>(n);
+    }
+    return true;
+  }
+
+  // Appends what the socket has to buf_; false on EOF, error or timeout.
+  bool fill() {
+    char tmp[16384];
+    const ssize_t n = recv(fd_, tmp, sizeof(tmp), 0);
+    if (n <= 0) return false;
+    buf_.append(tmp, static_cast<size_t>(n));
+    return true;
+  }
+
+  bool readLine(std::string &line) {
+    size_t eol;
+    while ((eol = buf_.find("\r\n")) == std::string::npos) {
+      if (!fill()) return false;
+    }
+    line = buf_.substr(0, eol);
+    buf_.erase(0, eol + 2);
+    return true;
+  }
+
+  bool readHead(Response &resp) {
+    resp = Response();
+    std::string line;
+    if (!readLine(line) || sscanf(line.c_str(), "HTTP/%*d.%*d %d", &resp.status) != 1) return false;
+    while (readLine(line)) {
+      if (line.empty()) {
+        resp.chunked = lower(resp.header("transfer-encoding")) == "chunked";
+        resp.close = lower(resp.header("connection")) == "close";
+        const std::string &len = resp.header("content-length");
+        if (!len.empty()) resp.contentLength = strtoll(len.c_str(), nullptr, 10);
+        return true;
+      }
+      const size_t colon = line.find(':');
+      if (colon == std::string::npos) continue;
+      size_t v = colon + 1;
+      while (v < line.size() && line[v] == ' ') ++v;
+      resp.headers[lower(line.substr(0, colon))] = line.substr(v);
+    }
+    return false;
+  }
+
+  // length < 0: until the device closes the connection.
+  bool readLength(int64_t length, const std::function<bool(const char *, size_t)> &sink) {
+    uint64_t left = length < 0 ? UINT64_MAX : static_cast<uint64_t>(length);
+    while (left > 0) {
+      if (buf_.empty() && !fill()) return length < 0;
+      const size_t n = static_cast<size_t>(std::min<uint64_t>(left, buf_.size()));
+      if (!sink(buf_.data(), n)) return false;
+      buf_.erase(0, n);
+      left -= n;
+    }
+    return true;
+  }
+
+  bool readChunked(const std::function<bool(const char *, size_t)> &sink) {
+    std::string line;
+    for (;;) {
+      if (!readLine(line)) return false;
+      const uint64_t size = strtoull(line.c_str(), nullptr, 16);
+      if (size == 0) return readLine(line);  // trailer ends with an empty line
+      if (!readLength(static_cast<int64_t>(size), sink) || !readLine(line)) return false;
+    }
+  }
+
+  const Device &device_;
+  std::string token_;
+  int fd_ = -1;
+  std::string buf_;
+  uint32_t connects_ = 0;
+};
+
+// ----------------- /frames listing -----------------
+// Reads a JSON string starting at the opening quote.
+bool jsonString(const std::string &s, size_t &pos, std::string &out) {
+  out.clear();
+  if (pos >= s.size() || s[pos] != '"') return false;
+  for (++pos; pos < s.size(); ++pos) {
+    char c = s[pos];
+    if (c == '"') {
+      ++pos;
+      return true;
+    }
+    if (c == '\\' && pos + 1 < s.size()) {
+      c = s[++pos];
+      if (c == 'n') c = '\n';
+      if (c == 't') c = '\t';
+      if (c == 'u') {  // device names are ASCII; keep the low byte
+        c = static_cast<char>(strtol(s.substr(pos + 1, 4).c_str(), nullptr, 16));
+        pos += 4;
+      }
+    }
+    out += c;
+  }
+  return false;
+}
+
+// {"items":[{"run":"..","file":"..","size":N},...],"has_more":bool}
+bool parseFrames(const std::string &json, std::vector<Item> &items, bool &hasMore) {
+  size_t pos = json.find('[', json.find("\"items\""));
+  if (pos == std::string::npos) return false;
+  Item item;
+  std::string key;
+  std::string value;
+  for (++pos;;) {
+    pos = json.find_first_of("\"]", pos);
+    if (pos == std::string::npos) return false;
+    if (json[pos] == ']') break;
+    if (!jsonString(json, pos, key) || (pos = json.find(':', pos)) == std::string::npos) return false;
+    ++pos;
+    if (key == "size") {
+      char *end = nullptr;
+      item.size = strtoull(json.c_str() + pos, &end, 10);
+      pos = static_cast<size_t>(end - json.c_str());
+      items.push_back(item);
+      item = Item();
+    } else if (jsonString(json, pos, value)) {
+      if (key == "run") item.run = value;
+      if (key == "file") item.file = value;
+    }
+  }
+  hasMore = json.find("\"has_more\":true", pos) != std::string::npos;
+  return true;
+}
+
+bool listFrames(HttpClient &client, int pageSize, std::vector<Item> &items, std::string &error) {
+  bool hasMore = true;
+  for (int page = 1; hasMore; ++page) {
+    Response resp;
+    std::string body;
+    const std::string target = "/frames?page=" + std::to_string(page) + "&page_size=" + std::to_string(pageSize);
+    if (!client.get(target, "", resp) || !client.readBody(resp, [&body](const char *d, size_t n) {
+          body.append(d, n);
+          return true;
+        })) {
+      error = "connection failed";
+      return false;
+    }
+    if (resp.status != 200 || !parseFrames(body, items, hasMore)) {
+      error = "GET " + target + " -> " + std::to_string(resp.status);
+      return false;
+    }
+  }
+  return true;
+}
+
+// ----------------- Local files -----------------
+bool makeDirs(const std::string &path) {
+  for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+    const std::string dir = path.substr(0, slash);
+    if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) return false;
+    if (slash == std::string::npos) return true;
+  }
+}
+
+int64_t fileSize(const std::string &path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 ? static_cast<int64_t>(st.st_size) : -1;
+}
+
+bool endsWith(const std::string &s, const char *suffix) {
+  const size_t n = strlen(suffix);
+  return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+// ----------------- Mirroring -----------------
+struct Stats {
+  std::mutex mutex;
+  uint32_t listed = 0;
+  uint32_t skipped = 0;
+  uint32_t fetched = 0;
+  uint32_t resumed = 0;
+  uint32_t failed = 0;
+  uint32_t requests = 0;
+  uint32_t connections = 0;
+  uint64_t bytes = 0;
+  std::vector<double> headMs;  // request sent -> response head read
+  std::vector<double> fileMs;  // whole file, retries included
+};
+
+enum class Fetch { kDone, kResumed, kFailed };
+
+constexpr uint64_t kUnknownLength = UINT64_MAX;  // chunked 200
+
+Fetch fetchFile(HttpClient &client, const Device &device, const Item &item, Stats &stats) {
+  const std::string dir = device.dir + "/" + item.run;
+  const std::string path = dir + "/" + item.file;
+  const std::string part = path + ".part";
+  if (!makeDirs(dir)) return Fetch::kFailed;
+  // readings.csv only grows, so a shorter copy is a prefix worth keeping.
+  const int64_t existing = fileSize(path);
+  if (fileSize(part) < 0 && existing >= 0 && endsWith(item.file, ".csv")) rename(path.c_str(), part.c_str());
+
+  bool resumed = false;
+  for (int attempt = 0; attempt < kAttempts; ++attempt) {
+    int64_t have = std::max<int64_t>(fileSize(part), 0);
+    std::string range;
+    if (have > 0) range = "Range: bytes=" + std::to_string(have) + "-\r\n";
+    const std::string target = "/frames/file?run=" + item.run + "&file=" + item.file;
+    const Clock::time_point t0 = Clock::now();
+    Response resp;
+    const bool sent = client.get(target, range, resp);
+    {
+      std::lock_guard<std::mutex> lock(stats.mutex);
+      ++stats.requests;
+      if (sent) stats.headMs.push_back(msSince(t0));
+    }
+    if (!sent) continue;
+
+    uint64_t total = 0;
+    const char *mode = "wb";
+    if (resp.status == 206) {
+      unsigned long long first = 0, last = 0, size = 0;
+      if (sscanf(resp.header("content-range").c_str(), "bytes %llu-%llu/%llu", &first, &last, &size) != 3 ||
+          first != static_cast<unsigned long long>(have)) {
+        client.disconnect();
+        remove(part.c_str());
+        continue;
+      }
+      total = size;
+      mode = "ab";
+      resumed = true;
+    } else if (resp.status == 200) {
+      total = resp.contentLength >= 0 ? static_cast<uint64_t>(resp.contentLength) : kUnknownLength;
+      have = 0;
+    } else {
+      // 416: the part is longer than the file now; 503: all device
+      // connections busy. Drain the body and try again.
+      client.readBody(resp, [](const char *, size_t) { return true; });
+      if (resp.status == 416) remove(part.c_str());
+      if (resp.status == 503) std::this_thread::sleep_for(std::chrono::seconds(1));
+      if (resp.status == 404) return Fetch::kFailed;
+      continue;
+    }
+
+    FILE *out = fopen(part.c_str(), mode);
+    if (!out) return Fetch::kFailed;
+    uint64_t received = 0;
+    const bool ok = client.readBody(resp, [&](const char *d, size_t n) {
+      received += n;
+      return fwrite(d, 1, n, out) == n;
+    });
+    fclose(out);
+    {
+      std::lock_guard<std::mutex> lock(stats.mutex);
+      stats.bytes += received;
+    }
+    if (ok && (total == kUnknownLength || static_cast<uint64_t>(have) + received == total) && rename(part.c_str(), path.c_str()) == 0) {
+      return resumed ? Fetch::kResumed : Fetch::kDone;
+    }
+  }
+  return Fetch::kFailed;
+}
+
+struct Options {
+  std::string outDir;
+  std::string token;
+  std::string onlyRun;
+  int jobs = 3;  // the device serves 6 connections; leave room for others
+  int pageSize = 200;
+  std::vector<Device> devices;
+};
+
+void mirrorDevice(const Options &opts, const Device &device, Stats &stats) {
+  std::vector<Item> items;
+  {
+    HttpClient client(device, opts.token);
+    std::string error;
+    if (!listFrames(client, opts.pageSize, items, error)) {
+      fprintf(stderr, "%s:%s: listing failed: %s\n", device.host.c_str(), device.port.c_str(), error.c_str());
+      std::lock_guard<std::mutex> lock(stats.mutex);
+      ++stats.failed;
+      stats.connections += client.connects();
+      return;
+    }
+    std::lock_guard<std::mutex> lock(stats.mutex);
+    stats.connections += client.connects();
+  }
+
+  std::vector<Item> todo;
+  uint32_t listed = 0, skipped = 0;
+  for (const Item &item : items) {
+    if (!opts.onlyRun.empty() && item.run != opts.onlyRun) continue;
+    // Names come from the device; refuse anything that would leave the archive.
+    if (item.run.find('/') != std::string::npos || item.file.find('/') != std::string::npos ||
+        item.run.empty() || item.file.empty() || item.run[0] == '.' || item.file[0] == '.') {
+      continue;
+    }
+    ++listed;
+    if (fileSize(device.dir + "/" + item.run + "/" + item.file) == static_cast<int64_t>(item.size)) {
+      ++skipped;
+    } else {
+      todo.push_back(item);
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(stats.mutex);
+    stats.listed += listed;
+    stats.skipped += skipped;
+  }
+
+  std::atomic<size_t> next{0};
+  std::vector<std::thread> workers;
+  for (int w = 0; w < opts.jobs; ++w) {
+    workers.emplace_back([&]() {
+      HttpClient client(device, opts.token);
+      for (size_t i = next++; i < todo.size(); i = next++) {
+        const Clock::time_point t0 = Clock::now();
+        const Fetch result = fetchFile(client, device, todo[i], stats);
+        std::lock_guard<std::mutex> lock(stats.mutex);
+        stats.fileMs.push_back(msSince(t0));
+        if (result == Fetch::kFailed) {
+          ++stats.failed;
+          fprintf(stderr, "%s:%s: %s/%s failed\n", device.host.c_str(), device.port.c_str(), todo[i].run.c_str(),
+                  todo[i].file.c_str());
+        } else {
+          ++stats.fetched;
+          if (result == Fetch::kResumed) ++stats.resumed;
+        }
+      }
+      std::lock_guard<std::mutex> lock(stats.mutex);
+      stats.connections += client.connects();
+    });
+  }
+  for (std::thread &t : workers) t.join();
+}
+
+double percentile(std::vector<double> v, double p) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  return v[std::min(v.size() - 1, static_cast<size_t>(p / 100.0 * v.size()))];
+}
+
+void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s -o DIR [-j CONNECTIONS] [--token T] [--run RUN] [--page-size N] HOST[:PORT]...\n"
+          "  -j           parallel connections per device (default 3)\n",
+          argv0);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  Options opts;
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (arg == "-o" && hasValue) {
+      opts.outDir = argv[++i];
+    } else if (arg == "-j" && hasValue) {
+      opts.jobs = std::max(1, atoi(argv[++i]));
+    } else if (arg == "--token" && hasValue) {
+      opts.token = argv[++i];
+    } else if (arg == "--run" && hasValue) {
+      opts.onlyRun = argv[++i];
+    } else if (arg == "--page-size" && hasValue) {
+      opts.pageSize = std::max(1, atoi(argv[++i]));
+    } else if (!arg.empty() && arg[0] != '-') {
+      Device d;
+      const size_t colon = arg.rfind(':');
+      d.host = colon == std::string::npos ? arg : arg.substr(0, colon);
+      d.port = colon == std::string::npos ? "80" : arg.substr(colon + 1);
+      opts.devices.push_back(d);
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (opts.outDir.empty() || opts.devices.empty()) {
+    usage(argv[0]);
+    return 2;
+  }
+  for (Device &d : opts.devices) d.dir = opts.outDir + "/" + d.host + "_" + d.port;
+
+  Stats stats;
+  const Clock::time_point t0 = Clock::now();
+  std::vector<std::thread> devices;
+  for (const Device &d : opts.devices) devices.emplace_back(mirrorDevice, std::cref(opts), std::cref(d), std::ref(stats));
+  for (std::thread &t : devices) t.join();
+  const double seconds = msSince(t0) / 1000.0;
+
+  printf("%zu device(s): %u files listed, %u unchanged, %u fetched (%u resumed), %u failed\n", opts.devices.size(),
+         stats.listed, stats.skipped, stats.fetched, stats.resumed, stats.failed);
+  printf("%.1f MB in %.2fs: %.2f MB/s, %.1f files/s; %u requests over %u connections\n", stats.bytes / 1e6, seconds,
+         stats.bytes / 1e6 / seconds, stats.fetched / seconds, stats.requests, stats.connections);
+  if (!stats.headMs.empty()) {
+    printf("response head ms: p50 %.1f  p95 %.1f  p99 %.1f  max %.1f\n", percentile(stats.headMs, 50),
+           percentile(stats.headMs, 95), percentile(stats.headMs, 99), percentile(stats.headMs, 100));
+    printf("file ms:          p50 %.1f  p95 %.1f  p99 %.1f  max %.1f\n", percentile(stats.fileMs, 50),
+           percentile(stats.fileMs, 95), percentile(stats.fileMs, 99), percentile(stats.fileMs, 100));
+  }
+  return stats.failed ? 1 : 0;
+}
@@ -0,0 +1,318 @@
+// Replays a sensor trace through the firmware's SampleSmoother and
+// SamplingPolicy (src/sampling_policy.h): the trace is sampled only when the
+// policy would have read the DHT11, so the output shows which cycle it picks,
+// when it speeds up, and how many readings and frames that costs against the
+// fixed cycle.
+//
+//   g++ -O2 -std=gnu++17 -Isrc tools/sampling_replay.cpp src/sampling_policy.cpp -o sampling_replay
+//   ./sampling_replay --selftest                      # built-in scenarios, exit 1 on a failed check
+//   ./sampling_replay /data/run_0003/readings.csv -v  # a recorded run
+//   ./sampling_replay greenhouse.txt --step-ms 10000 --limits dt=1,t_hi=35 --expect-fast 5400,9000
+//
+// Traces are either readings.csv (runId,readingIdx,ms,tempC,hum) or the
+// simulator's --sensor script (one "tempC,hum" or "fail" per line, --step-ms
+// apart). readings.csv holds smoothed values, which get smoothed once more
+// here; record at the fast cycle for a faithful replay.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "sampling_policy.h"
+
+namespace {
+
+// kMinCycleMs / kMaxCycleMs in src/app.cpp.
+constexpr uint32_t kFloorMs = 5000;
+constexpr uint32_t kCeilMs = 600000;
+
+struct Point {
+  uint64_t ms;
+  int temp;
+  int hum;
+};
+
+struct Options {
+  uint32_t baseMs = 30000;
+  uint32_t stepMs = 5000;
+  // A change can start just after a reading and show through the smoother
+  // only on the next one; 0 allows two slow cycles.
+  uint32_t withinMs = 0;
+  SamplingPolicy::Limits limits;
+  std::vector<uint64_t> expectFastMs;
+  long maxReadings = -1;
+  bool verbose = false;
+};
+
+struct Result {
+  uint32_t readings = 0;
+  uint32_t fixedReadings = 0;
+  uint64_t fastMs = 0;  // time spent at the fast cycle
+  SamplingPolicy::Stats stats;
+  std::vector<std::pair<uint64_t, uint32_t>> changes;  // when, new cycle
+};
+
+bool loadTrace(const char *path, uint32_t stepMs, std::vector<Point> &out) {
+  FILE *f = fopen(path, "r");
+  if (!f) return false;
+  char line[256];
+  uint64_t ms = 0;
+  while (fgets(line, sizeof(line), f)) {
+    if (line[0] == '#' || line[0] == '\n') continue;
+    unsigned run = 0, idx = 0;
+    unsigned long long at = 0;
+    Point p;
+    if (sscanf(line, "%u,%u,%llu,%d,%d", &run, &idx, &at, &p.temp, &p.hum) == 5) {
+      p.ms = at;
+      out.push_back(p);
+    } else if (sscanf(line, "%d,%d", &p.temp, &p.hum) == 2) {
+      p.ms = ms;
+      out.push_back(p);
+    }
+    // "fail" lines and headers still take a slot in a sensor script.
+    ms += stepMs;
+  }
+  fclose(f);
+  return !out.empty();
+}
+
+// Same order as sensorJob(): smooth, then ask the policy.
+Result replay(const std::vector<Point> &trace, const Options &opt) {
+  Result r;
+  SampleSmoother smoother;
+  SamplingPolicy policy(kFloorMs, kCeilMs);
+  policy.reset(opt.baseMs, opt.limits);
+  const uint64_t start = trace.front().ms;
+  const uint64_t end = trace.back().ms;
+  r.fixedReadings = static_cast<uint32_t>((end - start) / policy.periodMs());
+  size_t i = 0;
+  for (uint64_t now = start + policy.periodMs(); now <= end;) {
+    while (i + 1 < trace.size() && trace[i + 1].ms <= now) ++i;
+    smoother.add(trace[i].temp, trace[i].hum);
+    const uint32_t before = policy.periodMs();
+    const uint32_t cycle = policy.update(now - start, smoother.avgTemp(), smoother.avgHum());
+    ++r.readings;
+    if (cycle != before) {
+      r.changes.emplace_back(now - start, cycle);
+      if (opt.verbose) {
+        printf("  %7.0fs  T=%d H=%d  dT=%+.2f/min dH=%+.2f/min  %lu -> %lu ms (%s)\n", (now - start) / 1000.0,
+               smoother.avgTemp(), smoother.avgHum(), policy.stats().tempRate, policy.stats().humRate,
+               static_cast<unsigned long>(before), static_cast<unsigned long>(cycle),
+               SamplingPolicy::kReasonName[policy.stats().reason]);
+      }
+    }
+    if (cycle == policy.fastMs()) r.fastMs += cycle;
+    now += cycle;
+  }
+  r.stats = policy.stats();
+  return r;
+}
+
+// The cycle in force at t (ms from the start of the trace).
+uint32_t cycleAt(const Result &r, uint64_t t, uint32_t baseMs) {
+  uint32_t cycle = baseMs;
+  for (const auto &c : r.changes) {
+    if (c.first > t) break;
+    cycle = c.second;
+  }
+  return cycle;
+}
+
+// Prints the summary and runs the checks; returns false when one fails.
+bool report(const char *name, const std::vector<Point> &trace, const Options &opt) {
+  if (opt.verbose) printf("%s\n", name);
+  const Result r = replay(trace, opt);
+  const SamplingPolicy::Stats &s = r.stats;
+  const double hours = (trace.back().ms - trace.front().ms) / 3.6e6;
+  printf("%-14s %6.1fh  readings %6u (fixed %ums: %6u, %5.1f%%)  fast %5.1f%%  up %3u  down %3u"
+         "  rate/step/band %u/%u/%u\n",
+         name, hours, r.readings, opt.baseMs, r.fixedReadings,
+         r.fixedReadings ? 100.0 * r.readings / r.fixedReadings : 0.0,
+         hours > 0 ? 100.0 * r.fastMs / (hours * 3.6e6) : 0.0, s.speedUps, s.backoffs, s.rateTriggers,
+         s.stepTriggers, s.bandTriggers);
+
+  bool ok = true;
+  SamplingPolicy bounds(kFloorMs, kCeilMs);
+  bounds.reset(opt.baseMs, opt.limits);
+  for (const auto &c : r.changes) {
+    if (c.second < bounds.fastMs() || c.second > bounds.slowMs()) {
+      printf("  FAIL: cycle %lu ms at %.0fs outside [%lu, %lu]\n", static_cast<unsigned long>(c.second),
+             c.first / 1000.0, static_cast<unsigned long>(bounds.fastMs()),
+             static_cast<unsigned long>(bounds.slowMs()));
+      ok = false;
+    }
+  }
+  const uint32_t within = opt.withinMs ? opt.withinMs : 2 * bounds.slowMs();
+  for (uint64_t at : opt.expectFastMs) {
+    uint64_t reached = 0;
+    for (const auto &c : r.changes) {
+      if (c.first >= at && c.second == bounds.fastMs()) {
+        reached = c.first;
+        break;
+      }
+    }
+    // Already fast when the change started counts too.
+    if (cycleAt(r, at, opt.baseMs) == bounds.fastMs()) reached = at;
+    if (!reached || reached - at > within) {
+      printf("  FAIL: not at the fast cycle within %lus of %.0fs\n", static_cast<unsigned long>(within / 1000),
+             at / 1000.0);
+      ok = false;
+    } else if (opt.verbose) {
+      printf("  fast %.0fs after %.0fs\n", (reached - at) / 1000.0, at / 1000.0);
+    }
+  }
+  if (opt.maxReadings >= 0 && r.readings > opt.maxReadings) {
+    printf("  FAIL: %u readings, expected at most %ld\n", r.readings, opt.maxReadings);
+    ok = false;
+  }
+  return ok;
+}
+
+// ----------------- Built-in scenarios -----------------
+// Synthetic, DHT11-like traces (whole degrees and percent, +-1 count of
+// noise), one point every 5s.
+
+constexpr uint32_t kTraceStepMs = 5000;
+
+uint32_t gNoise = 12345;
+int noise() {
+  gNoise = gNoise * 1103515245u + 12345u;
+  const uint32_t r = (gNoise >> 16) % 10;
+  return r == 0 ? -1 : (r == 9 ? 1 : 0);
+}
+
+template <typename Fn>
+std::vector<Point> synth(double hours, Fn fn) {
+  std::vector<Point> out;
+  gNoise = 12345;
+  for (uint64_t ms = 0; ms <= static_cast<uint64_t>(hours * 3.6e6); ms += kTraceStepMs) {
+    double t = 0, h = 0;
+    fn(ms / 1000.0, t, h);
+    out.push_back(Point{ms, static_cast<int>(std::lround(t)) + noise(), static_cast<int>(std::lround(h)) + noise()});
+  }
+  return out;
+}
+
+// Moves from a to b over rampS seconds starting at startS.
+double ramp(double s, double startS, double rampS, double a, double b) {
+  if (s <= startS) return a;
+  if (s >= startS + rampS) return b;
+  return a + (b - a) * (s - startS) / rampS;
+}
+
+bool selftest(const Options &base) {
+  bool ok = true;
+  Options opt = base;
+
+  // Nothing happens: the cycle should settle at the slow end.
+  opt.maxReadings = 150;
+  ok &= report("steady", synth(12, [](double, double &t, double &h) {
+                 t = 21;
+                 h = 45;
+               }), opt);
+
+  // A door opens at 3h: 8C colder within 5 minutes, back after 20.
+  opt = base;
+  opt.expectFastMs = {3 * 3600 * 1000ULL};
+  ok &= report("door", synth(6, [](double s, double &t, double &h) {
+                 t = ramp(s, 3 * 3600, 300, 22, 14);
+                 if (s > 3 * 3600 + 1500) t = ramp(s, 3 * 3600 + 1500, 900, 14, 22);
+                 h = 50;
+               }), opt);
+
+  // A shower next door at 2h: humidity +30% in 3 minutes, decaying over an hour.
+  opt = base;
+  opt.expectFastMs = {2 * 3600 * 1000ULL};
+  ok &= report("humidity", synth(5, [](double s, double &t, double &h) {
+                 t = 20;
+                 h = s < 2 * 3600 + 180 ? ramp(s, 2 * 3600, 180, 45, 75) : ramp(s, 2 * 3600 + 180, 3600, 75, 45);
+               }), opt);
+
+  // A day's swing of 10C: slow enough to stay off the fast cycle most of
+  // the time.
+  opt = base;
+  opt.maxReadings = 400;
+  ok &= report("diurnal", synth(24, [](double s, double &t, double &h) {
+                 t = 18 + 5 * std::sin(s / 86400.0 * 2 * M_PI);
+                 h = 55 - 10 * std::sin(s / 86400.0 * 2 * M_PI);
+               }), opt);
+
+  // A slow climb over 30C with t_hi=30: fast once the band is left, however
+  // slowly it got there.
+  opt = base;
+  opt.limits.tempHigh = 30;
+  opt.expectFastMs = {static_cast<uint64_t>((4 * 3600 + 3600.0 * 8.5 / 10) * 1000)};
+  ok &= report("band", synth(8, [](double s, double &t, double &h) {
+                 t = ramp(s, 4 * 3600, 3600, 22, 32);
+                 h = 40;
+               }), opt);
+
+  printf(ok ? "all scenarios passed\n" : "some checks FAILED\n");
+  return ok;
+}
+
+void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s (--selftest | TRACE) [--cycle-ms N] [--step-ms N] [--limits SPEC] [--expect-fast S[,S...]]\n"
+          "          [--within-s N] [--max-readings N] [-v]\n",
+          argv0);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  Options opt;
+  const char *tracePath = nullptr;
+  bool self = false;
+  for (int i = 1; i < argc; ++i) {
+    const char *a = argv[i];
+    if (strcmp(a, "--selftest") == 0) {
+      self = true;
+    } else if (strcmp(a, "-v") == 0) {
+      opt.verbose = true;
+    } else if (a[0] == '-' && i + 1 < argc) {
+      const char *v = argv[++i];
+      if (strcmp(a, "--cycle-ms") == 0) opt.baseMs = static_cast<uint32_t>(strtoul(v, nullptr, 10));
+      else if (strcmp(a, "--step-ms") == 0) opt.stepMs = static_cast<uint32_t>(strtoul(v, nullptr, 10));
+      else if (strcmp(a, "--within-s") == 0) opt.withinMs = static_cast<uint32_t>(strtoul(v, nullptr, 10) * 1000);
+      else if (strcmp(a, "--max-readings") == 0) opt.maxReadings = strtol(v, nullptr, 10);
+      else if (strcmp(a, "--limits") == 0) {
+        if (!opt.limits.parse(v)) {
+          fprintf(stderr, "bad limits: %s\n", v);
+          return 2;
+        }
+      } else if (strcmp(a, "--expect-fast") == 0) {
+        for (char *p = const_cast<char *>(v); *p;) {
+          opt.expectFastMs.push_back(static_cast<uint64_t>(strtod(p, &p) * 1000));
+          if (*p == ',') ++p;
+          else if (*p) break;
+        }
+      } else {
+        usage(argv[0]);
+        return 2;
+      }
+    } else if (a[0] != '-' && !tracePath) {
+      tracePath = a;
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (opt.baseMs < kFloorMs || opt.baseMs > kCeilMs || opt.stepMs == 0 || (!self && !tracePath)) {
+    usage(argv[0]);
+    return 2;
+  }
+  printf("limits %s\n", opt.limits.format().c_str());
+  if (self) return selftest(opt) ? 0 : 1;
+
+  std::vector<Point> trace;
+  if (!loadTrace(tracePath, opt.stepMs, trace)) {
+    fprintf(stderr, "%s: no readings\n", tracePath);
+    return 2;
+  }
+  return report(tracePath, trace, opt) ? 0 : 1;
+}
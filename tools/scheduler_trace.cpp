@@ -0,0 +1,324 @@
+// Drives the firmware's timer wheel (src/scheduler.h) with a virtual clock
+// the way appLoop() does: run what is due, then wait until the next deadline
+// or an HTTP wake-up, whichever comes first. Jobs take a fixed time to run,
+// so late starts, missed periods and re-anchoring show up as on the device.
+//
+//   g++ -O2 -std=gnu++17 -Isrc tools/scheduler_trace.cpp src/scheduler.cpp -o scheduler_trace
+//   ./scheduler_trace --selftest                          # built-in checks, exit 1 on a failure
+//   ./scheduler_trace --job capture:30000:800 --job sensor:30000:30 --wake-ms 250 --seconds 3600
+//
+// --wake-ms makes the loop come round at least that often, like HTTP
+// traffic does; -v prints every run.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "scheduler.h"
+
+namespace {
+
+struct JobSpec {
+  std::string name;
+  uint32_t periodMs = 0;
+  uint32_t runMs = 0;
+  uint32_t firstDelayMs = 0;
+};
+
+struct Run {
+  int id;
+  uint64_t startMs;
+};
+
+// One scheduler on a virtual clock. Jobs advance the clock by their run time.
+struct Sim {
+  Scheduler sched;
+  uint64_t now = 0;
+  std::vector<Run> runs;
+  std::deque<std::string> names;  // keeps JobStats::name valid
+  bool verbose = false;
+
+  int add(const JobSpec &spec, std::function<void(int)> hook = nullptr) {
+    names.push_back(spec.name);
+    const int id = static_cast<int>(sched.jobCount());
+    const uint32_t runMs = spec.runMs;
+    return sched.addPeriodic(names.back().c_str(), spec.periodMs, spec.firstDelayMs, now, [this, id, runMs, hook] {
+      runs.push_back(Run{id, now});
+      if (verbose) printf("%10llu  %s\n", static_cast<unsigned long long>(now), sched.stats(id).name);
+      if (hook) hook(id);
+      now += runMs;
+    });
+  }
+
+  void pass() {
+    sched.runDue(now, [this] { return now; });
+  }
+
+  // appLoop() up to and including endMs: run what is due, then sleep until
+  // the next deadline, at most wakeMs.
+  void runUntil(uint64_t endMs, uint32_t wakeMs) {
+    while (true) {
+      pass();
+      if (now >= endMs) break;
+      uint64_t wait = sched.msUntilNext(now);
+      if (wakeMs && wait > wakeMs) wait = wakeMs;
+      if (wait == 0) wait = 1;  // due during the pass: the next one runs it
+      now = now + wait < endMs ? now + wait : endMs;
+    }
+  }
+
+  std::vector<uint64_t> startsOf(int id) const {
+    std::vector<uint64_t> out;
+    for (const Run &r : runs) {
+      if (r.id == id) out.push_back(r.startMs);
+    }
+    return out;
+  }
+};
+
+bool check(bool cond, const char *scenario, const char *what) {
+  if (!cond) printf("  FAILED %s: %s\n", scenario, what);
+  return cond;
+}
+
+// Every start exactly `period` after the previous one, the first at `first`.
+bool evenlySpaced(const std::vector<uint64_t> &starts, uint64_t first, uint64_t period) {
+  for (size_t i = 0; i < starts.size(); ++i) {
+    if (starts[i] != first + i * period) return false;
+  }
+  return !starts.empty();
+}
+
+void printStats(const char *title, const Sim &sim) {
+  printf("%s\n", title);
+  printf("  %-10s %8s %8s %8s %10s %10s\n", "job", "period", "runs", "missed", "maxjit_ms", "lastrun_ms");
+  for (size_t i = 0; i < sim.sched.jobCount(); ++i) {
+    const Scheduler::JobStats &s = sim.sched.stats(static_cast<int>(i));
+    printf("  %-10s %8lu %8lu %8lu %10lu %10lu\n", s.name, static_cast<unsigned long>(s.periodMs),
+           static_cast<unsigned long>(s.runs), static_cast<unsigned long>(s.missed),
+           static_cast<unsigned long>(s.maxJitterMs), static_cast<unsigned long>(s.lastDurationMs));
+  }
+}
+
+bool selftest(bool verbose) {
+  bool ok = true;
+
+  {
+    // Each job on its deadline, never drifting.
+    const char *name = "order";
+    Sim sim;
+    sim.verbose = verbose;
+    const int a = sim.add({"a", 100, 0, 100});
+    const int b = sim.add({"b", 250, 0, 250});
+    const int c = sim.add({"c", 1000, 0, 1000});
+    sim.runUntil(10000, 0);
+    ok &= check(evenlySpaced(sim.startsOf(a), 100, 100) && sim.startsOf(a).size() == 100, name, "a every 100ms");
+    ok &= check(evenlySpaced(sim.startsOf(b), 250, 250) && sim.startsOf(b).size() == 40, name, "b every 250ms");
+    ok &= check(evenlySpaced(sim.startsOf(c), 1000, 1000) && sim.startsOf(c).size() == 10, name, "c every 1s");
+    ok &= check(sim.sched.stats(a).maxJitterMs == 0 && sim.sched.stats(c).missed == 0, name, "no jitter");
+    printStats(name, sim);
+
+    // Deadlines that share a pass (and here a wheel slot) run in deadline
+    // order, whatever order they were added in.
+    Sim tick;
+    const int late = tick.add({"late", 1000, 1, 1007});
+    const int first = tick.add({"first", 1000, 1, 1001});
+    const int mid = tick.add({"mid", 1000, 1, 1004});
+    tick.now = 1009;
+    tick.pass();
+    ok &= check(tick.runs.size() == 3 && tick.runs[0].id == first && tick.runs[1].id == mid && tick.runs[2].id == late,
+                name, "one pass runs in deadline order");
+  }
+
+  {
+    // Periods longer than the wheel (64 slots of 10ms) wrap around it several
+    // times: each must fire on its deadline, not when its slot first comes
+    // round, whether the loop polls every tick or sleeps between deadlines.
+    const char *name = "wrap";
+    for (uint32_t wake : {0u, 10u, 7u}) {
+      Sim sim;
+      sim.verbose = verbose;
+      const int slow = sim.add({"slow", 5000, 0, 5000});
+      const int edge = sim.add({"edge", Scheduler::kSlots * Scheduler::kTickMs, 0, 640});
+      const int odd = sim.add({"odd", 655, 0, 655});
+      sim.runUntil(60000, wake);
+      ok &= check(evenlySpaced(sim.startsOf(slow), 5000, 5000) && sim.startsOf(slow).size() == 12, name,
+                  "5s job on time across wraps");
+      ok &= check(evenlySpaced(sim.startsOf(edge), 640, 640) && sim.startsOf(edge).size() == 93, name,
+                  "period of exactly one wheel turn");
+      // Its deadlines fall inside ticks and move through every slot.
+      ok &= check(evenlySpaced(sim.startsOf(odd), 655, 655) && sim.startsOf(odd).size() == 91, name,
+                  "655ms job on time");
+      if (wake == 0) printStats(name, sim);
+    }
+  }
+
+  {
+    // The loop oversleeps by 10s (a long handler, a debugger): each job runs
+    // once, the skipped periods are counted, and the next run is one period
+    // after the late one instead of a burst of catch-ups.
+    const char *name = "oversleep";
+    Sim sim;
+    sim.verbose = verbose;
+    const int fast = sim.add({"fast", 100, 5, 100});
+    const int slow = sim.add({"slow", 3000, 0, 3000});
+    sim.now = 10050;
+    sim.pass();
+    ok &= check(sim.startsOf(fast).size() == 1 && sim.startsOf(slow).size() == 1, name, "one run each");
+    // fast was due at 100; its next deadline 200 had passed by the end
+    // (10050 + 5 for fast, fast runs first): (10055 - 200) / 100 + 1 = 99.
+    ok &= check(sim.sched.stats(fast).missed == 99, name, "fast missed 99 periods");
+    ok &= check(sim.sched.stats(slow).missed == 2, name, "slow missed 2 periods");
+    ok &= check(sim.sched.stats(fast).lastJitterMs == 9950, name, "jitter measured from the deadline");
+    const uint64_t endOfPass = sim.now;
+    sim.runUntil(endOfPass + 1000, 0);
+    const std::vector<uint64_t> starts = sim.startsOf(fast);
+    ok &= check(starts.size() == 11 && evenlySpaced(std::vector<uint64_t>(starts.begin() + 1, starts.end()), 10155, 100),
+                name, "re-anchored one period after the late run");
+    printStats(name, sim);
+  }
+
+  {
+    // A job that runs longer than its period never queues up: each run starts
+    // one period after the previous one ended.
+    const char *name = "overrun";
+    Sim sim;
+    sim.verbose = verbose;
+    const int heavy = sim.add({"heavy", 100, 250, 100});
+    sim.runUntil(10000, 0);
+    const std::vector<uint64_t> starts = sim.startsOf(heavy);
+    ok &= check(evenlySpaced(starts, 100, 350), name, "runs 350ms apart");
+    // Each run ends 150ms past its next deadline: two periods missed.
+    ok &= check(starts.size() == 29 && sim.sched.stats(heavy).missed == 2 * starts.size(), name,
+                "overruns counted as missed periods");
+    printStats(name, sim);
+  }
+
+  {
+    // Fixed-size job table.
+    const char *name = "full";
+    Sim sim;
+    bool added = true;
+    for (size_t i = 0; i < Scheduler::kMaxJobs; ++i) added &= sim.add({"j" + std::to_string(i), 100, 0, 100}) >= 0;
+    ok &= check(added, name, "kMaxJobs jobs fit");
+    ok &= check(sim.add({"extra", 100, 0, 100}) == -1, name, "one more is refused");
+    Sim empty;
+    ok &= check(empty.add({"zero", 0, 0, 0}) == -1, name, "period 0 is refused");
+    ok &= check(empty.sched.msUntilNext(0) == Scheduler::kIdleWaitMs, name, "idle wait without jobs");
+    sim.runUntil(1000, 0);
+    ok &= check(sim.runs.size() == Scheduler::kMaxJobs * 10, name, "all of them run");
+  }
+
+  {
+    // The adaptive cycle changes both jobs from inside the sensor job:
+    // setPeriod on the running job and on one still waiting in the same pass.
+    // Each runs once in that pass and then at the new period.
+    const char *name = "setperiod";
+    Sim sim;
+    sim.verbose = verbose;
+    int capture = -1;
+    int sensor = -1;
+    int reads = 0;
+    sensor = sim.add({"sensor", 1000, 20, 995}, [&](int) {
+      if (++reads == 3) {
+        sim.sched.setPeriod(sensor, 300, sim.now);
+        sim.sched.setPeriod(capture, 300, sim.now);
+      }
+    });
+    capture = sim.add({"capture", 1000, 100, 1000});
+    // Passes at 1010, 2010 and 3010, each with both jobs due, sensor first.
+    for (uint64_t t = 1010; t <= 3010; t += 1000) {
+      sim.now = t;
+      sim.pass();
+    }
+    const size_t before = sim.runs.size();
+    sim.runUntil(6000, 0);
+    const std::vector<uint64_t> s = sim.startsOf(sensor);
+    const std::vector<uint64_t> c = sim.startsOf(capture);
+    ok &= check(before == 6 && s.size() > 3 && c.size() > 3 && s[2] == 3010 && c[2] == 3030, name,
+                "both run once in the pass that changes the period");
+    // Both are due at 3310, 3610, ... from then on; whichever goes second in
+    // a pass starts up to the other's run time late.
+    bool onCadence = s.size() == 12 && c.size() == 12;
+    for (size_t i = 3; onCadence && i < s.size(); ++i) {
+      const uint64_t deadline = 3310 + (i - 3) * 300;
+      onCadence = s[i] >= deadline && s[i] <= deadline + 100 && c[i] >= deadline && c[i] <= deadline + 20;
+    }
+    ok &= check(onCadence, name, "both every 300ms after the change, once per period");
+    printStats(name, sim);
+  }
+
+  printf(ok ? "all checks passed\n" : "some checks FAILED\n");
+  return ok;
+}
+
+bool parseJob(const char *v, JobSpec &spec) {
+  const char *colon = strchr(v, ':');
+  if (!colon || colon == v) return false;
+  spec.name.assign(v, colon);
+  char *end = nullptr;
+  spec.periodMs = static_cast<uint32_t>(strtoul(colon + 1, &end, 10));
+  if (*end == ':') spec.runMs = static_cast<uint32_t>(strtoul(end + 1, &end, 10));
+  spec.firstDelayMs = spec.periodMs;
+  return *end == '\0' && spec.periodMs > 0;
+}
+
+void usage(const char *argv0) {
+  fprintf(stderr,
+          "usage: %s (--selftest | --job NAME:PERIOD_MS[:RUN_MS] ...) [--seconds N] [--wake-ms N] [-v]\n", argv0);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::vector<JobSpec> jobs;
+  uint64_t seconds = 3600;
+  uint32_t wakeMs = 0;
+  bool self = false;
+  bool verbose = false;
+  for (int i = 1; i < argc; ++i) {
+    const char *a = argv[i];
+    if (strcmp(a, "--selftest") == 0) {
+      self = true;
+    } else if (strcmp(a, "-v") == 0) {
+      verbose = true;
+    } else if (a[0] == '-' && i + 1 < argc) {
+      const char *v = argv[++i];
+      if (strcmp(a, "--seconds") == 0) seconds = strtoull(v, nullptr, 10);
+      else if (strcmp(a, "--wake-ms") == 0) wakeMs = static_cast<uint32_t>(strtoul(v, nullptr, 10));
+      else if (strcmp(a, "--job") == 0) {
+        JobSpec spec;
+        if (!parseJob(v, spec)) {
+          fprintf(stderr, "bad job: %s\n", v);
+          return 2;
+        }
+        jobs.push_back(spec);
+      } else {
+        usage(argv[0]);
+        return 2;
+      }
+    } else {
+      usage(argv[0]);
+      return 2;
+    }
+  }
+  if (self) return selftest(verbose) ? 0 : 1;
+  if (jobs.empty() || jobs.size() > Scheduler::kMaxJobs) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  Sim sim;
+  sim.verbose = verbose;
+  for (const JobSpec &spec : jobs) sim.add(spec);
+  sim.runUntil(seconds * 1000, wakeMs);
+  char title[64];
+  snprintf(title, sizeof(title), "%llus, wake every %lums", static_cast<unsigned long long>(seconds),
+           static_cast<unsigned long>(wakeMs));
+  printStats(title, sim);
+  return 0;
+}
@@ -0,0 +1,176 @@
+// Host benchmark and bit-exactness check for the Android exporter's native
+// ARGB -> NV21/I420 conversion and 2x downscale (android-app/app/src/main/cpp).
+//
+//   g++ -O2 -std=gnu++17 -Iandroid-app/app/src/main/cpp tools/yuv_bench.cpp android-app/app/src/main/cpp/yuv_convert*.cpp -o yuv_bench
+//   ./yuv_bench                  # 2592x1944 (the OV5640's 5MP frames)
+//   ./yuv_bench 1600 1200        # another frame size
+//
+// First every kernel set this CPU supports is compared byte for byte with the
+// scalar one, and the scalar one with a port of the Kotlin loop it replaced,
+// over odd strides, widths that leave SIMD tails and extreme colours; any
+// difference exits 1. Then each set converts full frames for ms/frame.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "yuv_convert.h"
+
+using yuv::Isa;
+
+static const Isa kAllIsas[] = {Isa::kScalar, Isa::kSse2, Isa::kAvx2, Isa::kNeon};
+
+// The loop bitmapToNV21() in MainActivity.kt ran per pixel.
+static std::vector<uint8_t> kotlinNv21(const std::vector<uint32_t> &argb, int width, int height) {
+  std::vector<uint8_t> yuv(width * height * 3 / 2);
+  size_t yIndex = 0;
+  size_t uvIndex = static_cast<size_t>(width) * height;
+  auto clamp = [](int v) { return static_cast<uint8_t>(v < 0 ? 0 : (v > 255 ? 255 : v)); };
+  for (int j = 0; j < height; ++j) {
+    for (int i = 0; i < width; ++i) {
+      const uint32_t rgb = argb[j * width + i];
+      const int r = (rgb >> 16) & 0xff, g = (rgb >> 8) & 0xff, b = rgb & 0xff;
+      const int y = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+      const int u = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+      const int v = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+      yuv[yIndex++] = clamp(y);
+      if (j % 2 == 0 && i % 2 == 0) {
+        yuv[uvIndex++] = clamp(v);
+        yuv[uvIndex++] = clamp(u);
+      }
+    }
+  }
+  return yuv;
+}
+
+static std::vector<uint32_t> pattern(int stride, int height, unsigned seed) {
+  std::vector<uint32_t> px(static_cast<size_t>(stride) * height);
+  std::mt19937 rng(seed);
+  static const uint32_t kExtremes[] = {0x00000000, 0xffffffff, 0xffff0000, 0xff00ff00, 0xff0000ff,
+                                       0x00ffff00, 0xff00ffff, 0x80808080, 0x01fe01fe};
+  for (size_t i = 0; i < px.size(); ++i) {
+    switch (seed % 3) {
+      case 0: px[i] = rng(); break;
+      case 1: px[i] = kExtremes[rng() % (sizeof(kExtremes) / sizeof(kExtremes[0]))]; break;
+      default: px[i] = 0xff000000u | static_cast<uint32_t>(i * 0x010305u); break;
+    }
+  }
+  return px;
+}
+
+struct Outputs {
+  std::vector<uint8_t> nv21;
+  std::vector<uint8_t> i420;
+  std::vector<uint32_t> half;
+};
+
+static bool convertAll(Isa isa, const std::vector<uint32_t> &px, int width, int height, int stride, Outputs &out) {
+  yuv::useIsa(isa);
+  const int evenW = width & ~1, evenH = height & ~1;
+  out.nv21.assign(static_cast<size_t>(evenW) * evenH * 3 / 2, 0xee);
+  out.i420.assign(out.nv21.size(), 0xee);
+  out.half.assign(static_cast<size_t>(width / 2) * (height / 2), 0xeeeeeeee);
+  bool ok = yuv::argbToNv21(px.data(), evenW, evenH, stride, out.nv21.data());
+  ok = yuv::argbToI420(px.data(), evenW, evenH, stride, out.i420.data()) && ok;
+  if (width >= 2 && height >= 2) ok = yuv::halveArgb(px.data(), width, height, stride, out.half.data()) && ok;
+  return ok;
+}
+
+template <class T>
+static bool same(const char *what, Isa isa, int width, int height, int stride, const std::vector<T> &got,
+                 const std::vector<T> &want) {
+  for (size_t i = 0; i < want.size(); ++i) {
+    if (got[i] != want[i]) {
+      printf("MISMATCH %s %s %dx%d stride %d at %zu: %x != %x\n", yuv::isaName(isa), what, width, height, stride, i,
+             static_cast<unsigned>(got[i]), static_cast<unsigned>(want[i]));
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool checkAll() {
+  struct Case {
+    int width, height, extraStride;
+  };
+  // Widths around the 16- and 32-pixel blocks, odd sizes for the downscale.
+  static const Case kCases[] = {{2, 2, 0},   {14, 2, 0},  {16, 4, 0},  {18, 4, 3},   {30, 6, 0},    {32, 2, 0},
+                                {34, 6, 1},  {46, 8, 0},  {64, 4, 5},  {66, 10, 0},  {35, 9, 0},    {37, 7, 2},
+                                {98, 6, 16}, {130, 4, 0}, {1922, 6, 7}, {640, 480, 0}, {2592, 16, 0}};
+  int compared = 0;
+  for (const Case &c : kCases) {
+    for (unsigned seed = 0; seed < 6; ++seed) {
+      const int stride = c.width + c.extraStride;
+      const std::vector<uint32_t> px = pattern(stride, c.height, seed * 7 + c.width);
+      Outputs ref;
+      if (!convertAll(Isa::kScalar, px, c.width, c.height, stride, ref)) {
+        printf("scalar rejected %dx%d\n", c.width, c.height);
+        return false;
+      }
+      if (c.extraStride == 0 && c.width % 2 == 0 && c.height % 2 == 0 &&
+          !same("nv21 vs kotlin", Isa::kScalar, c.width, c.height, stride, ref.nv21, kotlinNv21(px, c.width, c.height))) {
+        return false;
+      }
+      for (Isa isa : kAllIsas) {
+        if (isa == Isa::kScalar || !yuv::isaSupported(isa)) continue;
+        Outputs got;
+        if (!convertAll(isa, px, c.width, c.height, stride, got) ||
+            !same("nv21", isa, c.width, c.height, stride, got.nv21, ref.nv21) ||
+            !same("i420", isa, c.width, c.height, stride, got.i420, ref.i420) ||
+            !same("halve", isa, c.width, c.height, stride, got.half, ref.half)) {
+          return false;
+        }
+        ++compared;
+      }
+    }
+  }
+  printf("bit-exact: %d frame comparisons against scalar, scalar matches the Kotlin loop\n", compared);
+  return true;
+}
+
+template <class Fn>
+static double msPerCall(Fn fn) {
+  int reps = 0;
+  const auto start = std::chrono::steady_clock::now();
+  double elapsedMs = 0;
+  do {
+    fn();
+    ++reps;
+    elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  } while (elapsedMs < 500.0 || reps < 3);
+  return elapsedMs / reps;
+}
+
+int main(int argc, char **argv) {
+  int width = 2592, height = 1944;
+  if (argc == 3) {
+    width = atoi(argv[1]);
+    height = atoi(argv[2]);
+  }
+  if (width < 2 || height < 2 || width % 2 || height % 2) {
+    fprintf(stderr, "usage: %s [even_width even_height]\n", argv[0]);
+    return 1;
+  }
+  if (!checkAll()) return 1;
+
+  const std::vector<uint32_t> px = pattern(width, height, 0);
+  std::vector<uint8_t> yuvOut(static_cast<size_t>(width) * height * 3 / 2);
+  std::vector<uint32_t> half(static_cast<size_t>(width / 2) * (height / 2));
+  const double mp = width * static_cast<double>(height) / 1e6;
+  printf("\n%dx%d (%.1f MP), best kernels here: %s\n", width, height, mp, yuv::isaName(yuv::bestIsa()));
+  printf("%-7s %10s %10s %12s %10s\n", "isa", "nv21 ms", "i420 ms", "halve ms", "nv21 MP/s");
+  double scalarMs = 0;
+  for (Isa isa : kAllIsas) {
+    if (!yuv::useIsa(isa)) continue;
+    const double nv21 = msPerCall([&] { yuv::argbToNv21(px.data(), width, height, width, yuvOut.data()); });
+    const double i420 = msPerCall([&] { yuv::argbToI420(px.data(), width, height, width, yuvOut.data()); });
+    const double halve = msPerCall([&] { yuv::halveArgb(px.data(), width, height, width, half.data()); });
+    if (isa == Isa::kScalar) scalarMs = nv21;
+    printf("%-7s %10.2f %10.2f %12.2f %10.0f", yuv::isaName(isa), nv21, i420, halve, mp / (nv21 / 1000.0));
+    if (isa != Isa::kScalar) printf("  (%.1fx scalar)", scalarMs / nv21);
+    printf("\n");
+  }
+  return 0;
+}